@@ -39,6 +39,7 @@
 
 #include "utils/json.h"
 #include "utils/tools.h"
+#include "utils/histogram.h"
 #include "io/interface.h"
 #include "io/hacc.h"
 /* -------------------------------------------------------------------------- */
@@ -59,7 +60,7 @@ private:
   bool computeFrequencies(int i, float* data);
   void computeShannonEntropy(int i);
   void filterParticles();
-  void extractNonHalos(int i);
+  void extractNonHalos();
   void dumpNonHalosData();
   void dumpLogs();
   void generateHistogram();
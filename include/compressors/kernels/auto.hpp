@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+/* -------------------------------------------------------------------------- */
+#include <map>
+#include <memory>
+#include <mpi.h>
+#include "interface.h"
+#include "utils/json.h"
+/* -------------------------------------------------------------------------- */
+/*
+ * picks a kernel and its parameters for each scalar from sampled trials.
+ * - a stratified sample of each rank data is compressed with every
+ *   candidate kernel over a parameter ladder, collectively on all ranks.
+ * - the fastest configuration meeting the error bound ('bound') and
+ *   the compression ratio floor ('ratio') is then used on the full data.
+ *   power-law fits of each kernel ladder are only recorded in the profile.
+ * - the selection is made in 'prepare', out of the timed calls, and
+ *   'compress' only looks it up.
+ * - decisions are stored per scalar in a JSON profile ('profile'),
+ *   and reused on later runs only if they were made for the same bound,
+ *   ratio floor and candidate kernels.
+ *
+ * compressed layout: [config length][config][payload],
+ * where config reads 'kernel;key=value;...'.
+ */
+class AutoCompressor : public CompressorInterface {
+
+public:
+   AutoCompressor() { name = "auto"; }
+  ~AutoCompressor() override { close(); }
+
+  void init() override {}
+  size_t maxCompressedSize(gio::Type type, size_t type_size, size_t* n) override;
+  int compress(Span in, Span out, gio::Type type, size_t type_size, size_t* n) override;
+  int decompress(Span in, Span out, gio::Type type, size_t type_size, size_t* n) override;
+  int getThreads() const override { return threads; }
+  void prepare(Span in, gio::Type type, size_t type_size, size_t* n) override;
+  void close() override;
+
+private:
+  using Params = std::unordered_map<std::string, std::string>;
+
+  struct Trial {
+    std::string kernel;
+    Params params;
+    double ratio = 0.;
+    double throughput = 0.;  // compression, in MB/s
+    double error = 0.;       // max absolute error
+    bool valid = false;
+  };
+
+  void setup();
+  std::string getKey() const;
+  std::string getKernels() const;
+  bool reusable(nlohmann::json const& entry) const;
+  bool decide(Span input, gio::Type type, size_t type_size, size_t* n);
+  std::vector<Trial> getLadder(std::string const& kernel) const;
+  std::vector<Trial> getCandidates() const;
+  CompressorInterface* use(std::string const& kernel, Params const& params);
+  Trial evaluate(Trial trial, Span sample, gio::Type type, size_t type_size, size_t numel);
+  Trial select(Span input, gio::Type type, size_t type_size, size_t* n);
+  void record(std::string const& key, Trial const& best, std::vector<Trial> const& trials);
+
+  static std::string encode(std::string const& kernel, Params const& params);
+  static bool decode(std::string const& config, std::string& kernel, Params& params);
+
+  double bound = 0.;
+  double ratio_floor = 1.;
+  double fraction = 0.01;
+  std::string profile_path {};
+  nlohmann::json profile {};
+
+  std::map<std::string, std::unique_ptr<CompressorInterface>> kernels;
+  Buffer sample, zipped, unzipped;
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int rank = 0;
+  int threads = 1;               // of the kernel used last
+};
+/* -------------------------------------------------------------------------- */
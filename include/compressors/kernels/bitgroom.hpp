@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+/* -------------------------------------------------------------------------- */
+#include <vector>
+#include "interface.h"
+/* -------------------------------------------------------------------------- */
+/*
+ * native mantissa rounding and shuffle kernel, always available.
+ * - 'bitgroom' rounds floating point mantissas to the nearest value with
+ *   'bits' significant bits, or enough bits for 'digits' decimal digits.
+ *   'shuffle' keeps values untouched and is thus lossless.
+ * - values are then byte shuffled, or bit shuffled, as given by 'shuffle'
+ *   ('byte', 'bit' or 'none'), so that zeroed bits end up contiguous.
+ * - the result is finally compressed by blosc when enabled, using 'codec',
+ *   'clevel' and 'threads'. otherwise, or if 'codec' is 'none', chunks of
+ *   zeros are simply elided.
+ * grooming and shuffling are fused in a single OpenMP pass.
+ */
+class BitGroomCompressor : public CompressorInterface {
+
+public:
+  explicit BitGroomCompressor(bool in_lossy = true) : lossy(in_lossy) {
+    name = lossy ? "bitgroom" : "shuffle";
+  }
+  ~BitGroomCompressor() override = default;
+
+  void init() override;
+  size_t maxCompressedSize(gio::Type type, size_t type_size, size_t* n) override;
+  int compress(Span in, Span out, gio::Type type, size_t type_size, size_t* n) override;
+  int decompress(Span in, Span out, gio::Type type, size_t type_size, size_t* n) override;
+  int getThreads() const override;
+  void close() override;
+
+private:
+  enum Shuffle : uint8_t { None = 0, Byte = 1, Bit = 2 };
+  enum Backend : uint8_t { Elide = 0, Blosc = 1 };
+
+  template <typename T>
+  void groom(T const* input, size_t numel, int keep, bool shuffled, uint8_t* output);
+
+  int getKeptBits(size_t type_size) const;
+  Shuffle getShuffle() const;
+  Backend getBackend() const;
+
+  size_t elide(uint8_t const* input, size_t size, uint8_t* output);
+  bool restore(uint8_t const* input, size_t input_size, uint8_t* output, size_t size);
+
+  void byteShuffle(uint8_t const* input, size_t numel, size_t type_size, uint8_t* output);
+  void bitShuffle(uint8_t const* input, size_t numel, size_t type_size, uint8_t* output);
+  void bitUnshuffle(uint8_t const* input, size_t numel, size_t type_size, uint8_t* output);
+  void byteUnshuffle(uint8_t const* input, size_t numel, size_t type_size, uint8_t* output);
+
+  static constexpr size_t chunk = 1024;   // granularity of zero elision
+
+  bool lossy = true;
+  Buffer scratch[2];                      // pooled between calls
+  std::vector<uint64_t> offsets;
+};
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+/* -------------------------------------------------------------------------- */
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+/* -------------------------------------------------------------------------- */
+/*
+ * helpers shared by native kernels to store integer codes compactly.
+ * values are packed with a fixed bit width, least significant bits first,
+ * and each value can be read or written independently of the others.
+ * unpacking up to 56 bits is branch free and vectorized with 'omp simd',
+ * packing merges overlapping words and stays scalar.
+ */
+namespace bitpack {
+
+  // map signed values to unsigned ones so that small magnitudes stay small
+  inline uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+  }
+
+  inline int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+  }
+
+  // number of significant bits
+  inline int width(uint64_t value) {
+    return value ? 64 - __builtin_clzll(value) : 0;
+  }
+
+  inline size_t packedSize(size_t n, int width) {
+    return (n * width + 7) / 8;
+  }
+
+  inline uint64_t mask(int width) {
+    return width == 64 ? ~uint64_t(0) : (uint64_t(1) << width) - 1;
+  }
+
+  // number of leading values that can be accessed with full 8-byte words
+  inline size_t fastCount(size_t n, int width, size_t bytes) {
+    return bytes >= 9 ? std::min(n, (bytes - 9) * 8 / width + 1) : 0;
+  }
+
+  // pack 'n' values on 'width' bits each, returns the number of bytes written
+  inline size_t pack(uint64_t const* input, size_t n, int width, uint8_t* output) {
+    size_t const bytes = packedSize(n, width);
+    std::memset(output, 0, bytes);
+    if (width == 0)
+      return 0;
+
+    uint64_t const bits = mask(width);
+    size_t const fast = fastCount(n, width, bytes);
+
+    // values whose 9-byte window is in bounds are merged with plain loads
+    for (size_t i = 0; i < fast; ++i) {
+      size_t const offset = i * width;
+      size_t const byte = offset >> 3;
+      int const shift = offset & 7;
+      uint64_t const value = input[i] & bits;
+      uint64_t word;
+      std::memcpy(&word, output + byte, 8);
+      word |= value << shift;
+      std::memcpy(output + byte, &word, 8);
+      if (shift + width > 64)
+        output[byte + 8] |= static_cast<uint8_t>(value >> (64 - shift));
+    }
+
+    for (size_t i = fast; i < n; ++i) {
+      size_t const offset = i * width;
+      size_t const byte = offset >> 3;
+      int const shift = offset & 7;
+      uint64_t const value = input[i] & bits;
+      uint64_t const low = value << shift;
+      size_t const span = std::min<size_t>(8, bytes - byte);
+
+      for (size_t k = 0; k < span; ++k)
+        output[byte + k] |= static_cast<uint8_t>(low >> (8 * k));
+      if (shift + width > 64)
+        output[byte + 8] |= static_cast<uint8_t>(value >> (64 - shift));
+    }
+    return bytes;
+  }
+
+  // unpack 'n' values of 'width' bits, returns the number of bytes read
+  inline size_t unpack(uint8_t const* input, size_t n, int width, uint64_t* output) {
+    size_t const bytes = packedSize(n, width);
+    if (width == 0) {
+      std::fill(output, output + n, 0);
+      return 0;
+    }
+
+    uint64_t const bits = mask(width);
+    size_t const fast = fastCount(n, width, bytes);
+
+    if (width <= 56) {
+      // a value always lies within the 8 bytes at its first bit
+      #pragma omp simd
+      for (size_t i = 0; i < fast; ++i) {
+        size_t const offset = i * width;
+        uint64_t low;
+        std::memcpy(&low, input + (offset >> 3), 8);
+        output[i] = (low >> (offset & 7)) & bits;
+      }
+    } else {
+      for (size_t i = 0; i < fast; ++i) {
+        size_t const offset = i * width;
+        size_t const byte = offset >> 3;
+        int const shift = offset & 7;
+        uint64_t low;
+        std::memcpy(&low, input + byte, 8);
+
+        uint64_t value = low >> shift;
+        if (shift + width > 64)
+          value |= static_cast<uint64_t>(input[byte + 8]) << (64 - shift);
+        output[i] = value & bits;
+      }
+    }
+
+    for (size_t i = fast; i < n; ++i) {
+      size_t const offset = i * width;
+      size_t const byte = offset >> 3;
+      int const shift = offset & 7;
+      uint64_t low = 0;
+      std::memcpy(&low, input + byte, std::min<size_t>(8, bytes - byte));
+
+      uint64_t value = low >> shift;
+      if (shift + width > 64)
+        value |= static_cast<uint64_t>(input[byte + 8]) << (64 - shift);
+      output[i] = value & bits;
+    }
+    return bytes;
+  }
+} // namespace bitpack
+/* -------------------------------------------------------------------------- */
@@ -33,20 +33,58 @@
 /* -------------------------------------------------------------------------- */
 #if ENABLE_BLOSC
 /* -------------------------------------------------------------------------- */
+#include <map>
 #include <sstream>
+#include <string>
 #include "blosc.h"
 #include "interface.h"
 /* -------------------------------------------------------------------------- */
+/*
+ * lossless kernel based on blosc, also registered as 'lz4' and 'zstd'
+ * to use these codecs by default.
+ * - 'codec' is blosclz, lz4, lz4hc, zlib or zstd, 'shuffle' is byte, bit
+ *   or none, 'clevel' in [0, 9], 'blocksize' in bytes (0: automatic),
+ *   'threads' defaults to the number of OpenMP threads.
+ * - if 'tune' is set, codec, shuffle, clevel and blocksize (unless given)
+ *   are picked on a sample of the data ('sample' fraction): 'ratio' keeps
+ *   the best ratio, 'speed' the fastest configuration within 5% of it.
+ *   the choice is made in 'prepare' and kept per type size and parameters.
+ * - blosc frames are self-describing, so decompression needs no parameter.
+ * - only the *_ctx calls are used, they need no global blosc state, so
+ *   nested instances do not tear down each other's state.
+ */
 class BLOSCCompressor : public CompressorInterface {
 
 public:
-   BLOSCCompressor() { name = "blosc"; }
+   explicit BLOSCCompressor(std::string in_codec = "blosclz");
   ~BLOSCCompressor() = default;
 
-  void init() override { blosc_init(); }
-  int compress(void* in, void*& out, std::string type, size_t type_size, size_t* n) override;
-  int decompress(void*& in, void*& out, std::string type, size_t type_size, size_t* n) override;
-  void close() override { blosc_destroy(); }
+  void init() override {}
+  size_t maxCompressedSize(gio::Type type, size_t type_size, size_t* n) override;
+  int compress(Span in, Span out, gio::Type type, size_t type_size, size_t* n) override;
+  int decompress(Span in, Span out, gio::Type type, size_t type_size, size_t* n) override;
+  int getThreads() const override;
+  bool handlesBytes() const override { return true; }
+  void prepare(Span in, gio::Type type, size_t type_size, size_t* n) override;
+  void close() override { sample.release(); trial.release(); }
+
+private:
+  struct Config {
+    std::string codec;
+    int shuffle = BLOSC_SHUFFLE;
+    int clevel = 9;
+    size_t blocksize = 0;
+  };
+
+  Config getConfig() const;
+  Config const& getTuned(Span in, size_t type_size);
+  Config tune(Span in, size_t type_size, Config const& initial);
+  size_t getBlockSize() const;
+
+  std::string codec;                // default one
+  std::map<std::string, Config> tuned;
+  Buffer sample;                    // pooled between calls
+  Buffer trial;
 };
 /* -------------------------------------------------------------------------- */
 #endif
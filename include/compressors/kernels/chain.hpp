@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+/* -------------------------------------------------------------------------- */
+#include <memory>
+#include "interface.h"
+/* -------------------------------------------------------------------------- */
+/*
+ * pipeline of kernels applied one after the other, e.g. "sz+blosc".
+ * - stages are given by the 'stages' parameter as a '+' separated list.
+ * - a parameter 'stage.key' is only forwarded to that stage, other ones
+ *   are forwarded to every stage.
+ * - only the first stage sees typed data, the next ones process the
+ *   previous stage output as a raw byte stream, so they must handle bytes.
+ * - only the first stage is prepared, the input of the next ones being
+ *   known once compressed.
+ * - intermediate outputs live in two pooled buffers used in turn, and
+ *   the last stage writes straight into the caller buffer.
+ *
+ * compressed layout: [nb_stages][size of each stage output][payload].
+ */
+class ChainCompressor : public CompressorInterface {
+
+public:
+   ChainCompressor() { name = "chain"; }
+  ~ChainCompressor() override { close(); }
+
+  void init() override {}
+  size_t maxCompressedSize(gio::Type type, size_t type_size, size_t* n) override;
+  int compress(Span in, Span out, gio::Type type, size_t type_size, size_t* n) override;
+  int decompress(Span in, Span out, gio::Type type, size_t type_size, size_t* n) override;
+  int getThreads() const override;
+  void prepare(Span in, gio::Type type, size_t type_size, size_t* n) override;
+  void close() override;
+
+private:
+  bool setup();
+  size_t getHeaderSize() const { return (kernels.size() + 1) * sizeof(uint64_t); }
+
+  std::string current {};
+  std::vector<std::unique_ptr<CompressorInterface>> kernels;
+  Buffer pool[2];
+};
+/* -------------------------------------------------------------------------- */
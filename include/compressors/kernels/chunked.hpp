@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+/* -------------------------------------------------------------------------- */
+#include <memory>
+#include <vector>
+#include "interface.h"
+/* -------------------------------------------------------------------------- */
+/*
+ * random-access wrapper around any kernel given by the 'kernel' parameter.
+ * - values are split in chunks of 'chunk' values compressed independently
+ *   as 1D arrays, other parameters are forwarded to the inner kernel.
+ * - a chunk index maps row ranges to byte offsets, so that
+ *   'decompressRange' only decodes the chunks covering the range.
+ * - each chunk has its own CRC64, so that a partial read is still checked.
+ * - 'slice' rewrites the index of the chunks covering a range, so that a
+ *   reader only fetches these bytes and decodes them as a stream of their own.
+ *
+ * compressed layout:
+ * [numel][chunk size][nb_chunks][offsets of nb_chunks + 1 chunks][crc of each chunk][chunks...]
+ */
+class ChunkedCompressor : public CompressorInterface {
+
+public:
+   ChunkedCompressor() { name = "chunked"; }
+  ~ChunkedCompressor() override { close(); }
+
+  void init() override {}
+  size_t maxCompressedSize(gio::Type type, size_t type_size, size_t* n) override;
+  int compress(Span in, Span out, gio::Type type, size_t type_size, size_t* n) override;
+  int decompress(Span in, Span out, gio::Type type, size_t type_size, size_t* n) override;
+  int decompressRange(Span in, Span out, gio::Type type, size_t type_size,
+                      size_t* n, size_t first, size_t count) override;
+  size_t getRangeBlock() const override { return getChunkSize(); }
+  int getThreads() const override { return kernel ? kernel->getThreads() : 1; }
+  void prepare(Span in, gio::Type type, size_t type_size, size_t* n) override;
+  void close() override;
+
+  // part of a stream holding a range of values
+  struct Slice {
+    size_t begin = 0;               // bytes to fetch, from the stream start
+    size_t end = 0;
+    size_t numel = 0;               // values of the sub-stream
+    size_t first = 0;               // range start in the sub-stream
+    std::vector<uint8_t> head;      // to prepend to the fetched bytes
+  };
+
+  static constexpr size_t preamble = 3 * sizeof(uint64_t);
+  static size_t getHeadSize(Span head);
+  static bool slice(Span head, size_t first, size_t count, Slice& out);
+
+private:
+  bool setup();
+  size_t getChunkSize() const;
+
+  std::string current {};
+  std::unique_ptr<CompressorInterface> kernel;
+  std::vector<uint64_t> offsets;
+  std::vector<uint64_t> checksums;
+  Buffer staging;
+};
+/* -------------------------------------------------------------------------- */
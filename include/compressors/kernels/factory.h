@@ -36,6 +36,13 @@
 #include "isabela.hpp"
 #include "sz.hpp"
 #include "zfp.hpp"
+#include "lorenzo.hpp"
+#include "bitgroom.hpp"
+#include "fpc.hpp"
+#include "integer.hpp"
+#include "chain.hpp"
+#include "chunked.hpp"
+#include "auto.hpp"
 #include "interface.h"
 /* -------------------------------------------------------------------------- */
 class CompressorFactory {
@@ -45,6 +52,8 @@ public:
 #if ENABLE_BLOSC
     if (name == "blosc")
       return new BLOSCCompressor();
+    if (name == "lz4" or name == "zstd")
+      return new BLOSCCompressor(name);
 #endif
 #if ENABLE_FPZIP
     if (name == "fpzip")
@@ -62,7 +71,46 @@ public:
     if (name == "zfp")
       return new ZFPCompressor();
 #endif
+    if (name == "lorenzo")
+      return new LorenzoCompressor();
+    if (name == "bitgroom")
+      return new BitGroomCompressor(true);
+    if (name == "shuffle")
+      return new BitGroomCompressor(false);
+    if (name == "fpc")
+      return new FPCCompressor();
+    if (name == "integer")
+      return new IntegerCompressor();
+    if (name == "chain")
+      return new ChainCompressor();
+    if (name == "chunked")
+      return new ChunkedCompressor();
+    if (name == "auto")
+      return new AutoCompressor();
+
     return nullptr;
   }
+
+  // kernels enabled in this build
+  static std::vector<std::string> available() {
+    return {
+#if ENABLE_BLOSC
+      "blosc",
+#endif
+#if ENABLE_FPZIP
+      "fpzip",
+#endif
+#if ENABLE_ISABELA
+      "isabela",
+#endif
+#if ENABLE_SZ
+      "sz",
+#endif
+#if ENABLE_ZFP
+      "zfp",
+#endif
+      "lorenzo", "bitgroom", "shuffle", "fpc"
+    };
+  }
 };
 /* -------------------------------------------------------------------------- */
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+/* -------------------------------------------------------------------------- */
+#include <vector>
+#include <omp.h>
+#include "interface.h"
+/* -------------------------------------------------------------------------- */
+/*
+ * native lossless predictive kernel, always available.
+ * - each value is predicted, and only the xor with its prediction is kept.
+ *   'predictor' is either 'fcm', which picks the best of a finite context
+ *   and a differential finite context predictor like FPC does, or 'xor'
+ *   that simply uses the previous value and is fully vectorized.
+ * - residuals are stored without their leading zero bytes, and a 4-bit
+ *   code per value gives the predictor used and the zero byte count.
+ * - data is split in independent blocks processed by OpenMP threads,
+ *   'table' is the log2 size of the per-block hash tables of 'fcm'.
+ *   a range of values is rebuilt by decoding its covering blocks only.
+ *
+ * compressed layout:
+ * [numel][block size][predictor][offsets of nb_blocks + 1 blocks][blocks...]
+ * block: [4-bit codes][residual bytes].
+ */
+class FPCCompressor : public CompressorInterface {
+
+public:
+   FPCCompressor() { name = "fpc"; }
+  ~FPCCompressor() override = default;
+
+  void init() override {}
+  size_t maxCompressedSize(gio::Type type, size_t type_size, size_t* n) override;
+  int compress(Span in, Span out, gio::Type type, size_t type_size, size_t* n) override;
+  int decompress(Span in, Span out, gio::Type type, size_t type_size, size_t* n) override;
+  int decompressRange(Span in, Span out, gio::Type type, size_t type_size,
+                      size_t* n, size_t first, size_t count) override;
+  size_t getRangeBlock() const override { return getBlockSize(); }
+  int getThreads() const override { return omp_get_max_threads(); }
+  void close() override {}
+
+private:
+  enum Predictor : uint8_t { FCM = 0, XOR = 1 };
+
+  template <typename T>
+  int encode(Span in, Span out, size_t* n);
+
+  template <typename T>
+  int decode(Span in, Span out, size_t* n, size_t first, size_t count);
+
+  size_t getBlockSize() const;
+  Predictor getPredictor() const;
+  int getTableBits() const;
+
+  // pooled between calls
+  std::vector<uint64_t> residuals;
+  std::vector<uint8_t> codes;
+  std::vector<uint64_t> offsets;
+};
+/* -------------------------------------------------------------------------- */
@@ -43,9 +43,17 @@ public:
   ~FPZIPCompressor() = default;
 
   void init() override {}
-  int compress(void* in, void*& out, std::string type, size_t type_size, size_t* n) override;
-  int decompress(void*& in, void*& out, std::string type, size_t type_size, size_t* n) override;
+  size_t maxCompressedSize(gio::Type type, size_t type_size, size_t* n) override;
+  int compress(Span in, Span out, gio::Type type, size_t type_size, size_t* n) override;
+  int decompress(Span in, Span out, gio::Type type, size_t type_size, size_t* n) override;
   void close() override {}
+
+private:
+  template <typename T>
+  int encode(Span in, Span out, size_t* n);
+
+  template <typename T>
+  int decode(Span in, Span out, size_t* n);
 };
 /* -------------------------------------------------------------------------- */
 #endif
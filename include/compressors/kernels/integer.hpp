@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+/* -------------------------------------------------------------------------- */
+#include <vector>
+#include <omp.h>
+#include "interface.h"
+/* -------------------------------------------------------------------------- */
+/*
+ * native lossless kernel for integer columns such as particle ids.
+ * - values are split in groups of 128, each one being either delta coded
+ *   and zigzag encoded, or coded relative to its minimum (frame of
+ *   reference), then bit-packed with the group bit width.
+ *   'mode' is 'delta', 'for' or 'auto' to pick the narrowest per group.
+ * - if 'sort' is set, values are sorted and delta coded, and the
+ *   permutation restoring their order is stored as a second stream.
+ *   it pays off for scattered ids whose permutation is locally ordered.
+ * - groups are gathered in independent chunks of 'block' values,
+ *   processed by OpenMP threads.
+ *
+ * compressed layout:
+ * [numel][block size][mode][values stream][permutation stream if sorted]
+ * stream: [offsets of nb_chunks + 1 chunks][chunks...]
+ * chunk: [group widths][packed groups, preceded by their base if 'for'].
+ */
+class IntegerCompressor : public CompressorInterface {
+
+public:
+   IntegerCompressor() { name = "integer"; }
+  ~IntegerCompressor() override = default;
+
+  void init() override {}
+  size_t maxCompressedSize(gio::Type type, size_t type_size, size_t* n) override;
+  int compress(Span in, Span out, gio::Type type, size_t type_size, size_t* n) override;
+  int decompress(Span in, Span out, gio::Type type, size_t type_size, size_t* n) override;
+  int getThreads() const override { return omp_get_max_threads(); }
+  void close() override {}
+
+private:
+  enum Mode : uint8_t { Auto = 0, Delta = 1, FOR = 2 };
+
+  template <typename T>
+  int encode(Span in, Span out, size_t* n);
+
+  template <typename T>
+  int decode(Span in, Span out, size_t* n);
+
+  size_t encodeStream(uint64_t const* input, size_t numel, size_t block, Mode mode, uint8_t* output);
+  size_t decodeStream(uint8_t const* input, size_t size, size_t numel, size_t block, uint64_t* output);
+  size_t getStreamBound(size_t numel, size_t block) const;
+
+  size_t getBlockSize() const;
+  Mode getMode() const;
+  bool isSorted() const;
+
+  static constexpr size_t group = 128;     // values sharing a bit width
+  static constexpr uint8_t relative = 0x80; // group width flag for 'for'
+
+  // pooled between calls
+  std::vector<uint64_t> values;
+  std::vector<uint64_t> codes;
+  std::vector<uint64_t> ordered;
+  std::vector<uint64_t> permutation;
+  std::vector<uint8_t> widths;
+  std::vector<uint64_t> offsets;
+};
+/* -------------------------------------------------------------------------- */
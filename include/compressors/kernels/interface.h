@@ -31,19 +31,72 @@
 
 #pragma once
 /* -------------------------------------------------------------------------- */
+#include <cstring>
 #include <string>
 #include <iostream>
 #include <sstream>
 #include <unordered_map>
+#include <vector>
+#include "utils/buffer.h"
+#include "io/data.h"
 /* -------------------------------------------------------------------------- */
+/*
+ * buffers are owned by the caller:
+ * - 'compress' writes at most 'out.size' bytes and stores the actual
+ *   compressed size in 'bytes', 'out.size' should be at least
+ *   'maxCompressedSize' for the same input.
+ * - 'decompress' reads 'in.size' bytes and writes the raw data in 'out'.
+ * kernel persistent state is set up in 'init' and released in 'close'.
+ * the element type is resolved once per call through 'dispatch', and
+ * kernels return EXIT_FAILURE for types they cannot handle.
+ * - 'getThreads' gives the number of threads a kernel runs on, serial
+ *   ones keep the default.
+ * - 'handlesBytes' tells if a kernel compresses any byte stream, given as
+ *   uint8_t values, so that it can be a later stage of a chain.
+ * - 'prepare' does data-dependent setup such as tuning before the timed
+ *   calls, kernels keep its outcome for the next 'compress'.
+ * - 'decompressRange' only rebuilds values [first, first + count) in 'out'.
+ *   kernels made of independent blocks override it to decode the covering
+ *   blocks only, others decode everything in a scratch buffer.
+ */
 class CompressorInterface {
 public:
+  virtual ~CompressorInterface() = default;
 
   virtual void init() = 0;
-  virtual int compress(void* in, void*& out, std::string type, size_t size, size_t* n) = 0;
-  virtual int decompress(void*& in, void*& out, std::string type, size_t size, size_t* n) = 0;
+  virtual size_t maxCompressedSize(gio::Type type, size_t size, size_t* n) = 0;
+  virtual int compress(Span in, Span out, gio::Type type, size_t size, size_t* n) = 0;
+  virtual int decompress(Span in, Span out, gio::Type type, size_t size, size_t* n) = 0;
   virtual void close() = 0;
 
+  virtual int decompressRange(Span in, Span out, gio::Type type, size_t size,
+                              size_t* n, size_t first, size_t count) {
+    size_t const numel = getNumElements(n);
+    if (first + count > numel or out.size < count * size) {
+      std::cerr << "Decompression failed: invalid range" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    Span full = whole.reserve(numel * size);
+    if (decompress(in, full, type, size, n) != EXIT_SUCCESS)
+      return EXIT_FAILURE;
+
+    std::memcpy(out.data, static_cast<char*>(full.data) + first * size, count * size);
+    return EXIT_SUCCESS;
+  }
+
+  // values decoded together by 'decompressRange', 0 if it decodes everything
+  virtual size_t getRangeBlock() const { return 0; }
+
+  // threads used per call, reported next to the throughput
+  virtual int getThreads() const { return 1; }
+
+  // whether raw bytes are accepted, typed kernels keep the default
+  virtual bool handlesBytes() const { return false; }
+
+  // called once on the data before 'compress', most kernels need nothing
+  virtual void prepare(Span in, gio::Type type, size_t size, size_t* n) {}
+
   std::string getName() { return name; }
   std::string getLog() { return log.str(); }
   size_t getBytes() { return bytes; }
@@ -59,11 +112,41 @@ public:
     return info;
   }
 
+  static size_t getNumElements(size_t const* n) {
+    size_t numel = n[0];
+    for (int i = 1; i < 5; i++)
+      if (n[i] != 0)
+        numel *= n[i];
+    return numel;
+  }
+
+  // per-stage breakdown, only filled by multi-stage kernels
+  struct Stage {
+    std::string name;
+    size_t bytes = 0;
+    double zip_time = 0.;
+    double unzip_time = 0.;
+  };
+
+  std::vector<Stage> const& getStages() const { return stages; }
+
   std::unordered_map<std::string, std::string> parameters {};
 
 protected:
+  // same as 'gio::dispatch', but unsupported types fail instead of throwing
+  template <typename Func>
+  int dispatch(gio::Type type, Func&& func) {
+    if (not gio::dispatchable(type)) {
+      std::cerr << name << " failed: unsupported type " << gio::to_string(type) << std::endl;
+      return EXIT_FAILURE;
+    }
+    return gio::dispatch(type, std::forward<Func>(func));
+  }
+
   std::string name {};
   std::stringstream log {};
   size_t bytes = 0;
+  std::vector<Stage> stages {};
+  Buffer whole {};   // full decode behind the default range path
 };
 /* -------------------------------------------------------------------------- */
@@ -43,8 +43,9 @@ public:
   ~IsabelaCompressor() = default;
 
   void init() override {}
-  int compress(void* in, void*& out, std::string type, size_t type_size, size_t* n) override;
-  int decompress(void*& in, void*& out, std::string type, size_t type_size, size_t* n) override;
+  size_t maxCompressedSize(gio::Type type, size_t type_size, size_t* n) override;
+  int compress(Span in, Span out, gio::Type type, size_t type_size, size_t* n) override;
+  int decompress(Span in, Span out, gio::Type type, size_t type_size, size_t* n) override;
   void close() override {}
 };
 /* -------------------------------------------------------------------------- */
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+/* -------------------------------------------------------------------------- */
+#include <vector>
+#include <omp.h>
+#include "interface.h"
+/* -------------------------------------------------------------------------- */
+/*
+ * native error-bounded lossy kernel, always available.
+ * - values are prequantized on a grid of step 2*abs, so that the
+ *   reconstruction error is bounded by 'abs'. relative bounds ('rel',
+ *   'pw_rel') are not supported and rejected.
+ * - integer codes are predicted from the previous one (1D Lorenzo),
+ *   then zigzag encoded and bit-packed per group of 64 values.
+ * - values that cannot be quantized (non finite, too large, or off
+ *   bound due to rounding) are stored raw as outliers.
+ * - data is split in independent blocks processed by OpenMP threads,
+ *   and a block offset table allows to decode them in parallel, or to
+ *   only decode the blocks covering a range of values.
+ *
+ * compressed layout:
+ * [numel][block size][abs][offsets of nb_blocks + 1 blocks][blocks...]
+ * block: [nb_outliers][widths][packed codes][outlier indices][outliers].
+ */
+class LorenzoCompressor : public CompressorInterface {
+
+public:
+   LorenzoCompressor() { name = "lorenzo"; }
+  ~LorenzoCompressor() override = default;
+
+  void init() override {}
+  size_t maxCompressedSize(gio::Type type, size_t type_size, size_t* n) override;
+  int compress(Span in, Span out, gio::Type type, size_t type_size, size_t* n) override;
+  int decompress(Span in, Span out, gio::Type type, size_t type_size, size_t* n) override;
+  int decompressRange(Span in, Span out, gio::Type type, size_t type_size,
+                      size_t* n, size_t first, size_t count) override;
+  size_t getRangeBlock() const override { return getBlockSize(); }
+  int getThreads() const override { return omp_get_max_threads(); }
+  void close() override {}
+
+private:
+  template <typename T>
+  int encode(Span in, Span out, size_t* n);
+
+  template <typename T>
+  int decode(Span in, Span out, size_t* n, size_t first, size_t count);
+
+  double getErrorBound() const;
+  size_t getBlockSize() const;
+
+  static constexpr size_t group = 64;   // values sharing a bit width
+
+  // pooled between calls
+  std::vector<uint64_t> codes;
+  std::vector<uint8_t> widths;
+  std::vector<uint32_t> nb_outliers;
+  std::vector<uint64_t> offsets;
+};
+/* -------------------------------------------------------------------------- */
@@ -36,16 +36,34 @@
 #include "interface.h"
 #include "sz.h"
 /* -------------------------------------------------------------------------- */
+/*
+ * - error mode is given by 'rel', 'abs' or 'pw_rel', the last one wins.
+ * - 'threads' sets the OpenMP threads available to SZ during a call, which
+ *   only helps if SZ was built with its OpenMP code paths enabled.
+ * - the global SZ context is set up by the first instance and released by
+ *   the last one.
+ */
 class SZCompressor: public CompressorInterface {
 
 public:
    SZCompressor() { name = "sz"; }
   ~SZCompressor() = default;
 
-  void init() override {}
-  int compress(void* in, void*& out, std::string type, size_t type_size, size_t* n) override;
-  int decompress(void*& in, void*& out, std::string type, size_t type_size, size_t* n) override;
-  void close() override {}
+  void init() override;
+  size_t maxCompressedSize(gio::Type type, size_t type_size, size_t* n) override;
+  int compress(Span in, Span out, gio::Type type, size_t type_size, size_t* n) override;
+  int decompress(Span in, Span out, gio::Type type, size_t type_size, size_t* n) override;
+  void close() override;
+  int getThreads() const override;
+
+private:
+  template <typename T>
+  int encode(Span in, Span out, size_t* n);
+
+  template <typename T>
+  int decode(Span in, Span out, size_t* n);
+
+  static int nb_instances;    // SZ relies on a global context
 };
 /* -------------------------------------------------------------------------- */
 #endif
@@ -36,6 +36,13 @@
 #include "interface.h"
 #include "zfp.h"
 /* -------------------------------------------------------------------------- */
+/*
+ * - error mode is given by 'abs', 'rel' (precision) or 'bits' (rate).
+ * - 'threads' > 1 selects the OpenMP execution policy for compression,
+ *   with 'chunk' blocks per thread task (0: one chunk per thread).
+ *   the stream is the same as in serial mode, and decompression is serial
+ *   since zfp does not support OpenMP decompression.
+ */
 class ZFPCompressor: public CompressorInterface {
 
   enum Mode { zfp_ABS, zfp_REL, zfp_BIT };
@@ -44,16 +51,25 @@ public:
    ZFPCompressor() { name = "zfp"; }
   ~ZFPCompressor() = default;
 
-  void init() override {}
-  int compress(void* in, void*& out, std::string type, size_t type_size, size_t* n) override;
-  int decompress(void*& in, void*& out, std::string data_type, size_t type_size, size_t* n) override;
-  void close() override {}
+  void init() override;
+  size_t maxCompressedSize(gio::Type type, size_t type_size, size_t* n) override;
+  int compress(Span in, Span out, gio::Type type, size_t type_size, size_t* n) override;
+  int decompress(Span in, Span out, gio::Type type, size_t type_size, size_t* n) override;
+  void close() override;
+  int getThreads() const override { return threads; }
 
-  zfp_type getZfpType(std::string const& type) const;
+  zfp_type getZfpType(gio::Type type) const;
 
 private:
-  size_t zfpCompressedSize = 0;
+  void configure(gio::Type type, size_t* n);
+  bool setExecution(bool parallel);
+
+  // persistent state, reused across calls
+  zfp_stream* zfp = nullptr;
+  zfp_field* field = nullptr;
+
   int dims = 0;
+  int threads = 1;
   Mode zfp_mode_ = zfp_ABS;
 };
 /* -------------------------------------------------------------------------- */
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+/* -------------------------------------------------------------------------- */
+#include <string>
+#include <sstream>
+#include <unordered_map>
+#include <mpi.h>
+#include "io/data.h"
+/* -------------------------------------------------------------------------- */
+/*
+ * error bound check fused with decompression.
+ * - the bound is the one given to the kernel: 'pw_rel' (point-wise relative),
+ *   'abs', or 'rel' (relative to the value range), with the precedence of sz.
+ * - values are checked piece by piece right after being decoded, while
+ *   error statistics are accumulated on the fly: no extra pass over the
+ *   arrays nor error array is needed.
+ * - 'abs' and 'pw_rel' violations are caught on the faulty piece,
+ *   'rel' ones once the value range of the whole field is known.
+ */
+class boundChecker {
+
+public:
+  enum Mode { None, Absolute, Relative, PointWise };
+
+   boundChecker() = default;
+  ~boundChecker() = default;
+
+  bool init(MPI_Comm _comm, std::unordered_map<std::string, std::string> const& params);
+  bool check(void const* original, void const* approx, size_t n, gio::Type type, size_t first);
+  bool finalize();
+
+  Mode getMode() const { return mode; }
+  std::string getLog() { return log.str(); }
+
+private:
+  template <typename T>
+  bool compute(T const* original, T const* approx, size_t n, size_t first);
+
+  Mode mode = None;
+  double bound = 0.;
+
+  // local statistics
+  size_t count = 0;
+  double max_error = 0.;
+  double sum_error = 0.;
+  double sum_squared = 0.;
+  double max_pointwise = 0.;
+  double lowest = 0.;
+  double highest = 0.;
+  bool valid = true;
+
+  int rank = 0;
+  MPI_Comm comm = MPI_COMM_NULL;
+  std::stringstream log {};
+};
+/* -------------------------------------------------------------------------- */
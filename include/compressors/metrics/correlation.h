@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+/* -------------------------------------------------------------------------- */
+#include <vector>
+#include "interface.h"
+/* -------------------------------------------------------------------------- */
+/*
+ * two-point correlation function ξ(r) of original and decompressed
+ * positions in a periodic box, from a joint x+y+z field.
+ * - particles are sent to the rank owning their x-slab, and copied to the
+ *   slabs within reach of the largest separation, widened by the largest
+ *   displacement so that both sets of pairs are complete.
+ * - ordered pairs are counted in log-spaced bins over a cell list with
+ *   minimum-image distances, by threads with private bins, then reduced
+ *   once. ξ follows from the exact pair count of a uniform periodic box.
+ * - particles may be randomly subsampled, identically in both sets.
+ * - the value is the largest relative deviation of decompressed pair
+ *   counts, NaN for other fields; ξ of both sets per bin is kept as
+ *   additional output.
+ * - 'box' defaults to the physical scale of the input file.
+ */
+class correlationMetric : public MetricInterface {
+
+public:
+   correlationMetric() { name = "correlation"; }
+  ~correlationMetric() = default;
+
+  void init(MPI_Comm _comm) override {
+    comm = _comm;
+    MPI_Comm_size(comm, &nb_ranks);
+    MPI_Comm_rank(comm, &rank);
+  }
+
+  void execute(void *original, void *approx, size_t n, gio::Type type) override;
+  void close() override {}
+
+private:
+  template <typename T>
+  void compute(T const* original, T const* approx, size_t n);
+
+  size_t distribute(std::vector<double>& particles, double margin) const;
+  void countPairs(std::vector<double> const& particles, size_t owned,
+                  int set, std::vector<unsigned long>& pairs) const;
+
+  double box = 0.;
+  double r_min = 0.;
+  double r_max = 0.;
+  int nb_bins = 0;
+};
+/* -------------------------------------------------------------------------- */
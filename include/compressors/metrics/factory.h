@@ -36,6 +36,7 @@
 #include "mean_square_error.h"
 #include "psnr_error.h"
 #include "min_max.h"
+#include "correlation.h"
 #include "interface.h"
 /* -------------------------------------------------------------------------- */
 class MetricsFactory {
@@ -52,6 +53,8 @@ public:
       return new psnrError();
     else if (name == "min_max")
       return new minmaxMetric();
+    else if (name == "correlation")
+      return new correlationMetric();
     else
       return nullptr;
   }
@@ -34,16 +34,19 @@
 #include <sstream>
 #include <unordered_map>
 #include <mpi.h>
+#include "io/data.h"
 /* -------------------------------------------------------------------------- */
 class MetricInterface {
 
 public:
+  virtual ~MetricInterface() = default;
+
   virtual void init(MPI_Comm _comm) = 0;
-  virtual void execute(void *original, void *approx, size_t n) = 0;
+  virtual void execute(void *original, void *approx, size_t n, gio::Type type) = 0;
   virtual void close() = 0;
 
   double getLocalValue() { return local_val; }
-  double getGlobalValue() { return total_val; }
+  double getGlobalValue() { return total_val; }   // NaN if it does not apply
   std::string getName() { return name; }
   std::string getLog() { return log.str(); }
   void clearLog() { log.str(""); }
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+/* -------------------------------------------------------------------------- */
+#include <string>
+#include <sstream>
+#include <mpi.h>
+#include "io/data.h"
+#include "utils/summation.h"
+#include "utils/histogram.h"
+/* -------------------------------------------------------------------------- */
+/*
+ * all error metrics of a field at once.
+ * - the statistics behind 'absolute_error', 'relative_error',
+ *   'mean_square_error', 'psnr' and 'min_max' are accumulated in a single
+ *   pass over the original and decompressed arrays.
+ * - the pass is vectorized and multithreaded, sums being accumulated per
+ *   block and then compensated.
+ * - partial results of all ranks are packed in one record, and reduced
+ *   by a single collective with a dedicated operator.
+ * - arrays can be given window by window between 'begin' and 'finalize',
+ *   so that no whole decompressed field is needed: memory use does not
+ *   depend on the field size. 'execute' does it at once.
+ * - distributions of errors, relative errors and decompressed values are
+ *   binned in the same pass if their range is given. otherwise their range
+ *   is the one found by the pass, and 'complete' bins them afterwards
+ *   (twelve decades below the largest value in log scale).
+ * - values and logs are the same as those of the metric classes, which
+ *   are still used for metrics given parameters other than binning ones.
+ */
+class metricEngine {
+
+public:
+   metricEngine() = default;
+  ~metricEngine() { close(); }
+
+  void init(MPI_Comm _comm);
+  void begin();
+  void accumulate(void const* original, void const* approx, size_t n, gio::Type type);
+  void finalize();
+  void execute(void const* original, void const* approx, size_t n, gio::Type type);
+  void complete(void const* original, void const* approx, size_t n, gio::Type type);
+  void close();
+
+  enum Distribution { Error = 0, RelativeError = 1, Value = 2 };
+
+  // an empty range [lower, upper] is the range of the data
+  void addHistogram(Distribution which, size_t nb_bins, Histogram::Scale scale,
+                    double lower = 0., double upper = 0.);
+  bool hasDeferredHistogram() const;
+  Histogram const* getHistogram(Distribution which) const;
+
+  static bool supports(std::string const& metric);
+  double getLocalValue(std::string const& metric) const;
+  double getGlobalValue(std::string const& metric) const;
+  std::string getLog(std::string const& metric) const;
+
+  // partial results, reduced as a single record of doubles
+  struct Statistics {
+    double count = 0.;
+    double max_abs = 0.;
+    double sum_abs = 0.;
+    double sum_squared = 0.;
+    double max_rel = 0.;
+    double sum_rel = 0.;
+    double lowest = 0.;
+    double highest = 0.;
+  };
+
+private:
+  template <typename T>
+  void compute(T const* original, T const* approx, size_t n);
+
+  template <typename T>
+  void fill(T const* original, T const* approx, size_t n, bool deferred);
+
+  template <typename T>
+  void bin(T const* original, T const* approx, size_t first, size_t last,
+           bool const* binned, std::vector<uint64_t>* bins) const;
+
+  void reduceHistograms(bool deferred);
+
+  static void combine(void* in, void* inout, int* len, MPI_Datatype* type);
+
+  static constexpr size_t block = 1024;   // values summed in double directly
+  static double getValue(std::string const& metric, Statistics const& stats);
+
+  Statistics local {};
+  Statistics global {};
+  KahanSum sum_abs, sum_squared, sum_rel;   // of all windows so far
+
+  struct Request {
+    bool active = false;
+    bool deferred = false;
+    size_t nb_bins = 0;
+    Histogram::Scale scale = Histogram::Linear;
+  };
+
+  static constexpr int nb_distributions = 3;
+  Request requests[nb_distributions];
+  Histogram histograms[nb_distributions];
+
+  int rank = 0;
+  MPI_Comm comm = MPI_COMM_NULL;
+  MPI_Datatype record = MPI_DATATYPE_NULL;
+  MPI_Op reduce = MPI_OP_NULL;
+};
+/* -------------------------------------------------------------------------- */
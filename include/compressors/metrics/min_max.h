@@ -45,7 +45,11 @@ public:
     MPI_Comm_rank(comm, &rank);
   }
 
-  void execute(void *original, void *approx, size_t n) override;
+  void execute(void *original, void *approx, size_t n, gio::Type type) override;
   void close() override {}
+
+private:
+  template <typename T>
+  void compute(T const* original, T const* approx, size_t n);
 };
 /* -------------------------------------------------------------------------- */
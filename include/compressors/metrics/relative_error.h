@@ -45,10 +45,12 @@ public:
     MPI_Comm_rank(comm, &rank);
   }
 
-  void execute(void *original, void *approx, size_t n) override;
+  void execute(void *original, void *approx, size_t n, gio::Type type) override;
   void close() override {}
 
 protected:
-  double relError(float original, float approx, double tolerance);
+  template <typename T>
+  void compute(T const* original, T const* approx, size_t n);
+  double relError(double original, double approx, double tolerance);
 };
 /* -------------------------------------------------------------------------- */
@@ -38,8 +38,11 @@
 
 #include "utils/json.h"
 #include "utils/tools.h"
+#include "utils/histogram.h"
 #include "io/interface.h"
 #include "io/hacc.h"
+#include "utils/buffer.h"
+#include "spectrum/power_spectrum.h"
 #include <compressors/kernels/factory.h>
 /* -------------------------------------------------------------------------- */
 class Density {
@@ -70,6 +73,10 @@ private:
   void process(int step);
   void dump();
 
+  // power spectrum of positions before and after compression
+  void computeReferenceSpectrum();
+  void compareSpectrum();
+
   static int const dim = 3;
 
   // IO
@@ -115,6 +122,17 @@ private:
   std::vector<int> bits;                           // size: nb_bins
   int min_bits =  1;
   int max_bits = 32;
+  std::vector<float> dataset;                      // bucket staging, reused
+  Buffer zipped;                                   // pooled compressed data
+
+  // power spectrum
+  bool spectral = false;
+  int spectrum_cells = 0;
+  double spectrum_box = 0.;
+  double spectrum_k_max = 0.;
+  std::string spectrum_reference;
+  std::string output_spectrum;
+  PowerSpectrum reference;
 
   // MPI
   int my_rank  = 0;
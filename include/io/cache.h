@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+/* -------------------------------------------------------------------------- */
+#include <string>
+#include <unordered_map>
+#include <mpi.h>
+#include "io/data.h"
+#include "utils/buffer.h"
+/* -------------------------------------------------------------------------- */
+#ifndef HELIOS_VERSION
+  #define HELIOS_VERSION "unknown"
+#endif
+/* -------------------------------------------------------------------------- */
+/*
+ * on-disk cache of compression results, addressed by content.
+ * - a key is the CRC64 of a description of the run: code version, CRC64
+ *   of the running binary, number of ranks, kernel, parameters, metrics
+ *   and CRC64 of the input field.
+ *   the description is stored along and compared on lookup.
+ * - field checksums are memoized per input file, identified by its path,
+ *   size and modification time, so that a hit does not even load the data.
+ * - rank 0 stores the report of a field, and every rank may store its
+ *   compressed payload to rebuild dumps and archives on a hit.
+ *
+ * layout of the cache folder:
+ * [fields_<input hash>.json: checksums of the fields of an input file]
+ * [<key>.json: description, report, type and extents of the payload]
+ * [<key>_<rank>.bin: compressed payload of each rank, if kept]
+ */
+class ResultCache {
+
+public:
+  struct Entry {
+    std::string row;                  // stats row after the field prefix
+    std::string info;                 // stats text of the field
+    gio::Type type = gio::Type::Float;
+    size_t type_size = 0;
+    size_t n[5] = {0, 0, 0, 0, 0};    // local extents and payload size
+    size_t bytes = 0;
+    bool payload = false;
+  };
+
+  ResultCache(std::string in_folder, MPI_Comm in_comm);
+  ~ResultCache() = default;
+
+  bool open(std::string const& input);
+  bool getChecksum(std::string const& field, uint64_t& crc) const;
+  uint64_t setChecksum(std::string const& field, void const* data, size_t bytes);
+  std::string getKey(std::string const& description);
+  bool find(std::string const& key, Entry& entry, bool need_payload, Buffer& payload);
+  void store(std::string const& key, Entry const& entry, Span payload);
+
+private:
+  std::string folder;
+  std::string fields_path;
+  std::string build;                  // CRC64 of the binary, if readable
+  std::unordered_map<std::string, std::string> descriptions;
+  std::unordered_map<std::string, uint64_t> checksums;
+  MPI_Comm comm = MPI_COMM_NULL;
+  int rank = 0;
+  int nb_ranks = 1;
+};
+/* -------------------------------------------------------------------------- */
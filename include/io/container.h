@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+/* -------------------------------------------------------------------------- */
+#include <string>
+#include <vector>
+#include <sstream>
+#include <unordered_map>
+#include <mpi.h>
+#include "io/data.h"
+#include "utils/buffer.h"
+/* -------------------------------------------------------------------------- */
+/*
+ * compressed container file, written and read collectively with MPI-IO.
+ *
+ * layout:
+ * [preamble: magic, version, metadata size, index offset]
+ * [metadata: json describing fields, kernels and parameters]
+ * [index: nb_ranks * nb_fields entries, rank major]
+ * [payloads: concatenated per rank, at prefix-sum offsets]
+ *
+ * each entry gives the location, size, CRC64 and extents of the payload
+ * of a field for a given writer rank.
+ * 'readRange' is independent and only rebuilds some rows of the blocks
+ * assigned to a rank: for fields compressed with the 'chunked' kernel,
+ * only the chunks covering these rows are fetched and decoded.
+ */
+struct ContainerField {
+  std::string name;
+  std::vector<std::string> members;   // scalars of a joint field
+  bool interleave = false;            // layout of a joint field
+  std::string kernel;
+  std::unordered_map<std::string, std::string> params;
+  gio::Type type = gio::Type::Float;
+  size_t type_size = 0;
+};
+
+struct ContainerEntry {
+  uint64_t offset = 0;                // absolute, in bytes
+  uint64_t bytes = 0;
+  uint64_t crc = 0;
+  uint64_t n[5] = {0, 0, 0, 0, 0};
+};
+
+/* -------------------------------------------------------------------------- */
+class ContainerWriter {
+
+public:
+  ContainerWriter(std::string in_path, MPI_Comm in_comm);
+  ~ContainerWriter() = default;
+
+  void setPhysics(double const* origin, double const* scale, int const* partition);
+  void add(ContainerField const& field, size_t const* n, Span payload);
+  bool write();
+  std::string getLog() const { return log.str(); }
+
+private:
+  std::string path;
+  MPI_Comm comm = MPI_COMM_NULL;
+  std::vector<ContainerField> fields;
+  std::vector<ContainerEntry> entries;
+  std::vector<uint8_t> payloads;      // local ones, concatenated
+  double phys_orig[3] {0, 0, 0};
+  double phys_scale[3] {0, 0, 0};
+  int mpi_partition[3] {0, 0, 0};
+  std::stringstream log;
+};
+
+/* -------------------------------------------------------------------------- */
+class ContainerReader {
+
+public:
+  ContainerReader(std::string in_path, MPI_Comm in_comm);
+  ~ContainerReader();
+
+  bool open();
+  bool read(size_t index, Buffer& output, size_t& numel);
+  bool readRange(size_t index, size_t first, size_t count, Buffer& output);
+  void close();
+
+  std::vector<ContainerField> const& getFields() const { return fields; }
+  std::string getLog() const { return log.str(); }
+
+  double phys_orig[3] {0, 0, 0};
+  double phys_scale[3] {0, 0, 0};
+  int mpi_partition[3] {0, 0, 0};
+
+private:
+  bool fetch(uint64_t offset, void* data, size_t bytes);
+
+  std::string path;
+  MPI_Comm comm = MPI_COMM_NULL;
+  MPI_File file = MPI_FILE_NULL;
+  std::vector<ContainerField> fields;
+  std::vector<ContainerEntry> entries;  // of the assigned writer ranks
+  int nb_blocks = 0;                    // writer ranks assigned to this rank
+  int max_blocks = 0;
+  Buffer payload;
+  Buffer scratch;
+  std::stringstream log;
+};
+/* -------------------------------------------------------------------------- */
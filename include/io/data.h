@@ -32,6 +32,8 @@
 #pragma once
 /* -------------------------------------------------------------------------- */
 #include <string>
+#include <cstdint>
+#include <stdexcept>
 /* -------------------------------------------------------------------------- */
 namespace gio {
   enum class Type {
@@ -39,6 +41,36 @@ namespace gio {
   };
 
   std::string to_string(Type data_type);
+
+  /**
+   * Resolve a runtime data type into a static one, only once per call site.
+   * 'func' is a generic callable invoked with a null pointer of the matching
+   * element type, and every branch must return the same type.
+   * Only float, double, int32_t and int64_t columns are supported.
+   */
+  template <typename Func>
+  decltype(auto) dispatch(Type data_type, Func&& func) {
+    switch (data_type) {
+      case Type::Float:  return func(static_cast<float*>(nullptr));
+      case Type::Double: return func(static_cast<double*>(nullptr));
+      case Type::Int:
+      case Type::Int32:  return func(static_cast<int32_t*>(nullptr));
+      case Type::Int64:  return func(static_cast<int64_t*>(nullptr));
+      default: throw std::runtime_error("unsupported type: " + to_string(data_type));
+    }
+  }
+
+  // whether 'dispatch' resolves that type rather than throwing
+  inline bool dispatchable(Type data_type) {
+    switch (data_type) {
+      case Type::Float:
+      case Type::Double:
+      case Type::Int:
+      case Type::Int32:
+      case Type::Int64: return true;
+      default: return false;
+    }
+  }
 /* -------------------------------------------------------------------------- */
 class Data {
 
@@ -31,6 +31,10 @@
 
 #pragma once
 /* -------------------------------------------------------------------------- */
+#include <array>
+#include <functional>
+#include <memory>
+#include <type_traits>
 #include "utils/tools.h"
 #include "utils/timer.h"
 #include "utils/json.h"
@@ -42,6 +46,25 @@
 class HACCDataLoader : public DataLoaderInterface {
 
 public:
+  // a caller-owned column destination: 'resize' makes it hold the given
+  // count of elements and returns their storage, where data is read in place.
+  // the column must match the size and float-ness of its elements.
+  struct Binding {
+    std::string name;
+    size_t elem_size = 0;
+    bool is_float = false;
+    std::function<char*(size_t)> resize;
+  };
+
+  // bind a vector, local elements are stored after its first 'offset' ones.
+  template <typename T>
+  static Binding bind(std::string name, std::vector<T>& out, size_t offset = 0) {
+    return { std::move(name), sizeof(T), std::is_floating_point<T>::value, [&out, offset](size_t count) {
+      out.resize(offset + count);
+      return reinterpret_cast<char*>(out.data() + offset);
+    }};
+  }
+
   // For output
   double phys_orig[3]{0, 0, 0};
   double phys_scale[3]{0, 0, 0};
@@ -53,16 +76,38 @@ public:
     scalar_data.clear();
   }
 
-  ~HACCDataLoader() { close(); }
+  ~HACCDataLoader() { close(); closeReader(); }
 
   void init(std::string in_file, MPI_Comm _comm) override;
   bool saveParams() override;
   bool load(std::string paramName) override;
+  bool load(std::vector<Binding> const& columns);
   void save(std::string in_param, void *raw) override;
   void dump(std::string in_file) override;
   bool close() override;
 
 protected:
+  bool open();
+  void closeReader();
+  void assignRanks(int range[2]) const;
+  void trackExtents(int data_rank, int min[3], int max[3]);
+  void saveExtents(int const min[3], int const max[3]);
+  void countElements(int const range[2]);
+  void readBlocks(int const range[2],
+                  std::vector<gio::GenericIO::VariableInfo const*> const& infos,
+                  std::vector<char*> const& targets);
+  gio::GenericIO::VariableInfo const* find(std::string const& name) const;
+  static size_t padding(size_t elem_size);
+
   int nb_ranks = 0;
   int rank = 0;
+
+  // the file is opened and its header parsed once, on first use, and
+  // kept until another file is set: loads only issue data reads then.
+  std::unique_ptr<gio::GenericIO> reader;
+  std::vector<gio::GenericIO::VariableInfo> variables;
+  std::vector<size_t> rank_elems;                   // per data rank
+  std::vector<std::array<int, 3>> rank_coords;      // per data rank
+  int split_dims[3] {0, 0, 0};
+  int nb_data_ranks = 0;
 };
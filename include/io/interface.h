@@ -53,7 +53,7 @@ public:
 	size_t getNumElements() const { return local_nb_elems; }
 	size_t* getSizePerDim() { return size_per_dim; }
 	size_t getTypeSize() const { return elem_size; }
-	std::string getType() const { return gio::to_string(data_type); }
+	gio::Type getType() const { return data_type; }
 	std::string getParam() const { return param; }
 	std::string getLog() const { return log.str(); }
 
@@ -38,6 +38,7 @@
 
 #include "utils/json.h"
 #include "utils/tools.h"
+#include "utils/histogram.h"
 #include "io/interface.h"
 #include "io/hacc.h"
 
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+/* -------------------------------------------------------------------------- */
+#include <cmath>
+#include <string>
+#include <vector>
+#include <mpi.h>
+
+#if HAVE_FFTW
+  #include <fftw3-mpi.h>
+#endif
+/* -------------------------------------------------------------------------- */
+/*
+ * matter power spectrum of particle positions in a periodic box.
+ * - particles are deposited on a cells³ grid with cloud-in-cell weights.
+ *   each rank owns the x-slab that fftw assigns to it: particles are sent
+ *   to the owner of their first plane, and the contributions to the plane
+ *   after the slab are added to the next one in a single exchange.
+ * - the density contrast is transformed in place by fftw-mpi, deconvolved
+ *   from the cloud-in-cell window, and |δ(k)|² is averaged over shells of
+ *   width 2π/box centered on multiples of it, in a single reduction.
+ * - spectra are written as 'k P(k) error modes' lines, and read back from
+ *   such files or those of hacc_pk_gio_auto, of which only k and P(k) are
+ *   kept.
+ */
+class PowerSpectrum {
+
+public:
+   PowerSpectrum() = default;
+   PowerSpectrum(int in_nb_cells, double in_box_size, MPI_Comm in_comm);
+  ~PowerSpectrum() = default;
+
+  bool compute(float const* x, float const* y, float const* z, size_t n);
+  double compare(PowerSpectrum const& reference, double k_max = 0.) const;
+  double interpolate(double k) const;
+
+  bool load(std::string const& path);
+  bool dump(std::string const& path) const;
+
+  size_t size() const { return wavenumber.size(); }
+  double getBoxSize() const { return box_size; }
+  std::vector<double> const& getWavenumbers() const { return wavenumber; }
+  std::vector<double> const& getPower() const { return power; }
+  std::vector<double> const& getModes() const { return modes; }
+
+private:
+  void deposit(float const* x, float const* y, float const* z, size_t n,
+               double* slab, long first, long extent);
+
+  int nb_cells = 0;
+  double box_size = 0.;
+
+  // shells
+  std::vector<double> wavenumber;
+  std::vector<double> power;
+  std::vector<double> modes;
+
+  // MPI
+  int my_rank = 0;
+  int nb_ranks = 1;
+  MPI_Comm comm = MPI_COMM_NULL;
+};
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+/* -------------------------------------------------------------------------- */
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+/* -------------------------------------------------------------------------- */
+/*
+ * non-owning view on a contiguous byte range.
+ * used to pass caller-owned buffers to compression kernels.
+ */
+struct Span {
+  void* data = nullptr;
+  size_t size = 0;           // in bytes
+};
+
+/* -------------------------------------------------------------------------- */
+/*
+ * growable scratch buffer meant to be reused across calls.
+ * it only reallocates when a larger capacity is requested,
+ * so that steady-state compression loops do not touch the heap.
+ */
+class Buffer {
+
+public:
+   Buffer() = default;
+   Buffer(Buffer const&) = delete;
+   Buffer(Buffer&& other) noexcept : raw(other.raw), capacity(other.capacity) {
+     other.raw = nullptr;
+     other.capacity = 0;
+   }
+  ~Buffer() { std::free(raw); }
+
+  Span reserve(size_t bytes) {
+    if (bytes > capacity) {
+      std::free(raw);
+      raw = std::malloc(bytes);
+      if (raw == nullptr)
+        throw std::bad_alloc();
+      capacity = bytes;
+    }
+    return { raw, capacity };
+  }
+
+  void release() {
+    std::free(raw);
+    raw = nullptr;
+    capacity = 0;
+  }
+
+  void* data() const { return raw; }
+  size_t size() const { return capacity; }
+  Span span() const { return { raw, capacity }; }
+
+private:
+  void* raw = nullptr;
+  size_t capacity = 0;
+};
+/* -------------------------------------------------------------------------- */
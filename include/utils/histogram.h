@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+/* -------------------------------------------------------------------------- */
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mpi.h>
+/* -------------------------------------------------------------------------- */
+/*
+ * distributed histogram with fixed bins.
+ * - bins split [lower, upper] evenly, or evenly in log scale: values out
+ *   of range, and non-positive ones in log scale, fall in the first or
+ *   last bin.
+ * - 'add' fills thread-private bins merged once per thread, and 'reduce'
+ *   sums the counts of all ranks in a single collective.
+ * - 'dump' writes '<path>.csv' (lower edge, upper edge, count per line)
+ *   or '<path>.bin': nb_bins and scale as uint64, lower and upper as
+ *   double, then the counts as uint64.
+ */
+class Histogram {
+
+public:
+  enum Scale : uint64_t { Linear = 0, Log = 1 };
+  enum Format { CSV, Binary };
+
+   Histogram() = default;
+   Histogram(size_t in_nb_bins, double in_lower, double in_upper, Scale in_scale = Linear);
+  ~Histogram() = default;
+
+  size_t getBin(double value) const {
+    if (not (value > lower))
+      return 0;
+    double const position = (scale == Log ? std::log(value) - start : value - start) * factor;
+    return position < last ? static_cast<size_t>(position) : last;
+  }
+
+  template <typename T>
+  void add(T const* values, size_t n) {
+    #pragma omp parallel
+    {
+      std::vector<uint64_t> local(counts.size(), 0);
+
+      #pragma omp for schedule(static) nowait
+      for (size_t i = 0; i < n; ++i)
+        local[getBin(values[i])]++;
+
+      #pragma omp critical
+      merge(local.data());
+    }
+  }
+
+  void merge(uint64_t const* partial);
+  void reduce(MPI_Comm comm);
+  void clear() { std::fill(counts.begin(), counts.end(), 0); }
+
+  size_t size() const { return counts.size(); }
+  double getEdge(size_t k) const;
+  uint64_t getTotal() const;
+  std::vector<uint64_t>& getCounts() { return counts; }
+  std::vector<uint64_t> const& getCounts() const { return counts; }
+
+  bool dump(std::string const& path, Format format = CSV) const;
+
+private:
+  double lower = 0.;
+  double upper = 1.;
+  Scale scale = Linear;
+  double start = 0.;            // lower, or its log
+  double factor = 1.;           // bins per unit, linear or log
+  size_t last = 0;
+  std::vector<uint64_t> counts;
+};
+/* -------------------------------------------------------------------------- */
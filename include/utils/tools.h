@@ -33,6 +33,7 @@
 /* -------------------------------------------------------------------------- */
 #include <string>
 #include <sstream>
+#include <vector>
 #include <sys/stat.h>
 /* -------------------------------------------------------------------------- */
 namespace tools {
@@ -44,6 +45,12 @@ namespace tools {
   void ltrim(std::string& line);
   bool isPowerOfTwo(int n);
   std::string extractFileName(std::string const& input);
+  std::vector<std::string> split(std::string const& input, char delimiter);
+  void stack(void const* column, size_t index, size_t nb_columns, size_t numel,
+             size_t type_size, bool interleave, void* output);
+  void unstack(void const* input, size_t index, size_t nb_columns, size_t numel,
+               size_t type_size, bool interleave, void* column);
+  double percentile(std::vector<double> values, double p);
   bool valid(int argc, char **argv, int rank= 0, int nb_ranks= 1);
   void dump(std::string const& path, std::string const& content, std::string const& ext="");
   void append(std::string const& path, std::string const& content, std::string const& ext="");
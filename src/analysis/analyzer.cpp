@@ -122,33 +122,17 @@ bool Analyzer::computeFrequencies(int i, float* data) {
 
     debug_log << "num_bins: " << num_bins << std::endl;
 
-    long local_histogram[num_bins];
-    long total_histogram[num_bins];
-
-    std::fill(local_histogram, local_histogram + num_bins, 0);
-    std::fill(total_histogram, total_histogram + num_bins, 0);
-
-    double range = total_max - total_min;
-    double capacity = range / num_bins;
-
-    for (auto k=0; k < n; ++k) {
-      double relative_value = (data[k] - total_min) / range;
-      int index = static_cast<int>((range * relative_value) / capacity);
-
-      if (index >= num_bins)
-        index--;
-
-      local_histogram[index]++;
-    }
-
-    MPI_Allreduce(local_histogram, total_histogram, num_bins, MPI_LONG, MPI_SUM, comm);
+    Histogram histogram(num_bins, total_min, total_max);
+    histogram.add(data, n);
+    histogram.reduce(comm);
 
     // fill frequency eventually
+    auto const& counts = histogram.getCounts();
     frequency[i].clear();
     frequency[i].resize(num_bins);
 
     for (int j=0; j < num_bins; ++j)
-      frequency[i][j] = double(total_histogram[j]) / n;
+      frequency[i][j] = double(counts[j]) / n;
 
     return true;
   }
@@ -411,28 +395,37 @@ void Analyzer::filterParticles() {
 }
 
 /* -------------------------------------------------------------------------- */
-void Analyzer::extractNonHalos(int i) {
+void Analyzer::extractNonHalos() {
 
-  assert(i < num_scalars);
-
-  debug_log << "Cache non-halos particles data '"<< scalars[i] <<"'"<< std::endl;
+  debug_log << "Cache non-halos particles data ";
+  for (auto&& scalar : scalars)
+    debug_log << "'"<< scalar <<"' ";
+  debug_log << std::endl;
 
   ioMgr->filename = input_full;
 
-  if (ioMgr->load(scalars[i])) {
+  // every scalar is read in a single pass
+  std::vector<std::vector<float>> loaded(num_scalars);
+  std::vector<HACCDataLoader::Binding> targets;
+
+  for (int i = 0; i < num_scalars; ++i)
+    targets.push_back(HACCDataLoader::bind(scalars[i], loaded[i]));
+
+  if (ioMgr->load(targets)) {
     size_t const n = ioMgr->getNumElements();
     assert(n == local_parts);
-    non_halos[i].reserve(n);
-    auto data = static_cast<float*>(ioMgr->data);
 
-    for (auto k=0; k < local_parts; ++k) {
-      if (not is_halo[k]) {
-        non_halos[i].push_back(data[k]);
+    for (int i = 0; i < num_scalars; ++i) {
+      non_halos[i].reserve(n);
+      auto const* data = loaded[i].data();
+
+      for (auto k=0; k < local_parts; ++k) {
+        if (not is_halo[k]) {
+          non_halos[i].push_back(data[k]);
+        }
       }
     }
 
-    ioMgr->close();
-
     debug_log << "= local: "<< n << std::endl;
     debug_log << "= total: "<< total_parts << std::endl << std::endl;
     MPI_Barrier(comm);
@@ -638,9 +631,10 @@ bool Analyzer::run() {
     // set non halos lookup table and store metadata
     filterParticles();
 
+    // extract and store non-halo scalar data
+    extractNonHalos();
+
     for (int i = 0; i < num_scalars; ++i) {
-      // extract and store non-halo scalar data
-      extractNonHalos(i);
       computeFrequencies(i, non_halos[i].data());
       computeShannonEntropy(i);
       MPI_Barrier(comm);
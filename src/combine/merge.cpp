@@ -85,21 +85,19 @@ size_t Merger::cache(long offset) {
     ioMgr->setSave(true);
   }
 
-  for (int i=0; i < num_scalars; ++i) {
-    if (ioMgr->load(scalars[i])) {
-      auto const n = ioMgr->getNumElements();
-      auto const data = static_cast<float*>(ioMgr->data);
-      dataset[i].resize(n + offset);
-      std::copy(data, data + n, dataset[i].data() + offset);
-    }
-    MPI_Barrier(comm);
-  }
-
-  if (ioMgr->load("id")) {
-    auto const n = ioMgr->getNumElements();
-    auto const data = static_cast<long*>(ioMgr->data);
-    index.resize(n + offset);
-    std::copy(data, data + n, index.data() + offset);
+  // scalars and id are read in a single pass,
+  // directly after the already cached particles.
+  std::vector<HACCDataLoader::Binding> targets;
+
+  for (int i=0; i < num_scalars; ++i)
+    targets.push_back(HACCDataLoader::bind(scalars[i], dataset[i], offset));
+  targets.push_back(HACCDataLoader::bind("id", index, offset));
+
+  // a single unknown or mistyped column leaves all of them unloaded
+  if (not ioMgr->load(targets)) {
+    if (my_rank == 0)
+      std::cerr << "Error: cannot load scalars and 'id' from " << ioMgr->filename << std::endl;
+    MPI_Abort(comm, EXIT_FAILURE);
   }
 
   if (my_rank == 0 and save) {
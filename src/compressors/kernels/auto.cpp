@@ -0,0 +1,516 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include "compressors/kernels/auto.hpp"
+#include "compressors/kernels/factory.h"
+#include "utils/tools.h"
+#include "utils/timer.h"
+/* -------------------------------------------------------------------------- */
+static std::string toString(double value) {
+  std::ostringstream stream;
+  stream << value;
+  return stream.str();
+}
+
+/* -------------------------------------------------------------------------- */
+static double maxError(void const* original, void const* approx, size_t n, gio::Type type) {
+  return gio::dispatch(type, [&](auto* tag) {
+    using T = std::remove_pointer_t<decltype(tag)>;
+    auto const* a = static_cast<T const*>(original);
+    auto const* b = static_cast<T const*>(approx);
+
+    double error = 0.;
+    for (size_t i = 0; i < n; ++i)
+      error = std::max(error, std::abs(double(a[i]) - double(b[i])));
+    return error;
+  });
+}
+
+/* -------------------------------------------------------------------------- */
+void AutoCompressor::setup() {
+
+  MPI_Comm_rank(comm, &rank);
+
+  if (parameters.count("bound"))
+    bound = std::stod(parameters["bound"]);
+  if (parameters.count("ratio"))
+    ratio_floor = std::stod(parameters["ratio"]);
+  if (parameters.count("sample"))
+    fraction = std::stod(parameters["sample"]);
+
+  // load previous decisions once
+  if (parameters.count("profile") and parameters["profile"] != profile_path) {
+    profile_path = parameters["profile"];
+    profile = nlohmann::json::object();
+
+    std::ifstream file(profile_path);
+    if (file.good())
+      file >> profile;
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+void AutoCompressor::close() {
+  for (auto&& kernel : kernels)
+    kernel.second->close();
+  kernels.clear();
+}
+
+/* -------------------------------------------------------------------------- */
+std::string AutoCompressor::encode(std::string const& kernel, Params const& params) {
+  std::string config = kernel;
+  for (auto&& param : params)
+    config += ";" + param.first + "=" + param.second;
+  return config;
+}
+
+/* -------------------------------------------------------------------------- */
+bool AutoCompressor::decode(std::string const& config, std::string& kernel, Params& params) {
+  auto const tokens = tools::split(config, ';');
+  if (tokens.empty())
+    return false;
+
+  kernel = tokens[0];
+  params.clear();
+  for (size_t i = 1; i < tokens.size(); ++i) {
+    auto const pos = tokens[i].find('=');
+    if (pos == std::string::npos)
+      return false;
+    params[tokens[i].substr(0, pos)] = tokens[i].substr(pos + 1);
+  }
+  return true;
+}
+
+/* -------------------------------------------------------------------------- */
+std::vector<AutoCompressor::Trial> AutoCompressor::getLadder(std::string const& kernel) const {
+
+  std::vector<Trial> ladder;
+  auto add = [&](Params params) { ladder.push_back({kernel, std::move(params)}); };
+
+  if (kernel == "sz" or kernel == "zfp" or kernel == "lorenzo") {
+    // error-bounded: try the bound itself then tighter ones
+    if (bound > 0.) {
+      for (double step : {1., 0.5, 0.1})
+        add({{"abs", toString(bound * step)}});
+    }
+  } else if (kernel == "fpzip") {
+    for (int bits : {16, 20, 24, 28, 32})
+      add({{"bits", std::to_string(bits)}});
+  } else if (kernel == "bitgroom") {
+    for (int bits : {8, 12, 16, 20})
+      add({{"bits", std::to_string(bits)}});
+  } else if (kernel == "fpc") {
+    add({{"predictor", "fcm"}});
+    add({{"predictor", "xor"}});
+  } else if (kernel != "isabela") {
+    add({});   // parameter free or lossless
+  }
+  return ladder;
+}
+
+/* -------------------------------------------------------------------------- */
+std::string AutoCompressor::getKernels() const {
+  if (parameters.count("kernels"))
+    return parameters.at("kernels");
+
+  std::string names;
+  for (auto&& kernel : CompressorFactory::available())
+    names += (names.empty() ? "" : "+") + kernel;
+  return names;
+}
+
+/* -------------------------------------------------------------------------- */
+std::vector<AutoCompressor::Trial> AutoCompressor::getCandidates() const {
+
+  std::vector<Trial> candidates;
+  for (auto&& kernel : tools::split(getKernels(), '+')) {
+    if (kernel == "auto" or kernel == "chain")
+      continue;
+    auto const ladder = getLadder(kernel);
+    candidates.insert(candidates.end(), ladder.begin(), ladder.end());
+  }
+  return candidates;
+}
+
+/* -------------------------------------------------------------------------- */
+CompressorInterface* AutoCompressor::use(std::string const& kernel, Params const& params) {
+
+  auto found = kernels.find(kernel);
+  if (found == kernels.end()) {
+    std::unique_ptr<CompressorInterface> instance(CompressorFactory::create(kernel));
+    if (instance == nullptr)
+      return nullptr;
+    instance->init();
+    found = kernels.emplace(kernel, std::move(instance)).first;
+  }
+
+  found->second->parameters = params;
+  return found->second.get();
+}
+
+/* -------------------------------------------------------------------------- */
+AutoCompressor::Trial AutoCompressor::evaluate(
+  Trial trial, Span input, gio::Type type, size_t type_size, size_t numel) {
+
+  auto kernel = use(trial.kernel, trial.params);
+  size_t dims[] = {numel, 0, 0, 0, 0};
+  int status = (kernel != nullptr ? EXIT_SUCCESS : EXIT_FAILURE);
+  unsigned long local_bytes[] = {0, numel * type_size};
+  double local_time = 0.;
+  double local_error = 0.;
+
+  // kernels report unsupported types as failures
+  if (kernel != nullptr and numel > 0) {
+    Span output = zipped.reserve(kernel->maxCompressedSize(type, type_size, dims));
+    Span raw = unzipped.reserve(numel * type_size);
+
+    Timer timer;
+    timer.start();
+    status = kernel->compress(input, output, type, type_size, dims);
+    timer.stop();
+
+    local_time = timer.getDuration();
+    local_bytes[0] = kernel->getBytes();
+
+    if (status == EXIT_SUCCESS)
+      status = kernel->decompress({output.data, local_bytes[0]}, raw, type, type_size, dims);
+    if (status == EXIT_SUCCESS)
+      local_error = maxError(input.data, raw.data, numel, type);
+    kernel->clearLog();
+  }
+
+  // trials are collective so that all ranks take the same decision
+  int local_failed = (status != EXIT_SUCCESS);
+  int total_failed = 0;
+  unsigned long total_bytes[] = {0, 0};
+  double max_time = 0.;
+  double max_error = 0.;
+
+  MPI_Allreduce(&local_failed, &total_failed, 1, MPI_INT, MPI_MAX, comm);
+  MPI_Allreduce(local_bytes, total_bytes, 2, MPI_UNSIGNED_LONG, MPI_SUM, comm);
+  MPI_Allreduce(&local_time, &max_time, 1, MPI_DOUBLE, MPI_MAX, comm);
+  MPI_Allreduce(&local_error, &max_error, 1, MPI_DOUBLE, MPI_MAX, comm);
+
+  double const megabytes = total_bytes[1] / (1024. * 1024.);
+  trial.valid = (not total_failed and total_bytes[0] > 0);
+  trial.ratio = trial.valid ? total_bytes[1] / double(total_bytes[0]) : 0.;
+  trial.throughput = megabytes / std::max(max_time, std::numeric_limits<double>::epsilon());
+  trial.error = max_error;
+  return trial;
+}
+
+/* -------------------------------------------------------------------------- */
+AutoCompressor::Trial AutoCompressor::select(
+  Span input, gio::Type type, size_t type_size, size_t* n) {
+
+  // stratified sample: one contiguous run per stratum to keep locality
+  size_t const numel = getNumElements(n);
+  size_t const strata = 32;
+  size_t const length = std::max<size_t>(1, std::ceil(numel * fraction / strata));
+  size_t count = 0;
+
+  if (numel <= strata * length) {
+    count = numel;
+    std::memcpy(sample.reserve(numel * type_size).data, input.data, numel * type_size);
+  } else {
+    count = strata * length;
+    auto* target = static_cast<char*>(sample.reserve(count * type_size).data);
+    auto const* source = static_cast<char const*>(input.data);
+    size_t const stride = numel / strata;
+
+    for (size_t s = 0; s < strata; ++s) {
+      std::memcpy(
+        target + s * length * type_size,
+        source + s * stride * type_size,
+        length * type_size
+      );
+    }
+  }
+
+  std::vector<Trial> trials;
+  for (auto&& candidate : getCandidates())
+    trials.push_back(evaluate(candidate, {sample.data(), count * type_size}, type, type_size, count));
+
+  // fastest feasible one, or the best compromise on the error otherwise
+  Trial const* best = nullptr;
+  for (auto&& trial : trials) {
+    if (not trial.valid or trial.error > bound or trial.ratio < ratio_floor)
+      continue;
+    if (best == nullptr or trial.throughput > best->throughput)
+      best = &trial;
+  }
+
+  if (best == nullptr) {
+    for (auto&& trial : trials) {
+      if (not trial.valid)
+        continue;
+      if (best == nullptr or trial.error < best->error
+          or (trial.error == best->error and trial.ratio > best->ratio))
+        best = &trial;
+    }
+    log << name << " ~ no configuration meets the bound and ratio floor";
+    log << ", falling back to the most accurate one" << std::endl;
+  }
+
+  Trial const selected = (best != nullptr ? *best : Trial {});
+  record(parameters.count("scalar") ? parameters["scalar"] : "default", selected, trials);
+  return selected;
+}
+
+/* -------------------------------------------------------------------------- */
+void AutoCompressor::record(
+  std::string const& key, Trial const& best, std::vector<Trial> const& trials) {
+
+  nlohmann::json entry;
+  entry["kernel"] = best.kernel;
+  entry["params"] = best.params;
+  entry["ratio"] = best.ratio;
+  entry["throughput"] = best.throughput;
+  entry["error"] = best.error;
+  entry["bound"] = bound;
+  entry["ratio_floor"] = ratio_floor;
+  entry["kernels"] = getKernels();
+
+  for (auto&& trial : trials) {
+    entry["trials"].push_back({
+      {"kernel", trial.kernel}, {"params", trial.params}, {"valid", trial.valid},
+      {"ratio", trial.ratio}, {"throughput", trial.throughput}, {"error", trial.error}
+    });
+    log << name << " ~ trial " << encode(trial.kernel, trial.params);
+    log << ", ratio: " << trial.ratio << ", throughput: " << trial.throughput;
+    log << " MB/s, error: " << trial.error << std::endl;
+  }
+
+  // power-law fit of ratio and throughput against error for each kernel:
+  // log(y) = a + b * log(error), by least squares over the ladder.
+  // kept in the profile for inspection, the selection uses raw trials.
+  std::map<std::string, std::vector<Trial const*>> points;
+  for (auto&& trial : trials) {
+    if (trial.valid and trial.error > 0.)
+      points[trial.kernel].push_back(&trial);
+  }
+
+  for (auto&& kernel : points) {
+    auto const& samples = kernel.second;
+    if (samples.size() < 2)
+      continue;
+
+    auto fit = [&](auto&& value) {
+      double sx = 0., sy = 0., sxx = 0., sxy = 0.;
+      double const m = samples.size();
+      for (auto&& trial : samples) {
+        double const x = std::log(trial->error);
+        double const y = std::log(value(*trial));
+        sx += x; sy += y; sxx += x * x; sxy += x * y;
+      }
+      double const det = m * sxx - sx * sx;
+      double const b = (std::abs(det) > 0. ? (m * sxy - sx * sy) / det : 0.);
+      double const a = (sy - b * sx) / m;
+      return std::vector<double>{a, b};
+    };
+
+    auto const ratio = fit([](Trial const& t) { return t.ratio; });
+    auto const speed = fit([](Trial const& t) { return t.throughput; });
+    entry["fits"][kernel.first] = {{"ratio", ratio}, {"throughput", speed}};
+
+    log << name << " ~ fit " << kernel.first << ": ratio ~ " << std::exp(ratio[0]);
+    log << " * error^" << ratio[1] << ", throughput ~ " << std::exp(speed[0]);
+    log << " * error^" << speed[1] << std::endl;
+  }
+
+  log << name << " ~ selected for " << key << ": " << encode(best.kernel, best.params);
+  log << std::endl;
+
+  profile[key] = entry;
+  if (rank == 0 and not profile_path.empty()) {
+    std::ofstream file(profile_path);
+    file << profile.dump(2) << std::endl;
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+size_t AutoCompressor::maxCompressedSize
+  (gio::Type type, size_t type_size, size_t* n) {
+
+  setup();
+
+  // the actual choice depends on data, so bound over all candidates
+  size_t bound_bytes = 0;
+  for (auto&& candidate : getCandidates()) {
+    auto kernel = use(candidate.kernel, candidate.params);
+    if (kernel == nullptr)
+      continue;
+
+    size_t const header = sizeof(uint32_t) + encode(candidate.kernel, candidate.params).size();
+    bound_bytes = std::max(bound_bytes, header + kernel->maxCompressedSize(type, type_size, n));
+  }
+
+  // decisions loaded from a profile may use other kernels
+  for (auto&& entry : profile) {
+    if (not entry.count("kernel") or not entry.count("params"))
+      continue;
+
+    std::string const kernel_name = entry["kernel"];
+    Params const params = entry["params"];
+    auto kernel = use(kernel_name, params);
+    if (kernel == nullptr)
+      continue;
+
+    size_t const header = sizeof(uint32_t) + encode(kernel_name, params).size();
+    bound_bytes = std::max(bound_bytes, header + kernel->maxCompressedSize(type, type_size, n));
+  }
+  return bound_bytes;
+}
+
+/* -------------------------------------------------------------------------- */
+std::string AutoCompressor::getKey() const {
+  return parameters.count("scalar") ? parameters.at("scalar") : "default";
+}
+
+/* -------------------------------------------------------------------------- */
+// runs the trials unless the profile already holds a decision for the key,
+// the outcome is kept there as well, with no kernel if none was valid.
+bool AutoCompressor::decide(Span input, gio::Type type, size_t type_size, size_t* n) {
+
+  std::string const key = getKey();
+  if (not profile.count(key) or not reusable(profile[key]))
+    select(input, type, type_size, n);
+
+  return not profile[key]["kernel"].get<std::string>().empty();
+}
+
+/* -------------------------------------------------------------------------- */
+// a decision made for a looser bound may break the current one
+bool AutoCompressor::reusable(nlohmann::json const& entry) const {
+  return entry.count("kernel") and entry.count("bound") and entry.count("ratio_floor")
+     and entry.count("kernels") and entry["bound"].get<double>() == bound
+     and entry["ratio_floor"].get<double>() == ratio_floor
+     and entry["kernels"].get<std::string>() == getKernels();
+}
+
+/* -------------------------------------------------------------------------- */
+void AutoCompressor::prepare
+  (Span input, gio::Type type, size_t type_size, size_t* n) {
+
+  setup();
+  decide(input, type, type_size, n);
+}
+
+/* -------------------------------------------------------------------------- */
+int AutoCompressor::compress
+  (Span input, Span output, gio::Type type, size_t type_size, size_t* n) {
+
+  setup();
+
+  // decided in 'prepare' unless the caller skipped it
+  std::string const key = getKey();
+  if (not decide(input, type, type_size, n)) {
+    std::cerr << "Compression failed: no valid configuration for " << key << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::string const kernel_name = profile[key]["kernel"].get<std::string>();
+  Params const params = profile[key]["params"].get<Params>();
+  log << name << " ~ using for " << key << ": " << encode(kernel_name, params) << std::endl;
+
+  auto kernel = use(kernel_name, params);
+  if (kernel == nullptr) {
+    std::cerr << "Compression failed: unsupported kernel " << kernel_name << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::string const config = encode(kernel_name, params);
+  auto const length = static_cast<uint32_t>(config.size());
+  size_t const header = sizeof(uint32_t) + length;
+
+  if (output.size < header) {
+    std::cerr << "Compression failed: output buffer too small" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  auto* raw = static_cast<char*>(output.data);
+  std::memcpy(raw, &length, sizeof(uint32_t));
+  std::memcpy(raw + sizeof(uint32_t), config.data(), length);
+
+  Span payload { raw + header, output.size - header };
+  if (kernel->compress(input, payload, type, type_size, n) != EXIT_SUCCESS)
+    return EXIT_FAILURE;
+
+  bytes = header + kernel->getBytes();
+  threads = kernel->getThreads();
+  log << kernel->getLog();
+  kernel->clearLog();
+  return EXIT_SUCCESS;
+}
+
+/* -------------------------------------------------------------------------- */
+int AutoCompressor::decompress
+  (Span input, Span output, gio::Type type, size_t type_size, size_t* n) {
+
+  uint32_t length = 0;
+  if (input.size < sizeof(uint32_t)) {
+    std::cerr << "Decompression failed: truncated input" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::memcpy(&length, input.data, sizeof(uint32_t));
+  size_t const header = sizeof(uint32_t) + length;
+  if (input.size < header) {
+    std::cerr << "Decompression failed: truncated input" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  auto const* raw = static_cast<char const*>(input.data);
+  std::string kernel_name;
+  Params params;
+
+  if (not decode(std::string(raw + sizeof(uint32_t), length), kernel_name, params)) {
+    std::cerr << "Decompression failed: invalid configuration" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  auto kernel = use(kernel_name, params);
+  if (kernel == nullptr) {
+    std::cerr << "Decompression failed: unsupported kernel " << kernel_name << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  Span payload { const_cast<char*>(raw) + header, input.size - header };
+  int status = kernel->decompress(payload, output, type, type_size, n);
+  log << kernel->getLog();
+  kernel->clearLog();
+  return status;
+}
+/* -------------------------------------------------------------------------- */
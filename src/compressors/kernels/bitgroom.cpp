@@ -0,0 +1,476 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <omp.h>
+#if ENABLE_BLOSC
+  #include "blosc.h"
+#endif
+#include "compressors/kernels/bitgroom.hpp"
+#include "utils/timer.h"
+/* -------------------------------------------------------------------------- */
+namespace {
+
+  struct Header {
+    uint64_t numel;
+    uint64_t payload;
+    uint8_t type_size;
+    uint8_t shuffle;
+    uint8_t backend;
+    uint8_t keep;
+    uint32_t padding;
+  };
+
+  // transpose a 8x8 bit matrix stored row-wise in a 64-bit word
+  inline uint64_t transpose(uint64_t x) {
+    uint64_t t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+    x = x ^ t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+    x = x ^ t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+    return x ^ t ^ (t << 28);
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+void BitGroomCompressor::init() {}
+
+/* -------------------------------------------------------------------------- */
+void BitGroomCompressor::close() {
+  scratch[0].release();
+  scratch[1].release();
+}
+
+/* -------------------------------------------------------------------------- */
+int BitGroomCompressor::getKeptBits(size_t type_size) const {
+  int const mantissa = (type_size == sizeof(double) ? 52 : 23);
+  if (not lossy)
+    return mantissa;
+
+  int keep = 16;
+  if (parameters.count("bits"))
+    keep = std::stoi(parameters.at("bits"));
+  else if (parameters.count("digits"))
+    keep = static_cast<int>(std::ceil(std::stod(parameters.at("digits")) * std::log2(10.)));
+
+  return std::max(0, std::min(keep, mantissa));
+}
+
+/* -------------------------------------------------------------------------- */
+BitGroomCompressor::Shuffle BitGroomCompressor::getShuffle() const {
+  auto const found = parameters.find("shuffle");
+  if (found == parameters.end() or found->second == "byte")
+    return Byte;
+  return found->second == "bit" ? Bit : None;
+}
+
+/* -------------------------------------------------------------------------- */
+BitGroomCompressor::Backend BitGroomCompressor::getBackend() const {
+#if ENABLE_BLOSC
+  auto const found = parameters.find("codec");
+  return (found != parameters.end() and found->second == "none") ? Elide : Blosc;
+#else
+  return Elide;
+#endif
+}
+
+/* -------------------------------------------------------------------------- */
+int BitGroomCompressor::getThreads() const {
+  auto const found = parameters.find("threads");
+  return found != parameters.end() ? std::max(1, std::stoi(found->second)) : omp_get_max_threads();
+}
+
+/* -------------------------------------------------------------------------- */
+template <typename T>
+void BitGroomCompressor::groom(
+  T const* input, size_t numel, int keep, bool shuffled, uint8_t* output) {
+
+  using U = std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>;
+  constexpr int mantissa = std::numeric_limits<T>::digits - 1;
+  constexpr U exponent = (~U(0) >> 1) & ~((U(1) << mantissa) - 1);
+  constexpr size_t size = sizeof(T);
+
+  int const drop = mantissa - keep;
+  U const mask = ~((U(1) << drop) - 1);
+  U const half = U(1) << (drop - 1);
+  long const count = numel;
+
+  // round to nearest, but keep non finite values and do not overflow to them
+  auto round = [=](U value) {
+    U const rounded = (value + half) & mask;
+    if ((value & exponent) == exponent)
+      return value;
+    return (rounded & exponent) == exponent ? U(value & mask) : rounded;
+  };
+
+  if (shuffled) {
+    #pragma omp parallel for simd schedule(static) num_threads(getThreads())
+    for (long i = 0; i < count; ++i) {
+      U value;
+      std::memcpy(&value, input + i, size);
+      value = round(value);
+      for (size_t b = 0; b < size; ++b)
+        output[b * numel + i] = static_cast<uint8_t>(value >> (8 * b));
+    }
+  } else {
+    #pragma omp parallel for simd schedule(static) num_threads(getThreads())
+    for (long i = 0; i < count; ++i) {
+      U value;
+      std::memcpy(&value, input + i, size);
+      value = round(value);
+      std::memcpy(output + i * size, &value, size);
+    }
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+void BitGroomCompressor::byteShuffle(
+  uint8_t const* input, size_t numel, size_t type_size, uint8_t* output) {
+
+  long const count = numel;
+
+  // one byte plane after the other, so that stores are contiguous
+  #pragma omp parallel num_threads(getThreads())
+  for (size_t b = 0; b < type_size; ++b) {
+    uint8_t const* source = input + b;
+    uint8_t* target = output + b * numel;
+
+    #pragma omp for simd schedule(static)
+    for (long i = 0; i < count; ++i)
+      target[i] = source[i * type_size];
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+void BitGroomCompressor::byteUnshuffle(
+  uint8_t const* input, size_t numel, size_t type_size, uint8_t* output) {
+
+  long const count = numel;
+
+  // one byte plane after the other, so that loads are contiguous
+  #pragma omp parallel num_threads(getThreads())
+  for (size_t b = 0; b < type_size; ++b) {
+    uint8_t const* source = input + b * numel;
+    uint8_t* target = output + b;
+
+    #pragma omp for simd schedule(static)
+    for (long i = 0; i < count; ++i)
+      target[i * type_size] = source[i];
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+void BitGroomCompressor::bitShuffle(
+  uint8_t const* input, size_t numel, size_t type_size, uint8_t* output) {
+
+  // on byte shuffled data: each byte plane is split into bit planes
+  long const groups = numel / 8;
+  size_t const tail = numel % 8;
+
+  for (size_t p = 0; p < type_size; ++p) {
+    uint8_t const* source = input + p * numel;
+    uint8_t* target = output + p * numel;
+
+    #pragma omp parallel for schedule(static) num_threads(getThreads())
+    for (long g = 0; g < groups; ++g) {
+      uint64_t word;
+      std::memcpy(&word, source + 8 * g, 8);
+      word = transpose(word);
+      for (int j = 0; j < 8; ++j)
+        target[j * groups + g] = static_cast<uint8_t>(word >> (8 * j));
+    }
+    std::memcpy(target + 8 * groups, source + 8 * groups, tail);
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+void BitGroomCompressor::bitUnshuffle(
+  uint8_t const* input, size_t numel, size_t type_size, uint8_t* output) {
+
+  long const groups = numel / 8;
+  size_t const tail = numel % 8;
+
+  for (size_t p = 0; p < type_size; ++p) {
+    uint8_t const* source = input + p * numel;
+    uint8_t* target = output + p * numel;
+
+    #pragma omp parallel for schedule(static) num_threads(getThreads())
+    for (long g = 0; g < groups; ++g) {
+      uint64_t word = 0;
+      for (int j = 0; j < 8; ++j)
+        word |= static_cast<uint64_t>(source[j * groups + g]) << (8 * j);
+      word = transpose(word);
+      std::memcpy(target + 8 * g, &word, 8);
+    }
+    std::memcpy(target + 8 * groups, source + 8 * groups, tail);
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+size_t BitGroomCompressor::elide(uint8_t const* input, size_t size, uint8_t* output) {
+
+  uint64_t const nb_chunks = (size + chunk - 1) / chunk;
+  size_t const bitmap = (nb_chunks + 7) / 8;
+  size_t const start = sizeof(uint64_t) + bitmap;
+  long const count = nb_chunks;
+
+  offsets.assign(nb_chunks + 1, 0);
+
+  #pragma omp parallel for schedule(static) num_threads(getThreads())
+  for (long c = 0; c < count; ++c) {
+    size_t const length = std::min(chunk, size - c * chunk);
+    uint8_t const* data = input + c * chunk;
+    uint8_t merged = 0;
+
+    #pragma omp simd reduction(|:merged)
+    for (size_t k = 0; k < length; ++k)
+      merged |= data[k];
+
+    offsets[c + 1] = (merged ? length : 0);
+  }
+
+  std::memcpy(output, &nb_chunks, sizeof(uint64_t));
+  std::memset(output + sizeof(uint64_t), 0, bitmap);
+  for (long c = 0; c < count; ++c) {
+    if (offsets[c + 1] > 0)
+      output[sizeof(uint64_t) + c / 8] |= static_cast<uint8_t>(1 << (c % 8));
+    offsets[c + 1] += offsets[c];
+  }
+
+  #pragma omp parallel for schedule(static) num_threads(getThreads())
+  for (long c = 0; c < count; ++c) {
+    size_t const length = offsets[c + 1] - offsets[c];
+    if (length > 0)
+      std::memcpy(output + start + offsets[c], input + c * chunk, length);
+  }
+
+  return start + offsets[nb_chunks];
+}
+
+/* -------------------------------------------------------------------------- */
+bool BitGroomCompressor::restore(
+  uint8_t const* input, size_t input_size, uint8_t* output, size_t size) {
+
+  uint64_t nb_chunks = 0;
+  if (input_size < sizeof(uint64_t))
+    return false;
+
+  std::memcpy(&nb_chunks, input, sizeof(uint64_t));
+  size_t const bitmap = (nb_chunks + 7) / 8;
+  size_t const start = sizeof(uint64_t) + bitmap;
+  long const count = nb_chunks;
+
+  if (nb_chunks != (size + chunk - 1) / chunk or input_size < start)
+    return false;
+
+  offsets.assign(nb_chunks + 1, 0);
+  for (long c = 0; c < count; ++c) {
+    bool const stored = input[sizeof(uint64_t) + c / 8] & (1 << (c % 8));
+    offsets[c + 1] = offsets[c] + (stored ? std::min(chunk, size - c * chunk) : 0);
+  }
+
+  if (start + offsets[nb_chunks] > input_size)
+    return false;
+
+  #pragma omp parallel for schedule(static) num_threads(getThreads())
+  for (long c = 0; c < count; ++c) {
+    size_t const length = std::min(chunk, size - c * chunk);
+    if (offsets[c + 1] > offsets[c])
+      std::memcpy(output + c * chunk, input + start + offsets[c], length);
+    else
+      std::memset(output + c * chunk, 0, length);
+  }
+  return true;
+}
+
+/* -------------------------------------------------------------------------- */
+size_t BitGroomCompressor::maxCompressedSize
+  (gio::Type type, size_t type_size, size_t* n) {
+
+  size_t const size = type_size * getNumElements(n);
+  size_t const nb_chunks = (size + chunk - 1) / chunk;
+  size_t overhead = sizeof(uint64_t) + (nb_chunks + 7) / 8;
+#if ENABLE_BLOSC
+  overhead = std::max<size_t>(overhead, BLOSC_MAX_OVERHEAD);
+#endif
+  return sizeof(Header) + size + overhead;
+}
+
+/* -------------------------------------------------------------------------- */
+int BitGroomCompressor::compress
+  (Span input, Span output, gio::Type type, size_t type_size, size_t* n) {
+
+  Timer timer;
+  timer.start();
+
+  size_t const numel = getNumElements(n);
+  size_t const size = numel * type_size;
+  bool const floating = (type == gio::Type::Float or type == gio::Type::Double);
+  int const keep = getKeptBits(type_size);
+  int const mantissa = (type_size == sizeof(double) ? 52 : 23);
+  bool const rounded = lossy and floating and keep < mantissa;
+
+  Shuffle const shuffle = getShuffle();
+  Backend const backend = getBackend();
+
+  if (output.size < maxCompressedSize(type, type_size, n)) {
+    std::cerr << "Compression failed: output buffer too small" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // step 1: round and shuffle in a single pass
+  auto* staged = static_cast<uint8_t*>(scratch[0].reserve(size).data);
+  auto const* raw = static_cast<uint8_t const*>(input.data);
+
+  if (rounded and type == gio::Type::Float)
+    groom(static_cast<float const*>(input.data), numel, keep, shuffle != None, staged);
+  else if (rounded and type == gio::Type::Double)
+    groom(static_cast<double const*>(input.data), numel, keep, shuffle != None, staged);
+  else if (shuffle != None)
+    byteShuffle(raw, numel, type_size, staged);
+  else
+    std::memcpy(staged, raw, size);
+
+  if (shuffle == Bit) {
+    auto* planes = static_cast<uint8_t*>(scratch[1].reserve(size).data);
+    bitShuffle(staged, numel, type_size, planes);
+    staged = planes;
+  }
+
+  // step 2: lossless backend
+  auto* target = static_cast<uint8_t*>(output.data) + sizeof(Header);
+  size_t payload = 0;
+
+  if (backend == Blosc) {
+#if ENABLE_BLOSC
+    size_t const capacity = output.size - sizeof(Header);
+    auto const found = parameters.find("codec");
+    std::string const codec = (found != parameters.end() ? found->second : "lz4");
+    int const clevel = parameters.count("clevel") ? std::stoi(parameters.at("clevel")) : 5;
+
+    int status = blosc_compress_ctx(
+      clevel, BLOSC_NOSHUFFLE, 1, size, staged, target, capacity,
+      codec.c_str(), 0, getThreads()
+    );
+
+    if (status <= 0) {
+      std::cerr << "Compression failed: " << status << std::endl;
+      return EXIT_FAILURE;
+    }
+    payload = static_cast<size_t>(status);
+#endif
+  } else {
+    payload = elide(staged, size, target);
+  }
+
+  Header const header {
+    numel, payload, static_cast<uint8_t>(type_size),
+    shuffle, backend, static_cast<uint8_t>(rounded ? keep : mantissa), 0
+  };
+  std::memcpy(output.data, &header, sizeof(Header));
+
+  bytes = sizeof(Header) + payload;
+  timer.stop();
+
+  log << std::endl << name;
+  log << " ~ InputBytes: " << size;
+  log << ", OutputBytes: " << bytes;
+  log << ", cRatio: " << (size / static_cast<float>(bytes));
+  log << ", #elements: " << numel << ", bits: " << int(header.keep) << std::endl;
+  log << name << " ~ CompressTime: " << timer.getDuration() << " s" << std::endl;
+  return EXIT_SUCCESS;
+}
+
+/* -------------------------------------------------------------------------- */
+int BitGroomCompressor::decompress
+  (Span input, Span output, gio::Type type, size_t type_size, size_t* n) {
+
+  Timer timer;
+  timer.start();
+
+  Header header {};
+  if (input.size < sizeof(Header)) {
+    std::cerr << "Decompression failed: truncated input" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::memcpy(&header, input.data, sizeof(Header));
+  size_t const numel = header.numel;
+  size_t const size = numel * type_size;
+
+  if (header.type_size != type_size or numel != getNumElements(n)
+      or output.size < size or input.size < sizeof(Header) + header.payload) {
+    std::cerr << "Decompression failed: inconsistent header" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // shuffled data goes through scratch buffers, the last step fills 'output'
+  auto* result = static_cast<uint8_t*>(output.data);
+  auto* staged = header.shuffle == None ? result : static_cast<uint8_t*>(scratch[1].reserve(size).data);
+  auto const* source = static_cast<uint8_t const*>(input.data) + sizeof(Header);
+
+  if (header.backend == Blosc) {
+#if ENABLE_BLOSC
+    int status = blosc_decompress_ctx(source, staged, size, getThreads());
+    if (status < 0) {
+      std::cerr << "Decompression failed: " << status << std::endl;
+      return EXIT_FAILURE;
+    }
+#else
+    std::cerr << "Decompression failed: blosc is not enabled" << std::endl;
+    return EXIT_FAILURE;
+#endif
+  } else if (not restore(source, header.payload, staged, size)) {
+    std::cerr << "Decompression failed: corrupted input" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (header.shuffle == Bit) {
+    auto* planes = static_cast<uint8_t*>(scratch[0].reserve(size).data);
+    bitUnshuffle(staged, numel, type_size, planes);
+    staged = planes;
+  }
+
+  if (header.shuffle != None)
+    byteUnshuffle(staged, numel, type_size, result);
+
+  timer.stop();
+  log << name << " ~ DecompressTime: " << timer.getDuration() << " s" << std::endl;
+  return EXIT_SUCCESS;
+}
+
+/* -------------------------------------------------------------------------- */
+template void BitGroomCompressor::groom<float>(float const*, size_t, int, bool, uint8_t*);
+template void BitGroomCompressor::groom<double>(double const*, size_t, int, bool, uint8_t*);
+/* -------------------------------------------------------------------------- */
@@ -30,42 +30,211 @@
  */
 #if ENABLE_BLOSC
 /* -------------------------------------------------------------------------- */
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include <omp.h>
 #include "compressors/kernels/blosc.hpp"
 #include "utils/timer.h"
+/* -------------------------------------------------------------------------- */
+namespace {
+
+  char const* shuffles[] = { "none", "byte", "bit" };
+
+  int toShuffle(std::string const& value) {
+    if (value == "none" or value == "0")
+      return BLOSC_NOSHUFFLE;
+    if (value == "bit" or value == "2")
+      return BLOSC_BITSHUFFLE;
+    return BLOSC_SHUFFLE;
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+BLOSCCompressor::BLOSCCompressor(std::string in_codec)
+  : codec(std::move(in_codec)) {
+  name = (codec == "blosclz") ? "blosc" : codec;
+}
+
+/* -------------------------------------------------------------------------- */
+BLOSCCompressor::Config BLOSCCompressor::getConfig() const {
+  Config config;
+  config.codec = parameters.count("codec") ? parameters.at("codec") : codec;
+  if (parameters.count("shuffle"))
+    config.shuffle = toShuffle(parameters.at("shuffle"));
+  if (parameters.count("clevel"))
+    config.clevel = std::min(9, std::max(0, std::stoi(parameters.at("clevel"))));
+  config.blocksize = getBlockSize();
+  return config;
+}
+
+/* -------------------------------------------------------------------------- */
+BLOSCCompressor::Config const& BLOSCCompressor::getTuned(Span input, size_t type_size) {
+
+  // sorted, so that the key does not depend on the insertion order
+  std::map<std::string, std::string> const sorted(parameters.begin(), parameters.end());
+  std::string key = std::to_string(type_size);
+  for (auto&& param : sorted)
+    key += "|" + param.first + "=" + param.second;
+
+  auto found = tuned.find(key);
+  if (found == tuned.end())
+    found = tuned.emplace(key, tune(input, type_size, getConfig())).first;
+  return found->second;
+}
+
+/* -------------------------------------------------------------------------- */
+void BLOSCCompressor::prepare
+  (Span input, gio::Type type, size_t type_size, size_t* n) {
+
+  if (parameters.count("tune"))
+    getTuned({input.data, type_size * getNumElements(n)}, type_size);
+}
+
+/* -------------------------------------------------------------------------- */
+size_t BLOSCCompressor::getBlockSize() const {
+  auto const found = parameters.find("blocksize");
+  return found != parameters.end() ? std::stoul(found->second) : 0;
+}
+
+/* -------------------------------------------------------------------------- */
+int BLOSCCompressor::getThreads() const {
+  auto const found = parameters.find("threads");
+  return found != parameters.end() ? std::max(1, std::stoi(found->second)) : omp_get_max_threads();
+}
+
+/* -------------------------------------------------------------------------- */
+BLOSCCompressor::Config BLOSCCompressor::tune(
+  Span input, size_t type_size, Config const& initial) {
+
+  // stratified sample: runs large enough to span several blosc blocks
+  double const fraction = parameters.count("sample") ? std::stod(parameters.at("sample")) : 0.01;
+  size_t const numel = input.size / type_size;
+  size_t const strata = 16;
+  size_t const length = std::max<size_t>(
+    std::ceil(numel * fraction / strata), (size_t(1) << 16) / type_size
+  );
+  size_t count = 0;
+  Span source = input;
+
+  if (numel > strata * length) {
+    count = strata * length;
+    auto* target = static_cast<char*>(sample.reserve(count * type_size).data);
+    auto const* data = static_cast<char const*>(input.data);
+    size_t const stride = numel / strata;
+
+    for (size_t s = 0; s < strata; ++s)
+      std::memcpy(target + s * length * type_size, data + s * stride * type_size, length * type_size);
+    source = { sample.data(), count * type_size };
+  }
+
+  struct Result { Config config; double ratio; double throughput; };
+  std::vector<Result> results;
+  Span const output = trial.reserve(source.size + BLOSC_MAX_OVERHEAD);
+  int const threads = getThreads();
+
+  // a given blocksize is kept, 0 lets blosc pick one from clevel and type size
+  std::vector<size_t> blocksizes = { 0, size_t(1) << 15, size_t(1) << 17, size_t(1) << 19 };
+  if (parameters.count("blocksize"))
+    blocksizes = { initial.blocksize };
+
+  for (auto&& candidate : { "blosclz", "lz4", "zlib", "zstd" }) {
+    for (int shuffle : { BLOSC_NOSHUFFLE, BLOSC_SHUFFLE, BLOSC_BITSHUFFLE }) {
+      // byte shuffling is a no-op on raw byte streams
+      if (shuffle == BLOSC_SHUFFLE and type_size == 1)
+        continue;
+
+      for (int clevel : { 1, 5, 9 }) {
+        for (size_t blocksize : blocksizes) {
+          Timer timer;
+          timer.start();
+          int const status = blosc_compress_ctx(
+            clevel, shuffle, type_size, source.size, source.data, output.data, output.size,
+            candidate, blocksize, threads
+          );
+          timer.stop();
+
+          // codecs missing from the blosc build fail here
+          if (status > 0) {
+            double const time = std::max(timer.getDuration(), std::numeric_limits<double>::epsilon());
+            results.push_back({
+              {candidate, shuffle, clevel, blocksize}, source.size / double(status), source.size / time
+            });
+          }
+        }
+      }
+    }
+  }
+
+  if (results.empty())
+    return initial;
+
+  auto best = std::max_element(results.begin(), results.end(), [](auto const& a, auto const& b) {
+    return a.ratio < b.ratio or (a.ratio == b.ratio and a.throughput < b.throughput);
+  });
+
+  if (parameters.at("tune") == "speed") {
+    double const floor = 0.95 * best->ratio;
+    for (auto it = results.begin(); it != results.end(); ++it) {
+      if (it->ratio >= floor and it->throughput > best->throughput)
+        best = it;
+    }
+  }
+
+  log << name << " ~ Tuned on " << source.size << " bytes over " << results.size();
+  log << " configurations, ratio: " << best->ratio << std::endl;
+  return best->config;
+}
+
+/* -------------------------------------------------------------------------- */
+size_t BLOSCCompressor::maxCompressedSize
+  (gio::Type type, size_t type_size, size_t* n) {
+  return type_size * getNumElements(n) + BLOSC_MAX_OVERHEAD;
+}
 
 /* -------------------------------------------------------------------------- */
 int BLOSCCompressor::compress
-  (void* input, void*& output, std::string type, size_t type_size, size_t* n) {
+  (Span input, Span output, gio::Type type, size_t type_size, size_t* n) {
 
-  size_t numel = n[0];
-  for (int i = 1; i < 5; i++)
-    if (n[i] != 0)
-      numel *= n[i];
+  size_t numel = getNumElements(n);
+  size_t isize = type_size * numel;
+
+  if (isize > size_t(std::numeric_limits<int>::max()) - BLOSC_MAX_OVERHEAD) {
+    std::cerr << "Compression failed: blosc is limited to 2 GB per call" << std::endl;
+    return EXIT_FAILURE;
+  }
 
   // compress
   Timer timer;
   timer.start();
 
-  size_t isize = type_size * numel;
-  size_t osize = isize + BLOSC_MAX_OVERHEAD;
+  // tuned once, in 'prepare' unless the caller skipped it
+  Config const config = parameters.count("tune") ? getTuned({input.data, isize}, type_size) : getConfig();
+  int const threads = getThreads();
 
-  output = std::malloc(isize); //byte array;
-  // default: {clevel=9, shuffle=1, sizeof(data), isize, input, output, osize)
-  osize = blosc_compress(9, 1, type_size, isize, input, output, osize);
+  int osize = blosc_compress_ctx(
+    config.clevel, config.shuffle, type_size, isize, input.data, output.data, output.size,
+    config.codec.c_str(), config.blocksize, threads
+  );
 
-  if (not osize) {
+  if (osize <= 0) {
     std::cerr << "Compression failed: " << osize << std::endl;
     return EXIT_FAILURE;
   }
 
   timer.stop();
-  bytes = osize;
+  bytes = static_cast<size_t>(osize);
 
   log << std::endl << name;
   log << " ~ InputBytes: " << isize;
   log << ", OutputBytes: " << osize;
   log << ", cRatio: " << isize / static_cast<float>(osize);
   log << ", #elements: " << numel << std::endl;
+  log << name << " ~ Codec: " << config.codec << ", Shuffle: " << shuffles[config.shuffle];
+  log << ", CLevel: " << config.clevel << ", BlockSize: " << config.blocksize;
+  log << ", Threads: " << threads << std::endl;
   log << name << " ~ CompressTime: " << timer.getDuration() << " s"<< std::endl;
 
   return EXIT_SUCCESS;
@@ -73,26 +242,17 @@ int BLOSCCompressor::compress
 
 /* -------------------------------------------------------------------------- */
 int BLOSCCompressor::decompress
-  (void*& input, void *&output, std::string type, size_t type_size, size_t *n) {
-
-  size_t numel = n[0];
-  for (int i = 1; i < 5; i++)
-    if (n[i] != 0)
-      numel *= n[i];
+  (Span input, Span output, gio::Type type, size_t type_size, size_t *n) {
 
   Timer timer;
   timer.start();
 
-  size_t osize = type_size * numel;
-  output = std::malloc(osize);
-  auto size = blosc_decompress(input, output, osize);
-  if (size < 0) {
+  auto size = blosc_decompress_ctx(input.data, output.data, output.size, getThreads());
+  if (size < 0 or static_cast<size_t>(size) != type_size * getNumElements(n)) {
     std::cerr << "Decompression failed: " << size << std::endl;
     return EXIT_FAILURE;
   }
 
-  std::free(input);
-  input = nullptr;
   timer.stop();
 
   log << name << " ~ DecompressTime: " << timer.getDuration() << " s" << std::endl;
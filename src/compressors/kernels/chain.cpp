@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "compressors/kernels/chain.hpp"
+#include "compressors/kernels/factory.h"
+#include "utils/tools.h"
+#include "utils/timer.h"
+/* -------------------------------------------------------------------------- */
+bool ChainCompressor::setup() {
+
+  auto const found = parameters.find("stages");
+  if (found == parameters.end() or found->second.empty()) {
+    std::cerr << "Chain failed: no stages given" << std::endl;
+    return false;
+  }
+
+  // (re)build the pipeline only when the stage list changes
+  if (found->second != current) {
+    close();
+    for (auto&& stage : tools::split(found->second, '+')) {
+      std::unique_ptr<CompressorInterface> kernel(CompressorFactory::create(stage));
+      if (kernel == nullptr) {
+        std::cerr << "Chain failed: unsupported stage " << stage << std::endl;
+        close();
+        return false;
+      }
+      if (not kernels.empty() and not kernel->handlesBytes()) {
+        std::cerr << "Chain failed: stage " << stage << " needs typed data";
+        std::cerr << ", it can only be the first one" << std::endl;
+        close();
+        return false;
+      }
+      kernel->init();
+      kernels.emplace_back(std::move(kernel));
+      stages.push_back({stage});
+    }
+    current = found->second;
+  }
+
+  // forward parameters: 'stage.key' to that stage only, others to all
+  for (size_t k = 0; k < kernels.size(); ++k) {
+    auto& kernel = kernels[k];
+    auto const prefix = stages[k].name + ".";
+    kernel->parameters.clear();
+
+    for (auto&& param : parameters) {
+      if (param.first == "stages" or param.first.find('.') != std::string::npos)
+        continue;
+      kernel->parameters[param.first] = param.second;
+    }
+
+    for (auto&& param : parameters) {
+      if (param.first.compare(0, prefix.size(), prefix) == 0)
+        kernel->parameters[param.first.substr(prefix.size())] = param.second;
+    }
+  }
+  return true;
+}
+
+/* -------------------------------------------------------------------------- */
+void ChainCompressor::close() {
+  for (auto&& kernel : kernels)
+    kernel->close();
+
+  kernels.clear();
+  stages.clear();
+  current.clear();
+}
+
+/* -------------------------------------------------------------------------- */
+int ChainCompressor::getThreads() const {
+  // stages run one after the other
+  int threads = 1;
+  for (auto&& kernel : kernels)
+    threads = std::max(threads, kernel->getThreads());
+  return threads;
+}
+
+/* -------------------------------------------------------------------------- */
+void ChainCompressor::prepare
+  (Span input, gio::Type type, size_t type_size, size_t* n) {
+
+  if (setup())
+    kernels[0]->prepare(input, type, type_size, n);
+}
+
+/* -------------------------------------------------------------------------- */
+size_t ChainCompressor::maxCompressedSize
+  (gio::Type type, size_t type_size, size_t* n) {
+
+  if (not setup())
+    return 0;
+
+  size_t bound = kernels[0]->maxCompressedSize(type, type_size, n);
+  for (size_t k = 1; k < kernels.size(); ++k) {
+    size_t dims[] = {bound, 0, 0, 0, 0};
+    bound = kernels[k]->maxCompressedSize(gio::Type::Uint8, 1, dims);
+  }
+  return getHeaderSize() + bound;
+}
+
+/* -------------------------------------------------------------------------- */
+int ChainCompressor::compress
+  (Span input, Span output, gio::Type type, size_t type_size, size_t* n) {
+
+  if (not setup())
+    return EXIT_FAILURE;
+
+  size_t const nb_stages = kernels.size();
+  size_t const header_size = getHeaderSize();
+  std::vector<uint64_t> header(nb_stages + 1);
+  header[0] = nb_stages;
+
+  if (output.size < header_size) {
+    std::cerr << "Compression failed: output buffer too small" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  Span current_input = input;
+  size_t dims[] = {n[0], n[1], n[2], n[3], n[4]};
+
+  for (size_t k = 0; k < nb_stages; ++k) {
+    auto& kernel = kernels[k];
+    bool const last = (k == nb_stages - 1);
+
+    // last stage writes straight after the header, others in a pooled buffer
+    Span current_output = last
+      ? Span { static_cast<char*>(output.data) + header_size, output.size - header_size }
+      : pool[k % 2].reserve(kernel->maxCompressedSize(type, type_size, dims));
+
+    Timer timer;
+    timer.start();
+    if (kernel->compress(current_input, current_output, type, type_size, dims) != EXIT_SUCCESS)
+      return EXIT_FAILURE;
+    timer.stop();
+
+    stages[k].bytes = kernel->getBytes();
+    stages[k].zip_time = timer.getDuration();
+    header[k + 1] = stages[k].bytes;
+    log << kernel->getLog();
+    kernel->clearLog();
+
+    // next stages see a raw byte stream
+    current_input = { current_output.data, stages[k].bytes };
+    type = gio::Type::Uint8;
+    type_size = 1;
+    dims[0] = stages[k].bytes;
+    dims[1] = dims[2] = dims[3] = dims[4] = 0;
+  }
+
+  std::memcpy(output.data, header.data(), header_size);
+  bytes = header_size + header.back();
+
+  log << name << " ~ Stages: " << current << ", OutputBytes: " << bytes << std::endl;
+  return EXIT_SUCCESS;
+}
+
+/* -------------------------------------------------------------------------- */
+int ChainCompressor::decompress
+  (Span input, Span output, gio::Type type, size_t type_size, size_t* n) {
+
+  if (not setup())
+    return EXIT_FAILURE;
+
+  size_t const nb_stages = kernels.size();
+  size_t const header_size = getHeaderSize();
+  std::vector<uint64_t> header(nb_stages + 1);
+
+  if (input.size < header_size) {
+    std::cerr << "Decompression failed: truncated input" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::memcpy(header.data(), input.data, header_size);
+  if (header[0] != nb_stages) {
+    std::cerr << "Decompression failed: expected " << nb_stages << " stages";
+    std::cerr << ", got " << header[0] << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  Span current_input = { static_cast<char*>(input.data) + header_size, header.back() };
+
+  // undo stages in reverse order, the first one writes in the caller buffer
+  for (size_t k = nb_stages; k-- > 0;) {
+    auto& kernel = kernels[k];
+    bool const first = (k == 0);
+    size_t dims[] = {header[k], 0, 0, 0, 0};
+
+    Span current_output = first ? output : pool[k % 2].reserve(header[k]);
+
+    Timer timer;
+    timer.start();
+    int status = first
+      ? kernel->decompress(current_input, current_output, type, type_size, n)
+      : kernel->decompress(current_input, current_output, gio::Type::Uint8, 1, dims);
+    timer.stop();
+
+    if (status != EXIT_SUCCESS)
+      return EXIT_FAILURE;
+
+    stages[k].unzip_time = timer.getDuration();
+    log << kernel->getLog();
+    kernel->clearLog();
+
+    if (not first)
+      current_input = { current_output.data, header[k] };
+  }
+
+  return EXIT_SUCCESS;
+}
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,315 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "compressors/kernels/chunked.hpp"
+#include "compressors/kernels/factory.h"
+#include "io/CRC64.h"
+#include "utils/timer.h"
+/* -------------------------------------------------------------------------- */
+bool ChunkedCompressor::setup() {
+
+  auto const found = parameters.find("kernel");
+  if (found == parameters.end() or found->second.empty()) {
+    std::cerr << "Chunked failed: no kernel given" << std::endl;
+    return false;
+  }
+
+  // (re)create the inner kernel only when it changes
+  if (found->second != current) {
+    close();
+    kernel.reset(CompressorFactory::create(found->second));
+    if (kernel == nullptr) {
+      std::cerr << "Chunked failed: unsupported kernel " << found->second << std::endl;
+      return false;
+    }
+    kernel->init();
+    current = found->second;
+  }
+
+  kernel->parameters.clear();
+  for (auto&& param : parameters) {
+    if (param.first != "kernel" and param.first != "chunk")
+      kernel->parameters[param.first] = param.second;
+  }
+  return true;
+}
+
+/* -------------------------------------------------------------------------- */
+void ChunkedCompressor::close() {
+  if (kernel != nullptr)
+    kernel->close();
+
+  kernel.reset();
+  current.clear();
+}
+
+/* -------------------------------------------------------------------------- */
+size_t ChunkedCompressor::getChunkSize() const {
+  auto const found = parameters.find("chunk");
+  size_t const chunk = found != parameters.end() ? std::stoul(found->second) : 65536;
+  return std::max<size_t>(64, chunk);
+}
+
+/* -------------------------------------------------------------------------- */
+size_t ChunkedCompressor::getHeadSize(Span head) {
+  if (head.size < preamble)
+    return 0;
+
+  uint64_t nb_chunks = 0;
+  std::memcpy(&nb_chunks, static_cast<uint8_t const*>(head.data) + 2 * sizeof(uint64_t), sizeof(uint64_t));
+  return preamble + (2 * nb_chunks + 1) * sizeof(uint64_t);
+}
+
+/* -------------------------------------------------------------------------- */
+bool ChunkedCompressor::slice(Span head, size_t first, size_t count, Slice& out) {
+
+  size_t const head_size = getHeadSize(head);
+  if (head_size == 0 or head.size < head_size)
+    return false;
+
+  auto const* index = static_cast<uint64_t const*>(head.data);
+  size_t const numel = index[0];
+  size_t const chunk = index[1];
+  size_t const nb_chunks = index[2];
+  uint64_t const* offsets = index + 3;
+  uint64_t const* checksums = offsets + nb_chunks + 1;
+
+  if (chunk == 0 or nb_chunks != (numel + chunk - 1) / chunk
+      or count == 0 or first + count > numel)
+    return false;
+
+  size_t const first_chunk = first / chunk;
+  size_t const last_chunk = (first + count - 1) / chunk + 1;
+  size_t const nb_sliced = last_chunk - first_chunk;
+
+  out.begin = head_size + offsets[first_chunk];
+  out.end = head_size + offsets[last_chunk];
+  out.numel = std::min(numel, last_chunk * chunk) - first_chunk * chunk;
+  out.first = first - first_chunk * chunk;
+
+  // same layout, restricted to the covering chunks
+  std::vector<uint64_t> sliced { out.numel, chunk, nb_sliced };
+  for (size_t c = first_chunk; c <= last_chunk; ++c)
+    sliced.push_back(offsets[c] - offsets[first_chunk]);
+  sliced.insert(sliced.end(), checksums + first_chunk, checksums + last_chunk);
+
+  auto const* raw = reinterpret_cast<uint8_t const*>(sliced.data());
+  out.head.assign(raw, raw + sliced.size() * sizeof(uint64_t));
+  return out.begin <= out.end;
+}
+
+/* -------------------------------------------------------------------------- */
+void ChunkedCompressor::prepare
+  (Span input, gio::Type type, size_t type_size, size_t* n) {
+
+  // the inner kernel is prepared on the whole data rather than per chunk
+  if (setup())
+    kernel->prepare(input, type, type_size, n);
+}
+
+/* -------------------------------------------------------------------------- */
+size_t ChunkedCompressor::maxCompressedSize
+  (gio::Type type, size_t type_size, size_t* n) {
+
+  if (not setup())
+    return 0;
+
+  size_t const numel = getNumElements(n);
+  size_t const chunk = getChunkSize();
+  size_t const nb_chunks = (numel + chunk - 1) / chunk;
+  size_t bound = preamble + (2 * nb_chunks + 1) * sizeof(uint64_t);
+
+  if (nb_chunks > 0) {
+    size_t full[] = {chunk, 0, 0, 0, 0};
+    size_t last[] = {numel - (nb_chunks - 1) * chunk, 0, 0, 0, 0};
+    bound += (nb_chunks - 1) * kernel->maxCompressedSize(type, type_size, full);
+    bound += kernel->maxCompressedSize(type, type_size, last);
+  }
+  return bound;
+}
+
+/* -------------------------------------------------------------------------- */
+int ChunkedCompressor::compress
+  (Span input, Span output, gio::Type type, size_t type_size, size_t* n) {
+
+  if (not setup())
+    return EXIT_FAILURE;
+
+  Timer timer;
+  timer.start();
+
+  size_t const numel = getNumElements(n);
+  size_t const chunk = getChunkSize();
+  size_t const nb_chunks = (numel + chunk - 1) / chunk;
+  size_t const head_size = preamble + (2 * nb_chunks + 1) * sizeof(uint64_t);
+
+  if (output.size < head_size) {
+    std::cerr << "Compression failed: output buffer too small" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  auto* raw = static_cast<uint8_t*>(output.data);
+  auto const* data = static_cast<uint8_t const*>(input.data);
+  uint8_t* base = raw + head_size;
+  offsets.assign(nb_chunks + 1, 0);
+  checksums.assign(nb_chunks, 0);
+
+  // chunks are compressed one after the other, inner kernels being threaded
+  for (size_t c = 0; c < nb_chunks; ++c) {
+    size_t const start = c * chunk;
+    size_t const length = std::min(chunk, numel - start);
+    size_t dims[] = {length, 0, 0, 0, 0};
+    Span const source { const_cast<uint8_t*>(data) + start * type_size, length * type_size };
+    Span const target { base + offsets[c], output.size - head_size - offsets[c] };
+
+    if (kernel->compress(source, target, type, type_size, dims) != EXIT_SUCCESS)
+      return EXIT_FAILURE;
+
+    kernel->clearLog();
+    offsets[c + 1] = offsets[c] + kernel->getBytes();
+    checksums[c] = crc64(target.data, kernel->getBytes());
+  }
+
+  uint64_t const header[] = {numel, chunk, nb_chunks};
+  std::memcpy(raw, header, preamble);
+  std::memcpy(raw + preamble, offsets.data(), (nb_chunks + 1) * sizeof(uint64_t));
+  std::memcpy(raw + preamble + (nb_chunks + 1) * sizeof(uint64_t), checksums.data(),
+              nb_chunks * sizeof(uint64_t));
+
+  bytes = head_size + offsets[nb_chunks];
+  timer.stop();
+
+  log << std::endl << name;
+  log << " ~ InputBytes: " << type_size * numel;
+  log << ", OutputBytes: " << bytes;
+  log << ", cRatio: " << (type_size * numel / static_cast<float>(bytes));
+  log << ", #elements: " << numel << std::endl;
+  log << name << " ~ Kernel: " << current << ", #chunks: " << nb_chunks << std::endl;
+  log << name << " ~ CompressTime: " << timer.getDuration() << " s" << std::endl;
+  return EXIT_SUCCESS;
+}
+
+/* -------------------------------------------------------------------------- */
+int ChunkedCompressor::decompress
+  (Span input, Span output, gio::Type type, size_t type_size, size_t* n) {
+
+  return decompressRange(input, output, type, type_size, n, 0, getNumElements(n));
+}
+
+/* -------------------------------------------------------------------------- */
+int ChunkedCompressor::decompressRange(Span input, Span output, gio::Type type,
+                                       size_t type_size, size_t* n, size_t first, size_t count) {
+  if (not setup())
+    return EXIT_FAILURE;
+
+  Timer timer;
+  timer.start();
+
+  size_t const head_size = getHeadSize(input);
+  if (head_size == 0 or input.size < head_size) {
+    std::cerr << "Decompression failed: truncated input" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  uint64_t header[3];
+  auto const* raw = static_cast<uint8_t const*>(input.data);
+  std::memcpy(header, raw, preamble);
+  size_t const numel = header[0];
+  size_t const chunk = header[1];
+  size_t const nb_chunks = header[2];
+
+  if (chunk == 0 or nb_chunks != (numel + chunk - 1) / chunk or numel != getNumElements(n)
+      or first + count > numel or output.size < count * type_size) {
+    std::cerr << "Decompression failed: inconsistent header" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // only chunks covering the requested range are read and decoded
+  size_t const first_chunk = count > 0 ? first / chunk : 0;
+  size_t const last_chunk = count > 0 ? (first + count - 1) / chunk + 1 : 0;
+  uint64_t total = 0;
+
+  offsets.resize(last_chunk - first_chunk + 1);
+  checksums.resize(last_chunk - first_chunk);
+  std::memcpy(offsets.data(), raw + preamble + first_chunk * sizeof(uint64_t),
+              offsets.size() * sizeof(uint64_t));
+  std::memcpy(checksums.data(), raw + preamble + (nb_chunks + 1 + first_chunk) * sizeof(uint64_t),
+              checksums.size() * sizeof(uint64_t));
+  std::memcpy(&total, raw + preamble + nb_chunks * sizeof(uint64_t), sizeof(uint64_t));
+
+  if (not std::is_sorted(offsets.begin(), offsets.end())
+      or offsets.back() > total or head_size + total > input.size) {
+    std::cerr << "Decompression failed: truncated input" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  uint8_t const* base = raw + head_size;
+  auto* data = static_cast<uint8_t*>(output.data);
+
+  for (size_t c = first_chunk; c < last_chunk; ++c) {
+    size_t const start = c * chunk;
+    size_t const length = std::min(chunk, numel - start);
+    size_t const lower = std::max(start, first);
+    size_t const upper = std::min(start + length, first + count);
+    bool const whole = (lower == start and upper == start + length);
+    size_t dims[] = {length, 0, 0, 0, 0};
+    size_t const k = c - first_chunk;
+    Span const stream { const_cast<uint8_t*>(base) + offsets[k], offsets[k + 1] - offsets[k] };
+
+    if (crc64(stream.data, stream.size) != checksums[k]) {
+      std::cerr << "Decompression failed: checksum mismatch on chunk " << c << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    // chunks partially covered are rebuilt aside then trimmed
+    Span const target = whole
+      ? Span { data + (start - first) * type_size, length * type_size }
+      : staging.reserve(length * type_size);
+
+    if (kernel->decompress(stream, target, type, type_size, dims) != EXIT_SUCCESS)
+      return EXIT_FAILURE;
+
+    kernel->clearLog();
+    if (not whole) {
+      auto const* decoded = static_cast<uint8_t const*>(target.data);
+      std::memcpy(data + (lower - first) * type_size, decoded + (lower - start) * type_size,
+                  (upper - lower) * type_size);
+    }
+  }
+
+  timer.stop();
+  log << name << " ~ Chunks: " << last_chunk - first_chunk << "/" << nb_chunks;
+  log << ", DecompressTime: " << timer.getDuration() << " s" << std::endl;
+  return EXIT_SUCCESS;
+}
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,425 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include "compressors/kernels/fpc.hpp"
+#include "utils/timer.h"
+/* -------------------------------------------------------------------------- */
+namespace {
+
+  struct Header {
+    uint64_t numel;
+    uint32_t block;
+    uint8_t type_size;
+    uint8_t predictor;
+    uint8_t table;
+    uint8_t padding;
+  };
+
+  template <typename T>
+  using Bits = std::conditional_t<sizeof(T) == 8, uint64_t, uint32_t>;
+
+  template <typename U>
+  inline int leadingZeroBytes(U residual) {
+    if (residual == 0)
+      return sizeof(U);
+    if constexpr (sizeof(U) == 8)
+      return __builtin_clzll(residual) / 8;
+    else
+      return __builtin_clz(residual) / 8;
+  }
+
+  // zero byte counts are coded on 3 bits: for 8-byte values,
+  // a count of 4 is rounded down to 3 as FPC does.
+  template <typename U>
+  inline uint8_t toCode(int zeros) {
+    if constexpr (sizeof(U) == 8)
+      return static_cast<uint8_t>(zeros < 4 ? zeros : (zeros == 4 ? 3 : zeros - 1));
+    else
+      return static_cast<uint8_t>(zeros);
+  }
+
+  template <typename U>
+  inline size_t storedBytes(uint8_t code) {
+    int const zeros = code & 7;
+    if constexpr (sizeof(U) == 8)
+      return sizeof(U) - (zeros < 4 ? zeros : zeros + 1);
+    else
+      return sizeof(U) - zeros;
+  }
+
+  // finite context and differential finite context predictors
+  template <typename U>
+  struct Context {
+    static constexpr int width = 8 * sizeof(U);
+
+    explicit Context(int bits)
+      : fcm(size_t(1) << bits), dfcm(size_t(1) << bits), mask((size_t(1) << bits) - 1) {}
+
+    void reset() {
+      std::fill(fcm.begin(), fcm.end(), 0);
+      std::fill(dfcm.begin(), dfcm.end(), 0);
+      h1 = h2 = 0;
+      last = 0;
+    }
+
+    U prediction(bool differential) const {
+      return differential ? U(dfcm[h2] + last) : fcm[h1];
+    }
+
+    void update(U value) {
+      U const delta = value - last;
+      fcm[h1] = value;
+      h1 = ((h1 << 6) ^ static_cast<size_t>(value >> (width - 16))) & mask;
+      dfcm[h2] = delta;
+      h2 = ((h2 << 2) ^ static_cast<size_t>(delta >> (width - 24))) & mask;
+      last = value;
+    }
+
+    std::vector<U> fcm;
+    std::vector<U> dfcm;
+    size_t const mask;
+    size_t h1 = 0;
+    size_t h2 = 0;
+    U last = 0;
+  };
+}
+
+/* -------------------------------------------------------------------------- */
+size_t FPCCompressor::getBlockSize() const {
+  auto const found = parameters.find("block");
+  size_t const block = found != parameters.end() ? std::stoul(found->second) : 65536;
+  return std::max<size_t>(64, block);
+}
+
+/* -------------------------------------------------------------------------- */
+FPCCompressor::Predictor FPCCompressor::getPredictor() const {
+  auto const found = parameters.find("predictor");
+  return (found != parameters.end() and found->second == "xor") ? XOR : FCM;
+}
+
+/* -------------------------------------------------------------------------- */
+int FPCCompressor::getTableBits() const {
+  auto const found = parameters.find("table");
+  int const bits = found != parameters.end() ? std::stoi(found->second) : 12;
+  return std::max(4, std::min(bits, 24));
+}
+
+/* -------------------------------------------------------------------------- */
+size_t FPCCompressor::maxCompressedSize
+  (gio::Type type, size_t type_size, size_t* n) {
+
+  size_t const numel = getNumElements(n);
+  size_t const block = getBlockSize();
+  size_t const nb_blocks = (numel + block - 1) / block;
+
+  // worst case: no leading zero byte at all
+  return sizeof(Header) + (nb_blocks + 1) * sizeof(uint64_t)
+       + nb_blocks + numel / 2 + numel * type_size;
+}
+
+/* -------------------------------------------------------------------------- */
+int FPCCompressor::compress
+  (Span input, Span output, gio::Type type, size_t type_size, size_t* n) {
+
+  return dispatch(type, [&](auto* tag) {
+    return encode<std::remove_pointer_t<decltype(tag)>>(input, output, n);
+  });
+}
+
+/* -------------------------------------------------------------------------- */
+int FPCCompressor::decompress
+  (Span input, Span output, gio::Type type, size_t type_size, size_t* n) {
+
+  return dispatch(type, [&](auto* tag) {
+    return decode<std::remove_pointer_t<decltype(tag)>>(input, output, n, 0, getNumElements(n));
+  });
+}
+
+/* -------------------------------------------------------------------------- */
+int FPCCompressor::decompressRange(Span input, Span output, gio::Type type,
+                                   size_t type_size, size_t* n, size_t first, size_t count) {
+
+  return dispatch(type, [&](auto* tag) {
+    return decode<std::remove_pointer_t<decltype(tag)>>(input, output, n, first, count);
+  });
+}
+
+/* -------------------------------------------------------------------------- */
+template <typename T>
+int FPCCompressor::encode(Span input, Span output, size_t* n) {
+
+  using U = Bits<T>;
+
+  Timer timer;
+  timer.start();
+
+  size_t const numel = getNumElements(n);
+  size_t const block = getBlockSize();
+  long const nb_blocks = (numel + block - 1) / block;
+  size_t const header_size = sizeof(Header) + (nb_blocks + 1) * sizeof(uint64_t);
+  Predictor const predictor = getPredictor();
+  int const table = getTableBits();
+
+  if (output.size < header_size) {
+    std::cerr << "Compression failed: output buffer too small" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  auto const* data = static_cast<T const*>(input.data);
+
+  residuals.resize(numel);
+  codes.resize(numel);
+  offsets.assign(nb_blocks + 1, 0);
+
+  // pass 1: predict and compute the exact size of each block
+  #pragma omp parallel
+  {
+    std::unique_ptr<Context<U>> context;
+    if (predictor == FCM)
+      context = std::make_unique<Context<U>>(table);
+
+    #pragma omp for schedule(static)
+    for (long b = 0; b < nb_blocks; ++b) {
+      size_t const first = b * block;
+      size_t const count = std::min(block, numel - first);
+      T const* x = data + first;
+      uint64_t* r = residuals.data() + first;
+      uint8_t* c = codes.data() + first;
+      size_t bytes = (count + 1) / 2;
+
+      if (predictor == XOR) {
+        #pragma omp simd reduction(+:bytes)
+        for (size_t i = 0; i < count; ++i) {
+          U value, previous = 0;
+          std::memcpy(&value, x + i, sizeof(U));
+          if (i > 0)
+            std::memcpy(&previous, x + i - 1, sizeof(U));
+          U const residual = value ^ previous;
+          c[i] = toCode<U>(leadingZeroBytes(residual));
+          r[i] = residual;
+          bytes += storedBytes<U>(c[i]);
+        }
+      } else {
+        context->reset();
+        for (size_t i = 0; i < count; ++i) {
+          U value;
+          std::memcpy(&value, x + i, sizeof(U));
+          U const r1 = value ^ context->prediction(false);
+          U const r2 = value ^ context->prediction(true);
+          int const z1 = leadingZeroBytes(r1);
+          int const z2 = leadingZeroBytes(r2);
+          bool const differential = z2 > z1;
+          c[i] = static_cast<uint8_t>((differential << 3) | toCode<U>(differential ? z2 : z1));
+          r[i] = differential ? r2 : r1;
+          bytes += storedBytes<U>(c[i]);
+          context->update(value);
+        }
+      }
+      offsets[b + 1] = bytes;
+    }
+  }
+
+  for (long b = 0; b < nb_blocks; ++b)
+    offsets[b + 1] += offsets[b];
+
+  if (header_size + offsets[nb_blocks] > output.size) {
+    std::cerr << "Compression failed: output buffer too small" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  auto* raw = static_cast<uint8_t*>(output.data);
+  Header const header {
+    numel, static_cast<uint32_t>(block), sizeof(T),
+    predictor, static_cast<uint8_t>(table), 0
+  };
+  std::memcpy(raw, &header, sizeof(Header));
+  std::memcpy(raw + sizeof(Header), offsets.data(), (nb_blocks + 1) * sizeof(uint64_t));
+
+  // pass 2: write each block at its final location
+  uint8_t* base = raw + header_size;
+
+  #pragma omp parallel for schedule(static)
+  for (long b = 0; b < nb_blocks; ++b) {
+    size_t const first = b * block;
+    size_t const count = std::min(block, numel - first);
+    uint64_t const* r = residuals.data() + first;
+    uint8_t const* c = codes.data() + first;
+    uint8_t* ptr = base + offsets[b];
+
+    #pragma omp simd
+    for (size_t k = 0; k < count / 2; ++k)
+      ptr[k] = static_cast<uint8_t>(c[2 * k] | (c[2 * k + 1] << 4));
+    if (count % 2)
+      ptr[count / 2] = c[count - 1];
+    ptr += (count + 1) / 2;
+
+    for (size_t i = 0; i < count; ++i) {
+      auto const residual = static_cast<U>(r[i]);
+      size_t const length = storedBytes<U>(c[i]);
+      std::memcpy(ptr, &residual, length);
+      ptr += length;
+    }
+  }
+
+  bytes = header_size + offsets[nb_blocks];
+  timer.stop();
+
+  log << std::endl << name;
+  log << " ~ InputBytes: " << sizeof(T) * numel;
+  log << ", OutputBytes: " << bytes;
+  log << ", cRatio: " << (sizeof(T) * numel / static_cast<float>(bytes));
+  log << ", #elements: " << numel << std::endl;
+  log << name << " ~ CompressTime: " << timer.getDuration() << " s" << std::endl;
+  return EXIT_SUCCESS;
+}
+
+/* -------------------------------------------------------------------------- */
+template <typename T>
+int FPCCompressor::decode(Span input, Span output, size_t* n,
+                          size_t first, size_t count) {
+
+  using U = Bits<T>;
+
+  Timer timer;
+  timer.start();
+
+  Header header {};
+  if (input.size < sizeof(Header)) {
+    std::cerr << "Decompression failed: truncated input" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::memcpy(&header, input.data, sizeof(Header));
+  size_t const numel = header.numel;
+  size_t const block = header.block;
+  long const nb_blocks = block > 0 ? (numel + block - 1) / block : 0;
+  size_t const header_size = sizeof(Header) + (nb_blocks + 1) * sizeof(uint64_t);
+
+  if (header.type_size != sizeof(T) or block == 0 or numel != getNumElements(n)
+      or header.table < 4 or header.table > 24 or first + count > numel
+      or output.size < count * sizeof(T) or input.size < header_size) {
+    std::cerr << "Decompression failed: inconsistent header" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // only blocks covering the requested range are decoded,
+  // so that decoding a stream piece by piece stays linear
+  long const first_block = count > 0 ? first / block : 0;
+  long const last_block = count > 0 ? (first + count - 1) / block + 1 : 0;
+  auto const* raw = static_cast<uint8_t const*>(input.data);
+  uint64_t total = 0;
+
+  offsets.resize(last_block - first_block + 1);
+  std::memcpy(offsets.data(), raw + sizeof(Header) + first_block * sizeof(uint64_t),
+              offsets.size() * sizeof(uint64_t));
+  std::memcpy(&total, raw + sizeof(Header) + nb_blocks * sizeof(uint64_t), sizeof(uint64_t));
+
+  if (header_size + total > input.size) {
+    std::cerr << "Decompression failed: truncated input" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  uint8_t const* base = raw + header_size;
+  auto* data = static_cast<T*>(output.data);
+  bool const differential_enabled = (header.predictor == FCM);
+
+  #pragma omp parallel
+  {
+    std::unique_ptr<Context<U>> context;
+    if (differential_enabled)
+      context = std::make_unique<Context<U>>(header.table);
+    std::vector<T> partial;
+
+    #pragma omp for schedule(static)
+    for (long b = first_block; b < last_block; ++b) {
+      size_t const start = b * block;
+      size_t const length = std::min(block, numel - start);
+      size_t const lower = std::max(start, first);
+      size_t const upper = std::min(start + length, first + count);
+      bool const whole = (lower == start and upper == start + length);
+      uint8_t const* c = base + offsets[b - first_block];
+      uint8_t const* ptr = c + (length + 1) / 2;
+
+      // blocks partially covered are rebuilt aside then trimmed
+      if (not whole)
+        partial.resize(block);
+      T* y = whole ? data + (start - first) : partial.data();
+
+      auto code = [c](size_t i) -> uint8_t { return (c[i / 2] >> (4 * (i % 2))) & 0xF; };
+
+      if (differential_enabled) {
+        context->reset();
+        for (size_t i = 0; i < length; ++i) {
+          uint8_t const current = code(i);
+          size_t const size = storedBytes<U>(current);
+          U residual = 0;
+          std::memcpy(&residual, ptr, size);
+          ptr += size;
+          U const value = residual ^ context->prediction(current >> 3);
+          context->update(value);
+          std::memcpy(y + i, &value, sizeof(U));
+        }
+      } else {
+        U value = 0;
+        for (size_t i = 0; i < length; ++i) {
+          size_t const size = storedBytes<U>(code(i));
+          U residual = 0;
+          std::memcpy(&residual, ptr, size);
+          ptr += size;
+          value ^= residual;
+          std::memcpy(y + i, &value, sizeof(U));
+        }
+      }
+
+      if (not whole)
+        std::memcpy(data + (lower - first), y + (lower - start), (upper - lower) * sizeof(T));
+    }
+  }
+
+  timer.stop();
+  log << name << " ~ DecompressTime: " << timer.getDuration() << " s" << std::endl;
+  return EXIT_SUCCESS;
+}
+
+/* -------------------------------------------------------------------------- */
+template int FPCCompressor::encode<float>(Span, Span, size_t*);
+template int FPCCompressor::encode<double>(Span, Span, size_t*);
+template int FPCCompressor::encode<int32_t>(Span, Span, size_t*);
+template int FPCCompressor::encode<int64_t>(Span, Span, size_t*);
+template int FPCCompressor::decode<float>(Span, Span, size_t*, size_t, size_t);
+template int FPCCompressor::decode<double>(Span, Span, size_t*, size_t, size_t);
+template int FPCCompressor::decode<int32_t>(Span, Span, size_t*, size_t, size_t);
+template int FPCCompressor::decode<int64_t>(Span, Span, size_t*, size_t, size_t);
+/* -------------------------------------------------------------------------- */
@@ -38,110 +38,132 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
+#include <type_traits>
 #include "compressors/kernels/fpzip.hpp"
 #include "utils/timer.h"
 /* -------------------------------------------------------------------------- */
-int FPZIPCompressor::compress
-  (void *input, void *&output, std::string type, size_t type_size, size_t *n) {
-
-  size_t numel = n[0];
-  for (int i = 1; i < 5; i++)
-    if (n[i] != 0)
-      numel *= n[i];
-
-  Timer timer;
-  timer.start();
-
-  output = malloc(1024 + type_size * numel);
-
-  FPZ *fpz = fpzip_write_to_buffer(output, 1024 + type_size * numel);
+size_t FPZIPCompressor::maxCompressedSize
+  (gio::Type type, size_t type_size, size_t* n) {
+  return 1024 + type_size * getNumElements(n);
+}
 
-  if (type == "float")
-    fpz->type = FPZIP_TYPE_FLOAT;
-  else
-    fpz->type = FPZIP_TYPE_DOUBLE;
+/* -------------------------------------------------------------------------- */
+int FPZIPCompressor::compress
+  (Span input, Span output, gio::Type type, size_t type_size, size_t *n) {
 
-  fpz->prec = 27; // Number of bits of precision (input param) (of 32 for float)
+  return dispatch(type, [&](auto* tag) {
+    return encode<std::remove_pointer_t<decltype(tag)>>(input, output, n);
+  });
+}
 
-  if (parameters.count("bits")) {
-    std::string value = parameters["bits"];
-    if (not value.empty())
-      fpz->prec = std::stoi(value);
-  }
+/* -------------------------------------------------------------------------- */
+int FPZIPCompressor::decompress
+  (Span input, Span output, gio::Type type, size_t type_size, size_t *n) {
 
-  fpz->nx = n[0];
-  fpz->ny = (n[1] != 0 ? n[1] : 1);
-  fpz->nz = (n[2] != 0 ? n[2] : 1);
-  fpz->nf = (n[3] != 0 ? n[3] : 1);
+  return dispatch(type, [&](auto* tag) {
+    return decode<std::remove_pointer_t<decltype(tag)>>(input, output, n);
+  });
+}
 
+/* -------------------------------------------------------------------------- */
+template <typename T>
+int FPZIPCompressor::encode(Span input, Span output, size_t *n) {
 
-  // perform actual compression
-  bytes = fpzip_write(fpz, input);
-  if (not bytes) {
-    std::cerr << "Compression failed: "<<  fpzip_errstr[fpzip_errno] << std::endl;
+  if constexpr (not std::is_floating_point<T>::value) {
+    std::cerr << "Compression failed: fpzip only supports float and double" << std::endl;
     return EXIT_FAILURE;
+  } else {
+    size_t numel = getNumElements(n);
+
+    Timer timer;
+    timer.start();
+
+    FPZ *fpz = fpzip_write_to_buffer(output.data, output.size);
+    fpz->type = std::is_same<T, float>::value ? FPZIP_TYPE_FLOAT : FPZIP_TYPE_DOUBLE;
+    fpz->prec = 27; // Number of bits of precision (input param) (of 32 for float)
+
+    if (parameters.count("bits")) {
+      std::string value = parameters["bits"];
+      if (not value.empty())
+        fpz->prec = std::stoi(value);
+    }
+
+    fpz->nx = n[0];
+    fpz->ny = (n[1] != 0 ? n[1] : 1);
+    fpz->nz = (n[2] != 0 ? n[2] : 1);
+    fpz->nf = (n[3] != 0 ? n[3] : 1);
+
+    // perform actual compression
+    bytes = fpzip_write(fpz, input.data);
+    if (not bytes) {
+      std::cerr << "Compression failed: "<<  fpzip_errstr[fpzip_errno] << std::endl;
+      fpzip_write_close(fpz);
+      return EXIT_FAILURE;
+    }
+
+    fpzip_write_close(fpz);
+    timer.stop();
+
+    log << std::endl << name;
+    log << " ~ InputBytes: " << sizeof(T) * numel;
+    log << ", OutputBytes: " << bytes;
+    log << ", cRatio: " << (sizeof(T) * numel / (float) bytes);
+    log << ", #elements: " << numel << std::endl;
+    log << name << " ~ CompressTime: " << timer.getDuration() << " s" << std::endl;
+
+    return EXIT_SUCCESS;
   }
-
-  fpzip_write_close(fpz);
-  timer.stop();
-
-  log << std::endl << name;
-  log << " ~ InputBytes: " << type_size * numel;
-  log << ", OutputBytes: " << bytes;
-  log << ", cRatio: " << (type_size * numel / (float) bytes);
-  log << ", #elements: " << numel << std::endl;
-  log << name << " ~ CompressTime: " << timer.getDuration() << " s" << std::endl;
-
-  return EXIT_SUCCESS;
 }
 
 /* -------------------------------------------------------------------------- */
-int FPZIPCompressor::decompress
-  (void*& input, void*& output, std::string type, size_t type_size, size_t *n) {
+template <typename T>
+int FPZIPCompressor::decode(Span input, Span output, size_t *n) {
 
-  size_t numel = n[0];
-  for (int i = 1; i < 5; i++)
-    if (n[i] != 0)
-      numel *= n[i];
+  if constexpr (not std::is_floating_point<T>::value) {
+    std::cerr << "Decompression failed: fpzip only supports float and double" << std::endl;
+    return EXIT_FAILURE;
+  } else {
+    Timer timer;
+    timer.start();
 
-  Timer timer;
-  timer.start();
+    FPZ *fpz = fpzip_read_from_buffer(input.data);
+    fpz->type = std::is_same<T, float>::value ? FPZIP_TYPE_FLOAT : FPZIP_TYPE_DOUBLE;
+    fpz->prec = 27;
 
-  output = malloc(type_size * numel);
+    if (parameters.count("bits")) {
+      std::string value = parameters["bits"];
+      if (not value.empty())
+        fpz->prec = std::stoi(value);
+    }
 
-  FPZ *fpz = fpzip_read_from_buffer(input);
-  if (type == "float")
-    fpz->type = FPZIP_TYPE_FLOAT;
-  else
-    fpz->type = FPZIP_TYPE_DOUBLE;
+    fpz->nx = static_cast<int>(n[0]);
+    fpz->ny = static_cast<int>(n[1] != 0 ? n[1] : 1);
+    fpz->nz = static_cast<int>(n[2] != 0 ? n[2] : 1);
+    fpz->nf = static_cast<int>(n[3] != 0 ? n[3] : 1);
 
-  fpz->prec = 27;
+    if (not fpzip_read(fpz, output.data)) {
+      std::cerr << "Decompression failed: "<< fpzip_errstr[fpzip_errno] << std::endl;
+      fpzip_read_close(fpz);
+      return EXIT_FAILURE;
+    }
 
-  if (parameters.count("bits")) {
-    std::string value = parameters["bits"];
-    if (not value.empty())
-      fpz->prec = std::stoi(value);
-  }
+    fpzip_read_close(fpz);
+    timer.stop();
 
-  fpz->nx = static_cast<int>(n[0]);
-  fpz->ny = static_cast<int>(n[1] != 0 ? n[1] : 1);
-  fpz->nz = static_cast<int>(n[2] != 0 ? n[2] : 1);
-  fpz->nf = static_cast<int>(n[3] != 0 ? n[3] : 1);
+    log << name << " ~ DecompressTime: " << timer.getDuration() << " s"<< std::endl;
 
-  if (not fpzip_read(fpz, output)) {
-    std::cerr << "Decompression failed: "<< fpzip_errstr[fpzip_errno] << std::endl;
-    return EXIT_FAILURE;
+    return EXIT_SUCCESS;
   }
-
-  fpzip_read_close(fpz);
-  timer.stop();
-
-  std::free(input);
-  input = nullptr;
-
-  log << name << " ~ DecompressTime: " << timer.getDuration() << " s"<< std::endl;
-
-  return EXIT_SUCCESS;
 }
+
+/* -------------------------------------------------------------------------- */
+template int FPZIPCompressor::encode<float>(Span, Span, size_t*);
+template int FPZIPCompressor::encode<double>(Span, Span, size_t*);
+template int FPZIPCompressor::encode<int32_t>(Span, Span, size_t*);
+template int FPZIPCompressor::encode<int64_t>(Span, Span, size_t*);
+template int FPZIPCompressor::decode<float>(Span, Span, size_t*);
+template int FPZIPCompressor::decode<double>(Span, Span, size_t*);
+template int FPZIPCompressor::decode<int32_t>(Span, Span, size_t*);
+template int FPZIPCompressor::decode<int64_t>(Span, Span, size_t*);
 /* -------------------------------------------------------------------------- */
 #endif
@@ -0,0 +1,429 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <type_traits>
+#include "compressors/kernels/integer.hpp"
+#include "compressors/kernels/bitpack.h"
+#include "utils/timer.h"
+/* -------------------------------------------------------------------------- */
+namespace {
+
+  struct Header {
+    uint64_t numel;
+    uint32_t block;
+    uint8_t type_size;
+    uint8_t mode;
+    uint8_t sorted;
+    uint8_t padding;
+  };
+}
+
+/* -------------------------------------------------------------------------- */
+size_t IntegerCompressor::getBlockSize() const {
+  auto const found = parameters.find("block");
+  size_t const block = found != parameters.end() ? std::stoul(found->second) : 65536;
+  return std::max(group, (block + group - 1) / group * group);
+}
+
+/* -------------------------------------------------------------------------- */
+IntegerCompressor::Mode IntegerCompressor::getMode() const {
+  auto const found = parameters.find("mode");
+  if (found == parameters.end() or found->second == "auto")
+    return Auto;
+  return found->second == "for" ? FOR : Delta;
+}
+
+/* -------------------------------------------------------------------------- */
+bool IntegerCompressor::isSorted() const {
+  auto const found = parameters.find("sort");
+  return found != parameters.end() and found->second != "0" and found->second != "false";
+}
+
+/* -------------------------------------------------------------------------- */
+size_t IntegerCompressor::getStreamBound(size_t numel, size_t block) const {
+  size_t const nb_chunks = (numel + block - 1) / block;
+  size_t const nb_groups = numel / group + nb_chunks;
+
+  // worst case: full width groups all preceded by their base
+  return (nb_chunks + 1) * sizeof(uint64_t)
+       + nb_groups * (1 + sizeof(uint64_t))
+       + numel * sizeof(uint64_t);
+}
+
+/* -------------------------------------------------------------------------- */
+size_t IntegerCompressor::maxCompressedSize
+  (gio::Type type, size_t type_size, size_t* n) {
+
+  size_t const stream = getStreamBound(getNumElements(n), getBlockSize());
+  return sizeof(Header) + stream * (isSorted() ? 2 : 1);
+}
+
+/* -------------------------------------------------------------------------- */
+int IntegerCompressor::compress
+  (Span input, Span output, gio::Type type, size_t type_size, size_t* n) {
+
+  return dispatch(type, [&](auto* tag) {
+    return encode<std::remove_pointer_t<decltype(tag)>>(input, output, n);
+  });
+}
+
+/* -------------------------------------------------------------------------- */
+int IntegerCompressor::decompress
+  (Span input, Span output, gio::Type type, size_t type_size, size_t* n) {
+
+  return dispatch(type, [&](auto* tag) {
+    return decode<std::remove_pointer_t<decltype(tag)>>(input, output, n);
+  });
+}
+
+/* -------------------------------------------------------------------------- */
+size_t IntegerCompressor::encodeStream(
+  uint64_t const* input, size_t numel, size_t block, Mode mode, uint8_t* output) {
+
+  long const nb_chunks = (numel + block - 1) / block;
+  size_t const nb_groups = block / group;
+  size_t const table = (nb_chunks + 1) * sizeof(uint64_t);
+
+  codes.resize(numel);
+  widths.resize(nb_chunks * nb_groups);
+  offsets.assign(nb_chunks + 1, 0);
+
+  // pass 1: code each group with the narrowest scheme allowed
+  #pragma omp parallel for schedule(static)
+  for (long b = 0; b < nb_chunks; ++b) {
+    size_t const first = b * block;
+    size_t const count = std::min(block, numel - first);
+    size_t const groups = (count + group - 1) / group;
+    uint64_t const* v = input + first;
+    uint64_t* c = codes.data() + first;
+    uint8_t* w = widths.data() + b * nb_groups;
+    size_t bytes = groups;
+
+    for (size_t g = 0; g < groups; ++g) {
+      size_t const start = g * group;
+      size_t const length = std::min(group, count - start);
+      uint64_t const previous = start > 0 ? v[start - 1] : 0;
+      uint64_t merged = 0;
+      int64_t lowest = std::numeric_limits<int64_t>::max();
+      int64_t highest = std::numeric_limits<int64_t>::min();
+
+      #pragma omp simd reduction(|:merged) reduction(min:lowest) reduction(max:highest)
+      for (size_t k = start; k < start + length; ++k) {
+        uint64_t const before = (k > start ? v[k - 1] : previous);
+        c[k] = bitpack::zigzag(static_cast<int64_t>(v[k] - before));
+        merged |= c[k];
+        lowest = std::min(lowest, static_cast<int64_t>(v[k]));
+        highest = std::max(highest, static_cast<int64_t>(v[k]));
+      }
+
+      int const delta_width = bitpack::width(merged);
+      int const range_width = bitpack::width(uint64_t(highest) - uint64_t(lowest));
+      size_t const delta_bytes = bitpack::packedSize(length, delta_width);
+      size_t const range_bytes = bitpack::packedSize(length, range_width) + sizeof(uint64_t);
+      bool const use_range = (mode == FOR) or (mode == Auto and range_bytes < delta_bytes);
+
+      if (use_range) {
+        uint64_t const base = static_cast<uint64_t>(lowest);
+        #pragma omp simd
+        for (size_t k = start; k < start + length; ++k)
+          c[k] = v[k] - base;
+
+        w[g] = static_cast<uint8_t>(range_width | relative);
+        bytes += range_bytes;
+      } else {
+        w[g] = static_cast<uint8_t>(delta_width);
+        bytes += delta_bytes;
+      }
+    }
+    offsets[b + 1] = bytes;
+  }
+
+  for (long b = 0; b < nb_chunks; ++b)
+    offsets[b + 1] += offsets[b];
+
+  std::memcpy(output, offsets.data(), table);
+  uint8_t* base = output + table;
+
+  // pass 2: write each chunk at its final location
+  #pragma omp parallel for schedule(static)
+  for (long b = 0; b < nb_chunks; ++b) {
+    size_t const first = b * block;
+    size_t const count = std::min(block, numel - first);
+    size_t const groups = (count + group - 1) / group;
+    uint64_t const* v = input + first;
+    uint64_t const* c = codes.data() + first;
+    uint8_t const* w = widths.data() + b * nb_groups;
+    uint8_t* ptr = base + offsets[b];
+
+    std::memcpy(ptr, w, groups);
+    ptr += groups;
+
+    for (size_t g = 0; g < groups; ++g) {
+      size_t const start = g * group;
+      size_t const length = std::min(group, count - start);
+      if (w[g] & relative) {
+        uint64_t const lowest = v[start] - c[start];
+        std::memcpy(ptr, &lowest, sizeof(uint64_t));
+        ptr += sizeof(uint64_t);
+      }
+      ptr += bitpack::pack(c + start, length, w[g] & ~relative, ptr);
+    }
+  }
+
+  return table + offsets[nb_chunks];
+}
+
+/* -------------------------------------------------------------------------- */
+size_t IntegerCompressor::decodeStream(
+  uint8_t const* input, size_t size, size_t numel, size_t block, uint64_t* output) {
+
+  long const nb_chunks = (numel + block - 1) / block;
+  size_t const table = (nb_chunks + 1) * sizeof(uint64_t);
+
+  if (size < table)
+    return 0;
+
+  offsets.resize(nb_chunks + 1);
+  std::memcpy(offsets.data(), input, table);
+
+  if (table + offsets[nb_chunks] > size)
+    return 0;
+
+  uint8_t const* base = input + table;
+  int invalid = 0;
+
+  #pragma omp parallel for schedule(static) reduction(+:invalid)
+  for (long b = 0; b < nb_chunks; ++b) {
+    size_t const first = b * block;
+    size_t const count = std::min(block, numel - first);
+    size_t const groups = (count + group - 1) / group;
+    uint8_t const* w = base + offsets[b];
+    uint8_t const* ptr = w + groups;
+    uint64_t* y = output + first;
+    uint64_t previous = 0;
+
+    for (size_t g = 0; g < groups; ++g) {
+      size_t const start = g * group;
+      size_t const length = std::min(group, count - start);
+      int const width = w[g] & ~relative;
+
+      if (width > 64) {
+        invalid++;
+        break;
+      }
+
+      if (w[g] & relative) {
+        uint64_t lowest = 0;
+        std::memcpy(&lowest, ptr, sizeof(uint64_t));
+        ptr += sizeof(uint64_t);
+        ptr += bitpack::unpack(ptr, length, width, y + start);
+
+        #pragma omp simd
+        for (size_t k = start; k < start + length; ++k)
+          y[k] += lowest;
+      } else {
+        ptr += bitpack::unpack(ptr, length, width, y + start);
+        for (size_t k = start; k < start + length; ++k) {
+          previous += static_cast<uint64_t>(bitpack::unzigzag(y[k]));
+          y[k] = previous;
+        }
+      }
+      previous = y[start + length - 1];
+    }
+  }
+
+  return invalid ? 0 : table + offsets[nb_chunks];
+}
+
+/* -------------------------------------------------------------------------- */
+template <typename T>
+int IntegerCompressor::encode(Span input, Span output, size_t* n) {
+
+  if constexpr (not std::is_integral<T>::value) {
+    std::cerr << "Compression failed: " << name << " requires integer data" << std::endl;
+    return EXIT_FAILURE;
+  } else {
+    Timer timer;
+    timer.start();
+
+    size_t const numel = getNumElements(n);
+    size_t const block = getBlockSize();
+    Mode const mode = getMode();
+    bool const sorted = isSorted();
+
+    if (output.size < maxCompressedSize(gio::Type::Int64, sizeof(T), n)) {
+      std::cerr << "Compression failed: output buffer too small" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    // values are handled as 64-bit two's complement, no copy for 64-bit data
+    uint64_t const* source = static_cast<uint64_t const*>(input.data);
+    if constexpr (sizeof(T) != sizeof(uint64_t)) {
+      auto const* x = static_cast<T const*>(input.data);
+      values.resize(numel);
+
+      #pragma omp parallel for simd schedule(static)
+      for (long i = 0; i < long(numel); ++i)
+        values[i] = static_cast<uint64_t>(static_cast<int64_t>(x[i]));
+      source = values.data();
+    }
+
+    auto* raw = static_cast<uint8_t*>(output.data);
+    Header const header {
+      numel, static_cast<uint32_t>(block), sizeof(T), mode, sorted, 0
+    };
+    std::memcpy(raw, &header, sizeof(Header));
+    size_t offset = sizeof(Header);
+
+    if (sorted) {
+      // sort by value then by position to keep equal ids in order
+      permutation.resize(numel);
+      std::iota(permutation.begin(), permutation.end(), 0);
+      std::sort(permutation.begin(), permutation.end(), [&](uint64_t a, uint64_t b) {
+        auto const u = static_cast<int64_t>(source[a]);
+        auto const v = static_cast<int64_t>(source[b]);
+        return u < v or (u == v and a < b);
+      });
+
+      ordered.resize(numel);
+      #pragma omp parallel for simd schedule(static)
+      for (long i = 0; i < long(numel); ++i)
+        ordered[i] = source[permutation[i]];
+
+      offset += encodeStream(ordered.data(), numel, block, Delta, raw + offset);
+      offset += encodeStream(permutation.data(), numel, block, mode, raw + offset);
+    } else {
+      offset += encodeStream(source, numel, block, mode, raw + offset);
+    }
+
+    bytes = offset;
+    timer.stop();
+
+    log << std::endl << name;
+    log << " ~ InputBytes: " << sizeof(T) * numel;
+    log << ", OutputBytes: " << bytes;
+    log << ", cRatio: " << (sizeof(T) * numel / static_cast<float>(bytes));
+    log << ", #elements: " << numel << std::endl;
+    log << name << " ~ CompressTime: " << timer.getDuration() << " s" << std::endl;
+    return EXIT_SUCCESS;
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+template <typename T>
+int IntegerCompressor::decode(Span input, Span output, size_t* n) {
+
+  if constexpr (not std::is_integral<T>::value) {
+    std::cerr << "Decompression failed: " << name << " requires integer data" << std::endl;
+    return EXIT_FAILURE;
+  } else {
+    Timer timer;
+    timer.start();
+
+    Header header {};
+    if (input.size < sizeof(Header)) {
+      std::cerr << "Decompression failed: truncated input" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    std::memcpy(&header, input.data, sizeof(Header));
+    size_t const numel = header.numel;
+    size_t const block = header.block;
+
+    if (header.type_size != sizeof(T) or block == 0 or block % group != 0
+        or numel != getNumElements(n) or output.size < numel * sizeof(T)) {
+      std::cerr << "Decompression failed: inconsistent header" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    // 64-bit values in original order are decoded in place
+    bool const in_place = (sizeof(T) == sizeof(uint64_t) and not header.sorted);
+    auto* y = static_cast<T*>(output.data);
+    uint64_t* target = nullptr;
+
+    if (in_place) {
+      target = static_cast<uint64_t*>(output.data);
+    } else {
+      values.resize(numel);
+      target = values.data();
+    }
+
+    auto const* raw = static_cast<uint8_t const*>(input.data);
+    size_t offset = sizeof(Header);
+    size_t used = decodeStream(raw + offset, input.size - offset, numel, block, target);
+    bool valid = (used > 0);
+
+    if (valid and header.sorted) {
+      offset += used;
+      permutation.resize(numel);
+      used = decodeStream(raw + offset, input.size - offset, numel, block, permutation.data());
+      valid = (used > 0);
+
+      long misplaced = 0;
+      #pragma omp parallel for schedule(static) reduction(+:misplaced)
+      for (long i = 0; i < long(numel); ++i) {
+        if (valid and permutation[i] < numel)
+          y[permutation[i]] = static_cast<T>(static_cast<int64_t>(target[i]));
+        else
+          misplaced++;
+      }
+      valid = (misplaced == 0);
+    } else if (valid and not in_place) {
+      #pragma omp parallel for simd schedule(static)
+      for (long i = 0; i < long(numel); ++i)
+        y[i] = static_cast<T>(static_cast<int64_t>(target[i]));
+    }
+
+    if (not valid) {
+      std::cerr << "Decompression failed: corrupted input" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    timer.stop();
+    log << name << " ~ DecompressTime: " << timer.getDuration() << " s" << std::endl;
+    return EXIT_SUCCESS;
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+template int IntegerCompressor::encode<float>(Span, Span, size_t*);
+template int IntegerCompressor::encode<double>(Span, Span, size_t*);
+template int IntegerCompressor::encode<int32_t>(Span, Span, size_t*);
+template int IntegerCompressor::encode<int64_t>(Span, Span, size_t*);
+template int IntegerCompressor::decode<float>(Span, Span, size_t*);
+template int IntegerCompressor::decode<double>(Span, Span, size_t*);
+template int IntegerCompressor::decode<int32_t>(Span, Span, size_t*);
+template int IntegerCompressor::decode<int64_t>(Span, Span, size_t*);
+/* -------------------------------------------------------------------------- */
@@ -37,20 +37,21 @@
 #include <sstream>
 #include "compressors/kernels/isabela.hpp"
 #include "utils/timer.h"
+/* -------------------------------------------------------------------------- */
+size_t IsabelaCompressor::maxCompressedSize
+  (gio::Type type, size_t type_size, size_t* n) {
+  return type_size * getNumElements(n);
+}
+
 /* -------------------------------------------------------------------------- */
 int IsabelaCompressor::compress
-  (void* input, void*& output, std::string type, size_t type_size, size_t * n) {
+  (Span input, Span output, gio::Type type, size_t type_size, size_t * n) {
 
-  size_t numel = n[0];
-  for (int i = 1; i < 5; i++)
-    if (n[i] != 0)
-      numel *= n[i];
+  size_t numel = getNumElements(n);
 
   Timer timer;
   timer.start();
 
-  output = malloc(type_size * numel);
-
   enum ISABELA_status status;
   struct isabela_stream i_strm {};
   struct isabela_config config {};
@@ -95,9 +96,9 @@ int IsabelaCompressor::compress
   status = isabelaDeflateInit (&i_strm, type_size, &config);
   assert (status == ISABELA_SUCCESS);
 
-  i_strm.next_in = input;
+  i_strm.next_in = input.data;
   i_strm.avail_in = type_size * numel;
-  i_strm.next_out = output;
+  i_strm.next_out = output.data;
 
   // Perform compression
   status = isabelaDeflate (&i_strm, ISABELA_FINISH);
@@ -125,18 +126,11 @@ int IsabelaCompressor::compress
 
 /* -------------------------------------------------------------------------- */
 int IsabelaCompressor::decompress
-  (void*& input, void*& output, std::string type, size_t type_size, size_t* n) {
-
-  size_t numel = n[0];
-  for (int i = 1; i < 5; i++)
-    if (n[i] != 0)
-      numel *= n[i];
+  (Span input, Span output, gio::Type type, size_t type_size, size_t* n) {
 
   Timer timer;
   timer.start();
 
-  output = malloc(type_size * numel);
-
   enum ISABELA_status status;
   struct isabela_stream i_strm {};
   struct isabela_config config {};
@@ -173,9 +167,9 @@ int IsabelaCompressor::decompress
   // Setup compression (deflate) with isabela_config
   status = isabelaInflateInit (&i_strm, type_size, &config);
 
-  i_strm.next_in = input;
-  i_strm.avail_in = type_size * numel;
-  i_strm.next_out = output;
+  i_strm.next_in = input.data;
+  i_strm.avail_in = input.size;
+  i_strm.next_out = output.data;
 
   // Perform Decompression
   status = isabelaInflate(&i_strm, ISABELA_FINISH);
@@ -191,8 +185,7 @@ int IsabelaCompressor::decompress
     return EXIT_FAILURE;
   }
 
-  std::free(input);
-  input= nullptr;
+  timer.stop();
 
   log << name << " ~ DecompressTime: " << timer.getDuration() << " s"<< std::endl;
 
@@ -0,0 +1,407 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+#include "compressors/kernels/lorenzo.hpp"
+#include "compressors/kernels/bitpack.h"
+#include "utils/timer.h"
+/* -------------------------------------------------------------------------- */
+namespace {
+
+  struct Header {
+    uint64_t numel;
+    uint32_t block;
+    uint32_t type_size;
+    double abs;
+  };
+
+  // codes beyond this magnitude would overflow once predicted
+  constexpr double limit = 4503599627370496.;   // 2^52
+
+  // value rebuilt by the decoder from a code
+  template <typename T>
+  inline T dequantize(double code, double step) {
+    if constexpr (std::is_integral<T>::value)
+      return static_cast<T>(std::nearbyint(code * step));
+    else
+      return static_cast<T>(code * step);
+  }
+
+  // quantize a single value, false if it must be stored raw.
+  // the bound is checked on the value actually rebuilt by the decoder.
+  template <typename T>
+  inline bool quantize(T value, double scale, double step, double abs, int64_t& code) {
+    double const rounded = std::nearbyint(double(value) * scale);
+    bool const valid = std::abs(rounded) < limit
+      and std::abs(double(value) - double(dequantize<T>(rounded, step))) <= abs;
+    code = static_cast<int64_t>(valid ? rounded : 0.);
+    return valid;
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+double LorenzoCompressor::getErrorBound() const {
+  auto const found = parameters.find("abs");
+  return found != parameters.end() ? std::stod(found->second) : 1E-3;
+}
+
+/* -------------------------------------------------------------------------- */
+size_t LorenzoCompressor::getBlockSize() const {
+  auto const found = parameters.find("block");
+  size_t const block = found != parameters.end() ? std::stoul(found->second) : 4096;
+  return std::max(group, block);
+}
+
+/* -------------------------------------------------------------------------- */
+size_t LorenzoCompressor::maxCompressedSize
+  (gio::Type type, size_t type_size, size_t* n) {
+
+  size_t const numel = getNumElements(n);
+  size_t const block = getBlockSize();
+  size_t const nb_blocks = (numel + block - 1) / block;
+  size_t const nb_groups = (block + group - 1) / group;
+
+  // worst case: full width codes and every value being an outlier
+  return sizeof(Header) + (nb_blocks + 1) * sizeof(uint64_t)
+       + nb_blocks * (sizeof(uint32_t) + nb_groups)
+       + numel * (sizeof(uint64_t) + sizeof(uint32_t) + type_size);
+}
+
+/* -------------------------------------------------------------------------- */
+int LorenzoCompressor::compress
+  (Span input, Span output, gio::Type type, size_t type_size, size_t* n) {
+
+  // the bound checker would verify a bound never applied otherwise
+  for (auto&& key : {"rel", "pw_rel"}) {
+    if (parameters.count(key)) {
+      std::cerr << "Compression failed: " << name << " only supports an 'abs' bound";
+      std::cerr << ", not '" << key << "'" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  return dispatch(type, [&](auto* tag) {
+    return encode<std::remove_pointer_t<decltype(tag)>>(input, output, n);
+  });
+}
+
+/* -------------------------------------------------------------------------- */
+int LorenzoCompressor::decompress
+  (Span input, Span output, gio::Type type, size_t type_size, size_t* n) {
+
+  return dispatch(type, [&](auto* tag) {
+    return decode<std::remove_pointer_t<decltype(tag)>>(input, output, n, 0, getNumElements(n));
+  });
+}
+
+/* -------------------------------------------------------------------------- */
+int LorenzoCompressor::decompressRange(Span input, Span output, gio::Type type,
+                                       size_t type_size, size_t* n, size_t first, size_t count) {
+
+  return dispatch(type, [&](auto* tag) {
+    return decode<std::remove_pointer_t<decltype(tag)>>(input, output, n, first, count);
+  });
+}
+
+/* -------------------------------------------------------------------------- */
+template <typename T>
+int LorenzoCompressor::encode(Span input, Span output, size_t* n) {
+
+  Timer timer;
+  timer.start();
+
+  double const abs = getErrorBound();
+  if (not (abs > 0.)) {
+    std::cerr << "Compression failed: invalid error bound " << abs << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  size_t const numel = getNumElements(n);
+  size_t const block = getBlockSize();
+  long const nb_blocks = (numel + block - 1) / block;
+  size_t const nb_groups = (block + group - 1) / group;
+  size_t const header_size = sizeof(Header) + (nb_blocks + 1) * sizeof(uint64_t);
+
+  if (output.size < header_size) {
+    std::cerr << "Compression failed: output buffer too small" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  double const step = 2 * abs;
+  double const scale = 1. / step;
+  auto const* data = static_cast<T const*>(input.data);
+
+  codes.resize(numel);
+  widths.resize(nb_blocks * nb_groups);
+  nb_outliers.resize(nb_blocks);
+  offsets.assign(nb_blocks + 1, 0);
+
+  // pass 1: quantize, predict and compute the exact size of each block
+  #pragma omp parallel
+  {
+    std::vector<int64_t> quant(block);
+
+    #pragma omp for schedule(static)
+    for (long b = 0; b < nb_blocks; ++b) {
+      size_t const first = b * block;
+      size_t const count = std::min(block, numel - first);
+      T const* x = data + first;
+      int64_t* q = quant.data();
+      uint64_t* c = codes.data() + first;
+      uint32_t outliers = 0;
+
+      #pragma omp simd reduction(+:outliers)
+      for (size_t i = 0; i < count; ++i)
+        outliers += not quantize(x[i], scale, step, abs, q[i]);
+
+      // outliers take the previous code to keep deltas small
+      if (outliers > 0) {
+        int64_t code = 0;
+        for (size_t i = 0; i < count; ++i) {
+          if (not quantize(x[i], scale, step, abs, code))
+            q[i] = (i > 0 ? q[i - 1] : 0);
+        }
+      }
+
+      c[0] = bitpack::zigzag(q[0]);
+      #pragma omp simd
+      for (size_t i = 1; i < count; ++i)
+        c[i] = bitpack::zigzag(q[i] - q[i - 1]);
+
+      size_t const groups = (count + group - 1) / group;
+      size_t bytes = sizeof(uint32_t) + groups;
+
+      for (size_t g = 0; g < groups; ++g) {
+        size_t const start = g * group;
+        size_t const length = std::min(group, count - start);
+        uint64_t merged = 0;
+
+        #pragma omp simd reduction(|:merged)
+        for (size_t k = 0; k < length; ++k)
+          merged |= c[start + k];
+
+        int const width = bitpack::width(merged);
+        widths[b * nb_groups + g] = static_cast<uint8_t>(width);
+        bytes += bitpack::packedSize(length, width);
+      }
+
+      nb_outliers[b] = outliers;
+      offsets[b + 1] = bytes + outliers * (sizeof(uint32_t) + sizeof(T));
+    }
+  }
+
+  for (long b = 0; b < nb_blocks; ++b)
+    offsets[b + 1] += offsets[b];
+
+  if (header_size + offsets[nb_blocks] > output.size) {
+    std::cerr << "Compression failed: output buffer too small" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  auto* raw = static_cast<uint8_t*>(output.data);
+  Header const header { numel, static_cast<uint32_t>(block), sizeof(T), abs };
+  std::memcpy(raw, &header, sizeof(Header));
+  std::memcpy(raw + sizeof(Header), offsets.data(), (nb_blocks + 1) * sizeof(uint64_t));
+
+  // pass 2: write each block at its final location
+  uint8_t* base = raw + header_size;
+
+  #pragma omp parallel for schedule(static)
+  for (long b = 0; b < nb_blocks; ++b) {
+    size_t const first = b * block;
+    size_t const count = std::min(block, numel - first);
+    size_t const groups = (count + group - 1) / group;
+    uint64_t const* c = codes.data() + first;
+    uint8_t* ptr = base + offsets[b];
+
+    std::memcpy(ptr, &nb_outliers[b], sizeof(uint32_t));
+    ptr += sizeof(uint32_t);
+    std::memcpy(ptr, &widths[b * nb_groups], groups);
+    ptr += groups;
+
+    for (size_t g = 0; g < groups; ++g) {
+      size_t const start = g * group;
+      size_t const length = std::min(group, count - start);
+      ptr += bitpack::pack(c + start, length, widths[b * nb_groups + g], ptr);
+    }
+
+    if (nb_outliers[b] > 0) {
+      T const* x = data + first;
+      uint8_t* indices = ptr;
+      uint8_t* values = ptr + nb_outliers[b] * sizeof(uint32_t);
+      int64_t code = 0;
+
+      for (size_t i = 0; i < count; ++i) {
+        if (not quantize(x[i], scale, step, abs, code)) {
+          auto const index = static_cast<uint32_t>(i);
+          std::memcpy(indices, &index, sizeof(uint32_t));
+          std::memcpy(values, x + i, sizeof(T));
+          indices += sizeof(uint32_t);
+          values += sizeof(T);
+        }
+      }
+    }
+  }
+
+  bytes = header_size + offsets[nb_blocks];
+  timer.stop();
+
+  log << std::endl << name;
+  log << " ~ InputBytes: " << sizeof(T) * numel;
+  log << ", OutputBytes: " << bytes;
+  log << ", cRatio: " << (sizeof(T) * numel / static_cast<float>(bytes));
+  log << ", #elements: " << numel << std::endl;
+  log << name << " ~ CompressTime: " << timer.getDuration() << " s" << std::endl;
+  return EXIT_SUCCESS;
+}
+
+/* -------------------------------------------------------------------------- */
+template <typename T>
+int LorenzoCompressor::decode(Span input, Span output, size_t* n,
+                              size_t first, size_t count) {
+
+  Timer timer;
+  timer.start();
+
+  Header header {};
+  if (input.size < sizeof(Header)) {
+    std::cerr << "Decompression failed: truncated input" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::memcpy(&header, input.data, sizeof(Header));
+  size_t const numel = header.numel;
+  size_t const block = header.block;
+  long const nb_blocks = block > 0 ? (numel + block - 1) / block : 0;
+  size_t const header_size = sizeof(Header) + (nb_blocks + 1) * sizeof(uint64_t);
+
+  if (header.type_size != sizeof(T) or block == 0 or numel != getNumElements(n)
+      or first + count > numel or output.size < count * sizeof(T)
+      or input.size < header_size) {
+    std::cerr << "Decompression failed: inconsistent header" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // only blocks covering the requested range are decoded,
+  // so that decoding a stream piece by piece stays linear
+  long const first_block = count > 0 ? first / block : 0;
+  long const last_block = count > 0 ? (first + count - 1) / block + 1 : 0;
+  auto const* raw = static_cast<uint8_t const*>(input.data);
+  uint64_t total = 0;
+
+  offsets.resize(last_block - first_block + 1);
+  std::memcpy(offsets.data(), raw + sizeof(Header) + first_block * sizeof(uint64_t),
+              offsets.size() * sizeof(uint64_t));
+  std::memcpy(&total, raw + sizeof(Header) + nb_blocks * sizeof(uint64_t), sizeof(uint64_t));
+
+  if (header_size + total > input.size) {
+    std::cerr << "Decompression failed: truncated input" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  double const step = 2 * header.abs;
+  uint8_t const* base = raw + header_size;
+  auto* data = static_cast<T*>(output.data);
+
+  #pragma omp parallel
+  {
+    std::vector<uint64_t> c(block);
+    std::vector<int64_t> q(block);
+    std::vector<T> partial;
+
+    #pragma omp for schedule(static)
+    for (long b = first_block; b < last_block; ++b) {
+      size_t const start = b * block;
+      size_t const length = std::min(block, numel - start);
+      size_t const lower = std::max(start, first);
+      size_t const upper = std::min(start + length, first + count);
+      bool const whole = (lower == start and upper == start + length);
+      size_t const groups = (length + group - 1) / group;
+      uint8_t const* ptr = base + offsets[b - first_block];
+      uint8_t const* group_widths = ptr + sizeof(uint32_t);
+      uint32_t outliers = 0;
+
+      std::memcpy(&outliers, ptr, sizeof(uint32_t));
+      ptr += sizeof(uint32_t) + groups;
+
+      for (size_t g = 0; g < groups; ++g) {
+        size_t const offset = g * group;
+        size_t const size = std::min(group, length - offset);
+        ptr += bitpack::unpack(ptr, size, group_widths[g], c.data() + offset);
+      }
+
+      // undo prediction then dequantize
+      int64_t code = 0;
+      for (size_t i = 0; i < length; ++i) {
+        code += bitpack::unzigzag(c[i]);
+        q[i] = code;
+      }
+
+      // blocks partially covered are rebuilt aside then trimmed
+      if (not whole)
+        partial.resize(block);
+      T* y = whole ? data + (start - first) : partial.data();
+
+      #pragma omp simd
+      for (size_t i = 0; i < length; ++i)
+        y[i] = dequantize<T>(double(q[i]), step);
+
+      uint8_t const* indices = ptr;
+      uint8_t const* values = ptr + outliers * sizeof(uint32_t);
+      for (uint32_t k = 0; k < outliers; ++k) {
+        uint32_t index = 0;
+        std::memcpy(&index, indices + k * sizeof(uint32_t), sizeof(uint32_t));
+        std::memcpy(y + index, values + k * sizeof(T), sizeof(T));
+      }
+
+      if (not whole)
+        std::memcpy(data + (lower - first), y + (lower - start), (upper - lower) * sizeof(T));
+    }
+  }
+
+  timer.stop();
+  log << name << " ~ DecompressTime: " << timer.getDuration() << " s" << std::endl;
+  return EXIT_SUCCESS;
+}
+
+/* -------------------------------------------------------------------------- */
+template int LorenzoCompressor::encode<float>(Span, Span, size_t*);
+template int LorenzoCompressor::encode<double>(Span, Span, size_t*);
+template int LorenzoCompressor::encode<int32_t>(Span, Span, size_t*);
+template int LorenzoCompressor::encode<int64_t>(Span, Span, size_t*);
+template int LorenzoCompressor::decode<float>(Span, Span, size_t*, size_t, size_t);
+template int LorenzoCompressor::decode<double>(Span, Span, size_t*, size_t, size_t);
+template int LorenzoCompressor::decode<int32_t>(Span, Span, size_t*, size_t, size_t);
+template int LorenzoCompressor::decode<int64_t>(Span, Span, size_t*, size_t, size_t);
+/* -------------------------------------------------------------------------- */
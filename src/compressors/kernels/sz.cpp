@@ -32,20 +32,84 @@
 #if ENABLE_SZ
 /* -------------------------------------------------------------------------- */
 #include <sstream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#include <omp.h>
 #include "compressors/kernels/sz.hpp"
 #include "utils/timer.h"
+/* -------------------------------------------------------------------------- */
+/* static */ int SZCompressor::nb_instances = 0;
+
+/* -------------------------------------------------------------------------- */
+template <typename T>
+static constexpr int dataType() {
+  if constexpr (std::is_same<T, float>::value)
+    return SZ_FLOAT;
+  else if constexpr (std::is_same<T, double>::value)
+    return SZ_DOUBLE;
+  else if constexpr (std::is_same<T, int32_t>::value)
+    return SZ_INT32;
+  else
+    return SZ_INT64;
+}
+
+/* -------------------------------------------------------------------------- */
+void SZCompressor::init() {
+  // initialize the global context once, not on each call
+  if (nb_instances++ == 0)
+    SZ_Init(nullptr);
+}
+
+/* -------------------------------------------------------------------------- */
+void SZCompressor::close() {
+  if (nb_instances > 0 and --nb_instances == 0)
+    SZ_Finalize();
+}
+
+/* -------------------------------------------------------------------------- */
+int SZCompressor::getThreads() const {
+  auto const found = parameters.find("threads");
+  return found != parameters.end() ? std::max(1, std::stoi(found->second)) : 1;
+}
+
+/* -------------------------------------------------------------------------- */
+size_t SZCompressor::maxCompressedSize
+  (gio::Type type, size_t type_size, size_t* n) {
+  // SZ has no bound query: on unpredictable data it falls back to
+  // storing raw values, so leave room for its header and entropy coder.
+  // streams above it are rejected by 'compress' rather than overflowing.
+  size_t const isize = type_size * getNumElements(n);
+  return isize + isize / 64 + 4096;
+}
+
 /* -------------------------------------------------------------------------- */
 int SZCompressor::compress
-  (void* input, void*& output, std::string type, size_t type_size, size_t* n) {
+  (Span input, Span output, gio::Type type, size_t type_size, size_t* n) {
 
-  size_t numel = n[0];
-  for (int i = 1; i < 5; i++)
-    if (n[i] != 0)
-      numel *= n[i];
+  return dispatch(type, [&](auto* tag) {
+    return encode<std::remove_pointer_t<decltype(tag)>>(input, output, n);
+  });
+}
+
+/* -------------------------------------------------------------------------- */
+int SZCompressor::decompress
+  (Span input, Span output, gio::Type type, size_t type_size, size_t* n) {
+
+  return dispatch(type, [&](auto* tag) {
+    return decode<std::remove_pointer_t<decltype(tag)>>(input, output, n);
+  });
+}
+
+/* -------------------------------------------------------------------------- */
+template <typename T>
+int SZCompressor::encode(Span input, Span output, size_t* n) {
+
+  size_t numel = getNumElements(n);
 
   Timer timer;
   timer.start();
-  SZ_Init(nullptr);
 
   int mode = PW_REL; // Default by Sheng, PW_REL = 10
   std::string _mode = "PW_REL";
@@ -64,7 +128,7 @@ int SZCompressor::compress
   if (parameters.count("abs")) {
     std::string value = parameters["abs"];
     if (not value.empty()) {
-      relTol = std::stod(value);
+      absTol = std::stod(value);
       mode = ABS;
       _mode = "ABS";
     }
@@ -74,23 +138,40 @@ int SZCompressor::compress
   if (parameters.count("pw_rel")) {
     std::string value = parameters["pw_rel"];
     if (not value.empty()) {
-      relTol = std::stod(value);
+      powerTol = std::stod(value);
       mode = PW_REL;
       _mode = "PW_REL";
       // Unknown mode, just fill in input to SZ
     }
   }
 
+  // threads are set for the call only, other kernels keep their own
+  int const threads = getThreads();
+  int const previous = omp_get_max_threads();
+  omp_set_num_threads(threads);
+
+  // SZ writes with no capacity limit, so it compresses into its own
+  // buffer and the stream is copied once its size is checked.
   size_t size = 0;
-  uint8_t* data = SZ_compress_args(
-    SZ_FLOAT, static_cast<float*>(input), &size, mode,
-    absTol, relTol, powerTol, n[4], n[3], n[2], n[1], n[0]
+  unsigned char* compressed = SZ_compress_args(
+    dataType<T>(), input.data, &size,
+    mode, absTol, relTol, powerTol, n[4], n[3], n[2], n[1], n[0]
   );
+  omp_set_num_threads(previous);
+
+  if (compressed == nullptr or size > output.size) {
+    std::cerr << "Compression failed: " << size << " bytes for a buffer of ";
+    std::cerr << output.size << std::endl;
+    std::free(compressed);
+    return EXIT_FAILURE;
+  }
+
+  std::memcpy(output.data, compressed, size);
+  std::free(compressed);
 
-  output = data;
   bytes = size;
   timer.stop();
-  auto const input_bytes = static_cast<float>(type_size * numel);
+  auto const input_bytes = static_cast<float>(sizeof(T) * numel);
 
   log << std::endl << name;
   log << " ~ InputBytes: " << input_bytes;
@@ -102,6 +183,7 @@ int SZCompressor::compress
   log << ", abs: " << absTol;
   log << ", rel: " << relTol;
   log << ", pw_tol: " << powerTol;
+  log << ", threads: " << threads;
   log << " val: " << n[4] <<", "<< n[3] <<", "<< n[2] <<", "<<n[1] <<", "<< n[0];
   log << std::endl;
 
@@ -110,29 +192,39 @@ int SZCompressor::compress
 }
 
 /* -------------------------------------------------------------------------- */
-int SZCompressor::decompress
-  (void*& input, void*& output, std::string type, size_t type_size, size_t* n) {
-
-  size_t numel = n[0];
-  for (int i = 1; i < 5; i++)
-    if (n[i] != 0)
-      numel *= n[i];
+template <typename T>
+int SZCompressor::decode(Span input, Span output, size_t* n) {
 
   Timer timer;
   timer.start();
 
-  output = SZ_decompress(
-    SZ_FLOAT, static_cast<std::uint8_t*>(input),
-    bytes, n[4], n[3], n[2], n[1], n[0]
+  int const previous = omp_get_max_threads();
+  omp_set_num_threads(getThreads());
+
+  size_t numel = SZ_decompress_args(
+    dataType<T>(), static_cast<unsigned char*>(input.data), input.size,
+    output.data, n[4], n[3], n[2], n[1], n[0]
   );
+  omp_set_num_threads(previous);
 
-  timer.stop();
+  if (numel != getNumElements(n)) {
+    std::cerr << "Decompression failed: " << numel << std::endl;
+    return EXIT_FAILURE;
+  }
 
-  std::free(input);
-  input = nullptr;
+  timer.stop();
 
   log << name << " ~ DecompressTime: " << timer.getDuration() << " s"<< std::endl;
   return EXIT_SUCCESS;
 }
 /* -------------------------------------------------------------------------- */
+template int SZCompressor::encode<float>(Span, Span, size_t*);
+template int SZCompressor::encode<double>(Span, Span, size_t*);
+template int SZCompressor::encode<int32_t>(Span, Span, size_t*);
+template int SZCompressor::encode<int64_t>(Span, Span, size_t*);
+template int SZCompressor::decode<float>(Span, Span, size_t*);
+template int SZCompressor::decode<double>(Span, Span, size_t*);
+template int SZCompressor::decode<int32_t>(Span, Span, size_t*);
+template int SZCompressor::decode<int64_t>(Span, Span, size_t*);
+/* -------------------------------------------------------------------------- */
 #endif
@@ -35,36 +35,60 @@
 #include <cstring>
 #include <cmath>
 #include <cassert>
+#include <omp.h>
 #include "compressors/kernels/zfp.hpp"
 #include "utils/timer.h"
 /* -------------------------------------------------------------------------- */
 
-zfp_type ZFPCompressor::getZfpType(std::string const& type) const {
-  if (type == "float")
-    return zfp_type_float;
-  else if (type == "double")
-    return zfp_type_double;
-  else if (type == "int32_t" or type == "int16_t")
-    return zfp_type_int32;
-  else if (type == "int64_t")
-    return zfp_type_int64;
-  else
-    throw std::runtime_error("invalid type");
+zfp_type ZFPCompressor::getZfpType(gio::Type type) const {
+  switch (type) {
+    case gio::Type::Float:  return zfp_type_float;
+    case gio::Type::Double: return zfp_type_double;
+    case gio::Type::Int:
+    case gio::Type::Int32:  return zfp_type_int32;
+    case gio::Type::Int64:  return zfp_type_int64;
+    default: return zfp_type_none;
+  }
 }
 
 /* -------------------------------------------------------------------------- */
-int ZFPCompressor::compress
-  (void *input, void *&output, std::string data_type, size_t type_size, size_t* n) {
+void ZFPCompressor::init() {
+  // stream and field meta data are allocated once and reused
+  zfp = zfp_stream_open(nullptr);
+  field = zfp_field_alloc();
+}
+
+/* -------------------------------------------------------------------------- */
+void ZFPCompressor::close() {
+  if (field != nullptr)
+    zfp_field_free(field);
+  if (zfp != nullptr)
+    zfp_stream_close(zfp);
+
+  field = nullptr;
+  zfp = nullptr;
+}
 
+/* -------------------------------------------------------------------------- */
+void ZFPCompressor::configure(gio::Type type, size_t* n) {
+
+  assert(zfp != nullptr and field != nullptr);
+
+  // extents are given fastest varying first, unset ones are skipped
+  size_t extents[5] = {n[0], 1, 1, 1, 1};
   size_t numel = n[0];
   dims = 1;
   for (int i = 1; i < 5; i++) {
     if (n[i] != 0) {
       numel *= n[i];
-      dims++;
+      extents[dims++] = n[i];
     }
   }
 
+  // zfp has no 5D fields
+  if (dims > 4)
+    dims = 1;
+
   // Read in json compression parameters
   double abs = 1E-3;
   int rel = 32;
@@ -85,54 +109,96 @@ int ZFPCompressor::compress
     zfp_mode_ = zfp_BIT;
   }
 
-  Timer timer;
-  timer.start();
-
-  zfp_type type = getZfpType(data_type);
+  zfp_type const zfp_data_type = getZfpType(type);
 
-  // allocate meta data for the 1D input array
-  zfp_field* field = nullptr;
+  // update meta data of the field
+  zfp_field_set_type(field, zfp_data_type);
 
   switch (dims) {
-    case 1: field = zfp_field_1d(input, type, numel); break;
-    case 2: field = zfp_field_2d(input, type, n[1], n[0]); break;
-    case 3: field = zfp_field_3d(input, type, n[2], n[1], n[0]); break;
-    case 4: field = zfp_field_4d(input, type, n[3], n[2], n[1], n[0]); break;
+    case 1: zfp_field_set_size_1d(field, numel); break;
+    case 2: zfp_field_set_size_2d(field, extents[0], extents[1]); break;
+    case 3: zfp_field_set_size_3d(field, extents[0], extents[1], extents[2]); break;
+    case 4: zfp_field_set_size_4d(field, extents[0], extents[1], extents[2], extents[3]); break;
     default: break;
   }
 
-  // allocate meta data for a compressed stream
-  zfp_stream *zfp = zfp_stream_open(nullptr);
-
   // set absolute/relative error tolerance
   switch (zfp_mode_) {
     case zfp_ABS: zfp_stream_set_accuracy(zfp, abs); break;
     case zfp_REL: zfp_stream_set_precision(zfp, rel); break;
-    case zfp_BIT: zfp_stream_set_rate(zfp, rate, type, dims, 0); break;
+    case zfp_BIT: zfp_stream_set_rate(zfp, rate, zfp_data_type, dims, 0); break;
     default: break;
   }
+}
+
+/* -------------------------------------------------------------------------- */
+bool ZFPCompressor::setExecution(bool parallel) {
+
+  // keeps the thread count of the last compression
+  if (not parallel)
+    return zfp_stream_set_execution(zfp, zfp_exec_serial);
+
+  threads = 1;
+  if (not parameters.count("threads"))
+    return zfp_stream_set_execution(zfp, zfp_exec_serial);
+
+  int const requested = std::stoi(parameters["threads"]);
+  int const count = requested > 0 ? requested : omp_get_max_threads();
+  unsigned const chunk = parameters.count("chunk") ? std::stoul(parameters["chunk"]) : 0;
+
+  // falls back to serial when zfp is built without OpenMP
+  if (count > 1 and zfp_stream_set_execution(zfp, zfp_exec_omp)) {
+    zfp_stream_set_omp_threads(zfp, count);
+    zfp_stream_set_omp_chunk_size(zfp, chunk);
+    threads = count;
+    return true;
+  }
+  return zfp_stream_set_execution(zfp, zfp_exec_serial);
+}
+
+/* -------------------------------------------------------------------------- */
+size_t ZFPCompressor::maxCompressedSize
+  (gio::Type type, size_t type_size, size_t* n) {
 
-  //allocate buffer for compressed data
-  size_t bufsize = zfp_stream_maximum_size(zfp, field);
-  output = malloc(bufsize);
+  if (getZfpType(type) == zfp_type_none)
+    return 0;
 
-  // associate bit stream with allocated buffer
-  bitstream *stream = stream_open(output, bufsize);
+  configure(type, n);
+  return zfp_stream_maximum_size(zfp, field);
+}
+
+/* -------------------------------------------------------------------------- */
+int ZFPCompressor::compress
+  (Span input, Span output, gio::Type type, size_t type_size, size_t* n) {
+
+  size_t numel = getNumElements(n);
+
+  if (getZfpType(type) == zfp_type_none) {
+    std::cerr << "Compression failed: unsupported type " << gio::to_string(type) << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  Timer timer;
+  timer.start();
+
+  configure(type, n);
+  setExecution(true);
+  zfp_field_set_pointer(field, input.data);
+
+  // associate bit stream with caller buffer
+  bitstream *stream = stream_open(output.data, output.size);
   zfp_stream_set_bit_stream(zfp, stream);
   zfp_stream_rewind(zfp);
 
   // Compress
   size_t zfpsize = zfp_compress(zfp, field);
+  stream_close(stream);
+
   if (not zfpsize) {
     std::cerr << "Compression failed: " << zfpsize << std::endl;
     return EXIT_FAILURE;
   }
 
-  zfp_field_free(field);
-  zfp_stream_close(zfp);
-  stream_close(stream);
-
-  zfpCompressedSize = zfpsize;
   bytes = zfpsize;
   timer.stop();
 
@@ -140,94 +206,41 @@ int ZFPCompressor::compress
   log << " ~ InputBytes: " << type_size * numel;
   log << ", OutputBytes: " << bytes;
   log << ", cRatio: " << type_size * numel / static_cast<float>(bytes);
-  log << ", #elements: " << numel << std::endl;
+  log << ", #elements: " << numel << ", threads: " << threads << std::endl;
   log << name << " ~ CompressTime: " << timer.getDuration() << " s"<< std::endl;
   return EXIT_SUCCESS;
 }
 
 /* -------------------------------------------------------------------------- */
 int ZFPCompressor::decompress
-  (void *&input, void *&output, std::string data_type, size_t type_size, size_t* n) {
-
-  dims = 1;
-  size_t numel = n[0];
-  for (int i = 1; i < 5; i++)
-    if (n[i] != 0) {
-      numel *= n[i];
-      dims++;
-    }
+  (Span input, Span output, gio::Type type, size_t type_size, size_t* n) {
 
-  // Read in json compression parameters
-  double abs = 1E-3;
-  int rel = 32;
-  double rate = 1;
-
-  if (parameters.count("abs")) {
-    std::string value = parameters["abs"];
-    abs = std::stod(value);
-    zfp_mode_ = zfp_ABS;
-  } else if (parameters.count("rel")) {
-    std::string value = parameters["rel"];
-    rel = std::stoi(value);
-    zfp_mode_ = zfp_REL;
-  } else if (parameters.count("bits")) {
-    std::string value = parameters["bits"];
-    rate = std::stoi(value) / std::pow(4, dims);
-    assert(rate);
-    zfp_mode_ = zfp_BIT;
+  if (getZfpType(type) == zfp_type_none) {
+    std::cerr << "Decompression failed: unsupported type " << gio::to_string(type) << std::endl;
+    return EXIT_FAILURE;
   }
 
-
   Timer timer;
   timer.start();
 
-  zfp_type type = getZfpType(data_type);
-
-  // allocate meta data  array of decompressed data
-  output = std::malloc(numel * type_size);
-
-  zfp_field* field = nullptr;
-
-  switch (dims) {
-    case 1: field = zfp_field_1d(output, type, numel); break;
-    case 2: field = zfp_field_2d(output, type, n[1], n[0]); break;
-    case 3: field = zfp_field_3d(output, type, n[2], n[1], n[0]); break;
-    case 4: field = zfp_field_4d(output, type, n[3], n[2], n[1], n[0]); break;
-    default: break;
-  }
-
-  // allocate meta data for a compressed stream
-  zfp_stream* zfp = zfp_stream_open(nullptr);
-
-  // set absolute/relative error tolerance
-  switch (zfp_mode_) {
-    case zfp_ABS: zfp_stream_set_accuracy(zfp, abs); break;
-    case zfp_REL: zfp_stream_set_precision(zfp, rel); break;
-    case zfp_BIT: zfp_stream_set_rate(zfp, rate, type, dims, 0); break;
-    default: break;
-  }
-
-  // allocate buffer for decompressed data and transfer data
-  size_t bufsize = zfp_stream_maximum_size(zfp, field);
-  void *buffer = std::malloc(bufsize);
-  std::memcpy(buffer, input, zfpCompressedSize);
+  configure(type, n);
+  setExecution(false);
+  zfp_field_set_pointer(field, output.data);
 
-  // associate bit stream with allocated buffer
-  bitstream *stream = stream_open(buffer, zfpCompressedSize);
+  // read compressed data in place, no staging copy
+  bitstream *stream = stream_open(input.data, input.size);
   zfp_stream_set_bit_stream(zfp, stream);
   zfp_stream_rewind(zfp);
 
   // DeCompress
   size_t zfpsize = zfp_decompress(zfp, field);
+  stream_close(stream);
+
   if (not zfpsize) {
     std::cerr << "Decompression failed: " << zfpsize << std::endl;
     return EXIT_FAILURE;
   }
 
-  std::free(buffer);
-  zfp_field_free(field);
-  zfp_stream_close(zfp);
-  stream_close(stream);
   timer.stop();
 
   log << name << " ~ DecompressTime: " << timer.getDuration() << " s"<< std::endl;
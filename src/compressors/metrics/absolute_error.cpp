@@ -30,6 +30,7 @@
  */
 
 #include <cmath>
+#include <type_traits>
 #include <string>
 #include <sstream>
 #include <iostream>
@@ -37,18 +38,27 @@
 #include <algorithm>
 #include "compressors/metrics/absolute_error.h"
 /* -------------------------------------------------------------------------- */
-void absoluteError::execute(void* original, void* approx, size_t n) {
-  std::vector<double> error(n);
+void absoluteError::execute(void* original, void* approx, size_t n, gio::Type type) {
+  gio::dispatch(type, [&](auto* tag) {
+    using T = std::remove_pointer_t<decltype(tag)>;
+    compute(static_cast<T const*>(original), static_cast<T const*>(approx), n);
+  });
+}
 
+/* -------------------------------------------------------------------------- */
+template <typename T>
+void absoluteError::compute(T const* original, T const* approx, size_t n) {
   double local_sum_error = 0;
+  double local_max_error = 0;
 
+  #pragma omp parallel for simd reduction(+:local_sum_error) reduction(max:local_max_error)
   for (std::size_t i = 0; i < n; ++i) {
-    error[i] = std::abs(static_cast<float*>(original)[i] - static_cast<float*>(approx)[i]);
-    local_sum_error += error[i];
+    double const error = std::abs(double(original[i]) - double(approx[i]));
+    local_sum_error += error;
+    local_max_error = local_max_error < error ? error : local_max_error;
   }
 
   double total_max_error = 0;
-  double local_max_error = *std::max_element(error.begin(), error.end());
   local_val = local_max_error;
 
   MPI_Allreduce(&local_max_error, &total_max_error, 1, MPI_DOUBLE, MPI_MAX, comm);
@@ -71,41 +81,11 @@ void absoluteError::execute(void* original, void* approx, size_t n) {
   log << " Mean Abs Error: " << mean_error << std::endl;
 
   MPI_Barrier(comm);
-
-#if ENABLE_HISTOGRAM
-  if (parameters.count("histogram")) {
-    // Compute histogram of values
-    if (total_max_error != 0) {
-      std::vector<float> histogram;
-      int numBins = 1024;
-      std::vector<size_t> localHistogram(numBins, 0);
-      double binSize = total_max_error / numBins;
-
-      for (std::size_t i = 0; i < n; ++i) {
-        double err = std::abs(
-          static_cast<float*>(original)[i] - static_cast<float*>(approx)[i]
-        );
-
-        int binPos = static_cast<int>(err / binSize);
-        if (binPos >= numBins)
-          binPos = binPos - 1;
-        localHistogram[binPos]++;
-      }
-
-      histogram.resize(numBins);
-
-      std::vector<size_t> globalHistogram(numBins, 0);
-      MPI_Allreduce(&localHistogram[0], &globalHistogram[0],
-        numBins, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
-
-      auto total_size = static_cast<float>(global_n);
-      for (int i = 0; i < numBins; ++i)
-        histogram[i] = static_cast<float>(globalHistogram[i]) / total_size;
-
-      // Output histogram as a python script file
-      if (rank == 0)
-        additionalOutput = python_histogram(numBins, 0.0, total_max_error, histogram);
-    }
-  }
-#endif
 }
+
+/* -------------------------------------------------------------------------- */
+template void absoluteError::compute<float>(float const*, float const*, size_t);
+template void absoluteError::compute<double>(double const*, double const*, size_t);
+template void absoluteError::compute<int32_t>(int32_t const*, int32_t const*, size_t);
+template void absoluteError::compute<int64_t>(int64_t const*, int64_t const*, size_t);
+/* -------------------------------------------------------------------------- */
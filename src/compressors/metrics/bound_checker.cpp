@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cmath>
+#include <limits>
+#include <iostream>
+#include <algorithm>
+#include <type_traits>
+#include "compressors/metrics/bound_checker.h"
+/* -------------------------------------------------------------------------- */
+bool boundChecker::init(MPI_Comm _comm, std::unordered_map<std::string, std::string> const& params) {
+  comm = _comm;
+  MPI_Comm_rank(comm, &rank);
+
+  // same precedence as sz: the last one found wins
+  mode = None;
+  for (auto&& key : { "rel", "abs", "pw_rel" }) {
+    auto const found = params.find(key);
+    if (found != params.end() and not found->second.empty()) {
+      bound = std::stod(found->second);
+      mode = (found->first == "rel") ? Relative : (found->first == "abs") ? Absolute : PointWise;
+    }
+  }
+
+  count = 0;
+  max_error = sum_error = sum_squared = max_pointwise = 0.;
+  lowest = std::numeric_limits<double>::max();
+  highest = std::numeric_limits<double>::lowest();
+  valid = true;
+  log.str("");
+  return mode != None;
+}
+
+/* -------------------------------------------------------------------------- */
+bool boundChecker::check(void const* original, void const* approx, size_t n, gio::Type type, size_t first) {
+  return gio::dispatch(type, [&](auto* tag) {
+    using T = std::remove_pointer_t<decltype(tag)>;
+    return compute(static_cast<T const*>(original), static_cast<T const*>(approx), n, first);
+  });
+}
+
+/* -------------------------------------------------------------------------- */
+template <typename T>
+bool boundChecker::compute(T const* original, T const* approx, size_t n, size_t first) {
+
+  // the value range is only known at the end for 'rel'
+  double const limit = (mode == Absolute) ? bound : std::numeric_limits<double>::infinity();
+  double const ratio = (mode == PointWise) ? bound : 0.;
+  bool const pointwise = (mode == PointWise);
+
+  double local_max = max_error;
+  double local_sum = 0.;
+  double local_squared = 0.;
+  double local_pointwise = max_pointwise;
+  double local_lowest = lowest;
+  double local_highest = highest;
+  long faulty = static_cast<long>(n);
+
+  #pragma omp parallel for schedule(static) \
+    reduction(max:local_max, local_pointwise, local_highest) \
+    reduction(min:local_lowest, faulty) reduction(+:local_sum, local_squared)
+  for (long i = 0; i < long(n); ++i) {
+    double const x = double(original[i]);
+    double const y = double(approx[i]);
+    bool const same = (x == y) or (x != x and y != y);
+    double const error = same ? 0. : std::abs(x - y);
+    double const magnitude = std::abs(x);
+
+    // a non-finite error always fails the comparisons
+    if (not (error <= (pointwise ? ratio * magnitude : limit)))
+      faulty = std::min(faulty, i);
+
+    if (std::isfinite(error)) {
+      local_max = std::max(local_max, error);
+      local_sum += error;
+      local_squared += error * error;
+      if (magnitude > 0.)
+        local_pointwise = std::max(local_pointwise, error / magnitude);
+    }
+
+    if (std::isfinite(x)) {
+      local_lowest = std::min(local_lowest, x);
+      local_highest = std::max(local_highest, x);
+    }
+  }
+
+  count += n;
+  max_error = local_max;
+  sum_error += local_sum;
+  sum_squared += local_squared;
+  max_pointwise = local_pointwise;
+  lowest = local_lowest;
+  highest = local_highest;
+
+  if (faulty < long(n)) {
+    double const x = double(original[faulty]);
+    double const error = std::abs(x - double(approx[faulty]));
+    std::cerr << "Bound violation on rank " << rank << " at value " << first + faulty;
+    std::cerr << ": error " << error << " exceeds " << (pointwise ? ratio * std::abs(x) : limit);
+    std::cerr << std::endl;
+    valid = false;
+  }
+  return valid;
+}
+
+/* -------------------------------------------------------------------------- */
+bool boundChecker::finalize() {
+
+  double local_max[] = { max_error, max_pointwise, highest, -lowest };
+  double local_sum[] = { sum_error, sum_squared, static_cast<double>(count) };
+  double total_max[4];
+  double total_sum[3];
+  int local_valid = valid ? 1 : 0;
+  int total_valid = 0;
+
+  MPI_Allreduce(local_max, total_max, 4, MPI_DOUBLE, MPI_MAX, comm);
+  MPI_Allreduce(local_sum, total_sum, 3, MPI_DOUBLE, MPI_SUM, comm);
+  MPI_Allreduce(&local_valid, &total_valid, 1, MPI_INT, MPI_MIN, comm);
+
+  double const range = total_max[2] + total_max[3];
+  if (mode == Relative and total_max[0] > bound * range) {
+    if (rank == 0) {
+      std::cerr << "Bound violation: max error " << total_max[0];
+      std::cerr << " exceeds " << bound * range << std::endl;
+    }
+    total_valid = 0;
+  }
+
+  char const* names[] = { "none", "abs", "rel", "pw_rel" };
+  double const numel = std::max(1., total_sum[2]);
+
+  log << "-Bound Check (" << names[mode] << " " << bound << "): ";
+  log << (total_valid ? "passed" : "failed") << std::endl;
+  log << " Max Abs Error: " << total_max[0] << std::endl;
+  log << " Mean Abs Error: " << total_sum[0] / numel << std::endl;
+  log << " Mean Square Error: " << total_sum[1] / numel << std::endl;
+  log << " Max Pw Rel Error: " << total_max[1] << std::endl;
+
+  valid = (total_valid == 1);
+  return valid;
+}
+
+/* -------------------------------------------------------------------------- */
+template bool boundChecker::compute<float>(float const*, float const*, size_t, size_t);
+template bool boundChecker::compute<double>(double const*, double const*, size_t, size_t);
+template bool boundChecker::compute<int32_t>(int32_t const*, int32_t const*, size_t, size_t);
+template bool boundChecker::compute<int64_t>(int64_t const*, int64_t const*, size_t, size_t);
+/* -------------------------------------------------------------------------- */
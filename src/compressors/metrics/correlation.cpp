@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cmath>
+#include <type_traits>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include "compressors/metrics/correlation.h"
+/* -------------------------------------------------------------------------- */
+void correlationMetric::execute(void* original, void* approx, size_t n, gio::Type type) {
+  gio::dispatch(type, [&](auto* tag) {
+    using T = std::remove_pointer_t<decltype(tag)>;
+    compute(static_cast<T const*>(original), static_cast<T const*>(approx), n);
+  });
+}
+
+/* -------------------------------------------------------------------------- */
+// keep particles of the x-slab of this rank first, then copies of those of
+// other slabs closer than the margin to it.
+size_t correlationMetric::distribute(std::vector<double>& particles, double margin) const {
+
+  double const width = box / nb_ranks;
+  int const reach = std::min(nb_ranks - 1, static_cast<int>(std::ceil(margin / width)));
+
+  auto const wrap = [&](double x) { return x - box * std::floor(x / box); };
+  auto const owner = [&](double x) { return std::min(nb_ranks - 1, static_cast<int>(wrap(x) / width)); };
+  auto const distance = [&](double x, int s) {
+    double delta = std::abs(wrap(x) - (s + 0.5) * width);
+    delta = std::min(delta, box - delta);
+    return std::max(0., delta - 0.5 * width);
+  };
+
+  size_t const total = particles.size() / 6;
+  std::vector<std::pair<int, size_t>> owners(total);
+  std::vector<std::pair<int, size_t>> ghosts;
+  std::vector<int> targets;
+
+  for (size_t k = 0; k < total; ++k) {
+    double const x = particles[6 * k];
+    int const r = owner(x);
+    owners[k] = {r, k};
+
+    // slabs on both sides, each one once on small rings
+    targets.clear();
+    for (int offset = 1; offset <= reach; ++offset) {
+      for (int s : {(r + offset) % nb_ranks, (r - offset + nb_ranks) % nb_ranks}) {
+        if (s != r and std::count(targets.begin(), targets.end(), s) == 0 and distance(x, s) < margin) {
+          targets.push_back(s);
+          ghosts.emplace_back(s, k);
+        }
+      }
+    }
+  }
+
+  auto const exchange = [&](std::vector<std::pair<int, size_t>>& moves) {
+    std::vector<int> send_counts(nb_ranks, 0);
+    std::vector<int> recv_counts(nb_ranks, 0);
+    std::vector<int> send_offsets(nb_ranks, 0);
+    std::vector<int> recv_offsets(nb_ranks, 0);
+    std::vector<double> sent;
+    sent.reserve(6 * moves.size());
+
+    std::sort(moves.begin(), moves.end());
+    for (auto&& move : moves) {
+      auto const first = particles.begin() + 6 * move.second;
+      sent.insert(sent.end(), first, first + 6);
+      send_counts[move.first] += 6;
+    }
+
+    MPI_Alltoall(send_counts.data(), 1, MPI_INT, recv_counts.data(), 1, MPI_INT, comm);
+    for (int r = 1; r < nb_ranks; ++r) {
+      send_offsets[r] = send_offsets[r - 1] + send_counts[r - 1];
+      recv_offsets[r] = recv_offsets[r - 1] + recv_counts[r - 1];
+    }
+
+    std::vector<double> received(recv_offsets.back() + recv_counts.back());
+    MPI_Alltoallv(sent.data(), send_counts.data(), send_offsets.data(), MPI_DOUBLE,
+                  received.data(), recv_counts.data(), recv_offsets.data(), MPI_DOUBLE, comm);
+    return received;
+  };
+
+  auto const copies = exchange(ghosts);
+  particles = exchange(owners);
+  size_t const owned = particles.size() / 6;
+  particles.insert(particles.end(), copies.begin(), copies.end());
+  return owned;
+}
+
+/* -------------------------------------------------------------------------- */
+// ordered pairs of owned particles with any other one, using the original
+// or the decompressed position of each particle depending on 'set'.
+void correlationMetric::countPairs(std::vector<double> const& particles, size_t owned,
+                                   int set, std::vector<unsigned long>& pairs) const {
+
+  size_t const total = particles.size() / 6;
+
+  // cells are at least as wide as the largest separation
+  long const cells = std::max(1L, std::min(128L, static_cast<long>(box / r_max)));
+  double const size = box / cells;
+  auto const wrap = [&](long c) { c %= cells; return c < 0 ? c + cells : c; };
+  auto const cell = [&](double x) { return wrap(static_cast<long>(std::floor(x / size))); };
+
+  // sort particles by cell
+  std::vector<size_t> start(cells * cells * cells + 1, 0);
+  std::vector<size_t> sorted(total);
+  std::vector<long> indices(total);
+
+  for (size_t k = 0; k < total; ++k) {
+    double const* p = particles.data() + 6 * k + set;
+    indices[k] = (cell(p[0]) * cells + cell(p[1])) * cells + cell(p[2]);
+    start[indices[k] + 1]++;
+  }
+
+  std::partial_sum(start.begin(), start.end(), start.begin());
+  {
+    std::vector<size_t> cursor(start.begin(), start.end() - 1);
+    for (size_t k = 0; k < total; ++k)
+      sorted[cursor[indices[k]]++] = k;
+  }
+
+  // neighbor cells, without duplicates on small grids
+  std::vector<long> const shifts = cells >= 3 ? std::vector<long>{-1, 0, 1}
+                                 : cells == 2 ? std::vector<long>{0, 1}
+                                 :              std::vector<long>{0};
+
+  double const r_min2 = r_min * r_min;
+  double const r_max2 = r_max * r_max;
+  double const scale = nb_bins / std::log(r_max / r_min);
+  int const last = nb_bins - 1;
+  unsigned long* const bins = pairs.data();
+
+  #pragma omp parallel for schedule(dynamic, 256) reduction(+: bins[:nb_bins])
+  for (size_t i = 0; i < owned; ++i) {
+    double const* p = particles.data() + 6 * i + set;
+    long const c[] = { cell(p[0]), cell(p[1]), cell(p[2]) };
+
+    for (long dx : shifts) {
+      for (long dy : shifts) {
+        for (long dz : shifts) {
+          long const neighbor = (wrap(c[0] + dx) * cells + wrap(c[1] + dy)) * cells + wrap(c[2] + dz);
+
+          for (size_t s = start[neighbor]; s < start[neighbor + 1]; ++s) {
+            size_t const j = sorted[s];
+            if (j == i)
+              continue;
+
+            // minimum image
+            double const* q = particles.data() + 6 * j + set;
+            double r2 = 0.;
+            for (int d = 0; d < 3; ++d) {
+              double delta = p[d] - q[d];
+              delta -= box * std::round(delta / box);
+              r2 += delta * delta;
+            }
+
+            if (r2 >= r_min2 and r2 < r_max2)
+              bins[std::min(last, static_cast<int>(0.5 * std::log(r2 / r_min2) * scale))]++;
+          }
+        }
+      }
+    }
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+template <typename T>
+void correlationMetric::compute(T const* original, T const* approx, size_t n) {
+
+  size_t const components = parameters.count("components") ? std::stoul(parameters["components"]) : 1;
+  bool const interleave = parameters.count("interleave") and parameters["interleave"] == "1";
+
+  if (components != 3) {
+    log << "-Correlation: skipped, needs a joint x+y+z field" << std::endl;
+    local_val = total_val = std::numeric_limits<double>::quiet_NaN();
+    return;
+  }
+
+  size_t const count = n / 3;
+  double const sampling = parameters.count("sampling") ? std::stod(parameters["sampling"]) : 1.;
+  unsigned const seed = parameters.count("seed") ? std::stoul(parameters["seed"]) : 0;
+  nb_bins = parameters.count("bins") ? std::stoi(parameters["bins"]) : 16;
+
+  // step 1: pack sampled particles, both positions side by side
+  auto const at = [&](T const* data, size_t i, int d) {
+    return static_cast<double>(interleave ? data[3 * i + d] : data[d * count + i]);
+  };
+
+  std::mt19937 generator(seed + rank);
+  std::bernoulli_distribution keep(std::min(std::max(sampling, 0.), 1.));
+  bool const sampled = sampling > 0. and sampling < 1.;
+
+  std::vector<double> particles;
+  particles.reserve(6 * count);
+  double local_bounds[] = {0., 0.};    // extent, displacement
+
+  for (size_t i = 0; i < count; ++i) {
+    if (sampled and not keep(generator))
+      continue;
+
+    for (int d = 0; d < 3; ++d) {
+      particles.push_back(at(original, i, d));
+      local_bounds[0] = std::max(local_bounds[0], particles.back());
+    }
+    for (int d = 0; d < 3; ++d) {
+      particles.push_back(at(approx, i, d));
+      local_bounds[1] = std::max(local_bounds[1], std::abs(particles.back() - particles[particles.size() - 4]));
+    }
+  }
+
+  double bounds[] = {0., 0.};
+  MPI_Allreduce(local_bounds, bounds, 2, MPI_DOUBLE, MPI_MAX, comm);
+
+  // the box is that of the input, run.cpp passes it down, or else the
+  // extent of positions
+  box = parameters.count("box") ? std::stod(parameters["box"]) : bounds[0];
+  r_max = parameters.count("r_max") ? std::stod(parameters["r_max"]) : box / 32;
+  r_max = std::min(r_max, 0.5 * box);
+  r_min = parameters.count("r_min") ? std::stod(parameters["r_min"]) : r_max / 64;
+
+  // step 2: pairs of a decompressed particle may be up to twice the
+  // largest displacement further in the original positions.
+  size_t const owned = distribute(particles, r_max + 2. * bounds[1]);
+
+  // step 3: count pairs of both sets
+  std::vector<unsigned long> pairs[] = {
+    std::vector<unsigned long>(nb_bins, 0), std::vector<unsigned long>(nb_bins, 0)
+  };
+  countPairs(particles, owned, 0, pairs[0]);
+  countPairs(particles, owned, 3, pairs[1]);
+
+  std::vector<unsigned long> totals(2 * nb_bins + 1, 0);
+  std::copy(pairs[0].begin(), pairs[0].end(), totals.begin());
+  std::copy(pairs[1].begin(), pairs[1].end(), totals.begin() + nb_bins);
+  totals.back() = owned;
+  MPI_Allreduce(MPI_IN_PLACE, totals.data(), totals.size(), MPI_UNSIGNED_LONG, MPI_SUM, comm);
+
+  // step 4: ξ = DD / RR - 1, with RR exact in a periodic box
+  double const nb_particles = totals.back();
+  double const density = nb_particles * (nb_particles - 1.) / std::pow(box, 3);
+  double const step = std::log(r_max / r_min) / nb_bins;
+  double deviation = 0.;
+  std::stringstream output;
+  output << "# r xi xi_zip pairs pairs_zip" << std::endl;
+
+  for (int b = 0; b < nb_bins; ++b) {
+    double const lower = r_min * std::exp(b * step);
+    double const upper = r_min * std::exp((b + 1) * step);
+    double const expected = density * 4. / 3. * M_PI * (std::pow(upper, 3) - std::pow(lower, 3));
+    double const reference = totals[b];
+    double const current = totals[nb_bins + b];
+
+    if (reference > 0.)
+      deviation = std::max(deviation, std::abs(current / reference - 1.));
+
+    output << std::sqrt(lower * upper) << " " << reference / expected - 1. << " ";
+    output << current / expected - 1. << " " << reference << " " << current << std::endl;
+  }
+
+  log << "-Correlation: max |DD_zip/DD - 1|: " << deviation << " over " << nb_bins;
+  log << " bins in [" << r_min << ", " << r_max << "[" << std::endl;
+
+  if (rank == 0)
+    additionalOutput = output.str();
+
+  local_val = deviation;
+  total_val = deviation;
+}
+
+/* -------------------------------------------------------------------------- */
+template void correlationMetric::compute<float>(float const*, float const*, size_t);
+template void correlationMetric::compute<double>(double const*, double const*, size_t);
+template void correlationMetric::compute<int32_t>(int32_t const*, int32_t const*, size_t);
+template void correlationMetric::compute<int64_t>(int64_t const*, int64_t const*, size_t);
+/* -------------------------------------------------------------------------- */
@@ -30,16 +30,28 @@
  */
 
 #include <cmath>
+#include <type_traits>
 #include <string>
 #include <sstream>
 #include "compressors/metrics/mean_square_error.h"
 /* -------------------------------------------------------------------------- */
-void meanSquareError::execute(void *original, void *approx, size_t n) {
+void meanSquareError::execute(void* original, void* approx, size_t n, gio::Type type) {
+  gio::dispatch(type, [&](auto* tag) {
+    using T = std::remove_pointer_t<decltype(tag)>;
+    compute(static_cast<T const*>(original), static_cast<T const*>(approx), n);
+  });
+}
+
+/* -------------------------------------------------------------------------- */
+template <typename T>
+void meanSquareError::compute(T const* original, T const* approx, size_t n) {
 
   double mean_square_error = 0;
+
+  #pragma omp parallel for simd reduction(+:mean_square_error)
   for (std::size_t i = 0; i < n; ++i) {
-    auto diff = static_cast<float*>(original)[i] - static_cast<float*>(approx)[i];
-    mean_square_error += std::pow(diff, 2.0);
+    double const diff = double(original[i]) - double(approx[i]);
+    mean_square_error += diff * diff;
   }
 
   double local_mse = mean_square_error / n;
@@ -56,4 +68,10 @@ void meanSquareError::execute(void *original, void *approx, size_t n) {
 
   MPI_Barrier(comm);
 }
+
+/* -------------------------------------------------------------------------- */
+template void meanSquareError::compute<float>(float const*, float const*, size_t);
+template void meanSquareError::compute<double>(double const*, double const*, size_t);
+template void meanSquareError::compute<int32_t>(int32_t const*, int32_t const*, size_t);
+template void meanSquareError::compute<int64_t>(int64_t const*, int64_t const*, size_t);
 /* -------------------------------------------------------------------------- */
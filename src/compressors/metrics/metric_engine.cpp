@@ -0,0 +1,389 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <type_traits>
+#include "compressors/metrics/metric_engine.h"
+/* -------------------------------------------------------------------------- */
+static constexpr int nb_fields = sizeof(metricEngine::Statistics) / sizeof(double);
+static_assert(sizeof(metricEngine::Statistics) == nb_fields * sizeof(double), "padded record");
+
+/* -------------------------------------------------------------------------- */
+void metricEngine::init(MPI_Comm _comm) {
+  close();
+  comm = _comm;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Type_contiguous(nb_fields, MPI_DOUBLE, &record);
+  MPI_Type_commit(&record);
+  MPI_Op_create(&metricEngine::combine, 1, &reduce);
+}
+
+/* -------------------------------------------------------------------------- */
+void metricEngine::close() {
+  if (reduce != MPI_OP_NULL)
+    MPI_Op_free(&reduce);
+  if (record != MPI_DATATYPE_NULL)
+    MPI_Type_free(&record);
+}
+
+/* -------------------------------------------------------------------------- */
+bool metricEngine::supports(std::string const& metric) {
+  return metric == "absolute_error" or metric == "relative_error"
+      or metric == "mean_square_error" or metric == "psnr" or metric == "min_max";
+}
+
+/* -------------------------------------------------------------------------- */
+void metricEngine::combine(void* in, void* inout, int* len, MPI_Datatype* type) {
+  auto const* source = static_cast<Statistics const*>(in);
+  auto* target = static_cast<Statistics*>(inout);
+
+  for (int i = 0; i < *len; ++i) {
+    target[i].count       += source[i].count;
+    target[i].max_abs      = std::max(target[i].max_abs, source[i].max_abs);
+    target[i].sum_abs     += source[i].sum_abs;
+    target[i].sum_squared += source[i].sum_squared;
+    target[i].max_rel      = std::max(target[i].max_rel, source[i].max_rel);
+    target[i].sum_rel     += source[i].sum_rel;
+    target[i].lowest       = std::min(target[i].lowest, source[i].lowest);
+    target[i].highest      = std::max(target[i].highest, source[i].highest);
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+void metricEngine::begin() {
+  for (auto&& histogram : histograms)
+    histogram.clear();
+
+  local = Statistics();
+  local.lowest = std::numeric_limits<double>::max();
+  local.highest = std::numeric_limits<double>::lowest();
+  sum_abs = sum_squared = sum_rel = KahanSum();
+}
+
+/* -------------------------------------------------------------------------- */
+void metricEngine::accumulate(void const* original, void const* approx, size_t n, gio::Type type) {
+  gio::dispatch(type, [&](auto* tag) {
+    using T = std::remove_pointer_t<decltype(tag)>;
+    compute(static_cast<T const*>(original), static_cast<T const*>(approx), n);
+  });
+}
+
+/* -------------------------------------------------------------------------- */
+void metricEngine::finalize() {
+  local.sum_abs = sum_abs.value();
+  local.sum_squared = sum_squared.value();
+  local.sum_rel = sum_rel.value();
+  MPI_Allreduce(&local, &global, 1, record, reduce, comm);
+  reduceHistograms(false);
+}
+
+/* -------------------------------------------------------------------------- */
+void metricEngine::addHistogram(
+  Distribution which, size_t nb_bins, Histogram::Scale scale, double lower, double upper) {
+
+  auto& request = requests[which];
+  request.active = true;
+  request.deferred = not (lower < upper);
+  request.nb_bins = nb_bins;
+  request.scale = scale;
+  histograms[which] = Histogram(nb_bins, lower, upper, scale);
+}
+
+/* -------------------------------------------------------------------------- */
+bool metricEngine::hasDeferredHistogram() const {
+  for (auto&& request : requests)
+    if (request.active and request.deferred)
+      return true;
+  return false;
+}
+
+/* -------------------------------------------------------------------------- */
+Histogram const* metricEngine::getHistogram(Distribution which) const {
+  return requests[which].active ? &histograms[which] : nullptr;
+}
+
+/* -------------------------------------------------------------------------- */
+void metricEngine::complete(void const* original, void const* approx, size_t n, gio::Type type) {
+
+  if (not hasDeferredHistogram())
+    return;
+
+  // ranges are known now that all ranks are reduced
+  double const lower[] = { 0., 0., global.lowest };
+  double const upper[] = { global.max_abs, global.max_rel, global.highest };
+
+  for (int d = 0; d < nb_distributions; ++d) {
+    auto const& request = requests[d];
+    if (request.active and request.deferred) {
+      // log bins span twelve decades below the largest value
+      double const start = request.scale == Histogram::Log ? std::max(lower[d], upper[d] * 1E-12) : lower[d];
+      histograms[d] = Histogram(request.nb_bins, start, upper[d], request.scale);
+    }
+  }
+
+  gio::dispatch(type, [&](auto* tag) {
+    using T = std::remove_pointer_t<decltype(tag)>;
+    fill(static_cast<T const*>(original), static_cast<T const*>(approx), n, true);
+  });
+
+  reduceHistograms(true);
+}
+
+/* -------------------------------------------------------------------------- */
+void metricEngine::reduceHistograms(bool deferred) {
+
+  // counts of all histograms are reduced at once
+  std::vector<uint64_t> packed;
+  for (int d = 0; d < nb_distributions; ++d) {
+    if (requests[d].active and requests[d].deferred == deferred) {
+      auto const& counts = histograms[d].getCounts();
+      packed.insert(packed.end(), counts.begin(), counts.end());
+    }
+  }
+
+  if (packed.empty())
+    return;
+
+  MPI_Allreduce(MPI_IN_PLACE, packed.data(), packed.size(), MPI_UINT64_T, MPI_SUM, comm);
+
+  size_t offset = 0;
+  for (int d = 0; d < nb_distributions; ++d) {
+    if (requests[d].active and requests[d].deferred == deferred) {
+      auto& counts = histograms[d].getCounts();
+      std::copy(packed.begin() + offset, packed.begin() + offset + counts.size(), counts.begin());
+      offset += counts.size();
+    }
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+void metricEngine::execute(void const* original, void const* approx, size_t n, gio::Type type) {
+  begin();
+  accumulate(original, approx, n, type);
+  finalize();
+}
+
+/* -------------------------------------------------------------------------- */
+template <typename T>
+void metricEngine::compute(T const* original, T const* approx, size_t n) {
+
+  // blocks are short enough for their sums to stay accurate in double,
+  // block sums are then added with compensation.
+  size_t const nb_blocks = (n + block - 1) / block;
+
+  double max_abs = local.max_abs;
+  double max_rel = local.max_rel;
+  double lowest = local.lowest;
+  double highest = local.highest;
+
+  // histograms with a known range are filled block by block, while hot
+  bool binned[nb_distributions];
+  bool any_binned = false;
+  for (int d = 0; d < nb_distributions; ++d) {
+    binned[d] = requests[d].active and not requests[d].deferred;
+    any_binned |= binned[d];
+  }
+
+  #pragma omp parallel reduction(max:max_abs, max_rel, highest) reduction(min:lowest)
+  {
+    KahanSum thread_abs, thread_squared, thread_rel;
+    std::vector<uint64_t> bins[nb_distributions];
+    for (int d = 0; d < nb_distributions; ++d)
+      if (binned[d])
+        bins[d].assign(histograms[d].size(), 0);
+
+    #pragma omp for schedule(static)
+    for (size_t b = 0; b < nb_blocks; ++b) {
+      size_t const first = b * block;
+      size_t const last = std::min(first + block, n);
+      double block_abs = 0.;
+      double block_squared = 0.;
+      double block_rel = 0.;
+
+      // narrow types are widened on load, all accumulations are in double
+      #pragma omp simd reduction(+:block_abs, block_squared, block_rel) \
+                       reduction(max:max_abs, max_rel, highest) reduction(min:lowest)
+      for (size_t i = first; i < last; ++i) {
+        double const value = original[i];
+        double const error = std::abs(value - double(approx[i]));
+        double const magnitude = std::abs(value);
+        // relative to the value, except for values below one
+        double const relative = magnitude < 1. ? error : error / magnitude;
+
+        block_abs += error;
+        block_squared += error * error;
+        block_rel += relative;
+        max_abs = max_abs < error ? error : max_abs;
+        max_rel = max_rel < relative ? relative : max_rel;
+        lowest = value < lowest ? value : lowest;
+        highest = highest < value ? value : highest;
+      }
+
+      thread_abs.add(block_abs);
+      thread_squared.add(block_squared);
+      thread_rel.add(block_rel);
+
+      if (any_binned)
+        bin(original, approx, first, last, binned, bins);
+    }
+
+    #pragma omp critical
+    {
+      sum_abs.add(thread_abs);
+      sum_squared.add(thread_squared);
+      sum_rel.add(thread_rel);
+      for (int d = 0; d < nb_distributions; ++d)
+        if (binned[d])
+          histograms[d].merge(bins[d].data());
+    }
+  }
+
+  local.count += n;
+  local.max_abs = max_abs;
+  local.max_rel = max_rel;
+  local.lowest = lowest;
+  local.highest = highest;
+}
+
+/* -------------------------------------------------------------------------- */
+template <typename T>
+void metricEngine::bin(T const* original, T const* approx, size_t first, size_t last,
+                       bool const* binned, std::vector<uint64_t>* bins) const {
+
+  for (size_t i = first; i < last; ++i) {
+    double const value = original[i];
+    double const decoded = approx[i];
+    double const error = std::abs(value - decoded);
+    double const magnitude = std::abs(value);
+
+    if (binned[Error])
+      bins[Error][histograms[Error].getBin(error)]++;
+    if (binned[RelativeError])
+      bins[RelativeError][histograms[RelativeError].getBin(magnitude < 1. ? error : error / magnitude)]++;
+    if (binned[Value])
+      bins[Value][histograms[Value].getBin(decoded)]++;
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+template <typename T>
+void metricEngine::fill(T const* original, T const* approx, size_t n, bool deferred) {
+
+  bool binned[nb_distributions];
+  for (int d = 0; d < nb_distributions; ++d)
+    binned[d] = requests[d].active and requests[d].deferred == deferred;
+
+  #pragma omp parallel
+  {
+    // thread-private bins, merged once
+    std::vector<uint64_t> bins[nb_distributions];
+    for (int d = 0; d < nb_distributions; ++d)
+      if (binned[d])
+        bins[d].assign(histograms[d].size(), 0);
+
+    size_t const nb_blocks = (n + block - 1) / block;
+
+    #pragma omp for schedule(static) nowait
+    for (size_t b = 0; b < nb_blocks; ++b)
+      bin(original, approx, b * block, std::min(b * block + block, n), binned, bins);
+
+    #pragma omp critical
+    {
+      for (int d = 0; d < nb_distributions; ++d)
+        if (binned[d])
+          histograms[d].merge(bins[d].data());
+    }
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+double metricEngine::getValue(std::string const& metric, Statistics const& stats) {
+  double const mse = stats.sum_squared / stats.count;
+
+  if (metric == "absolute_error")
+    return stats.max_abs;
+  if (metric == "relative_error")
+    return stats.max_rel;
+  if (metric == "mean_square_error")
+    return mse;
+  if (metric == "psnr")
+    return 10 * std::log10(stats.highest * stats.highest / mse);
+  if (metric == "min_max")
+    return stats.highest;
+  return 0.;
+}
+
+/* -------------------------------------------------------------------------- */
+double metricEngine::getLocalValue(std::string const& metric) const {
+  return getValue(metric, local);
+}
+
+/* -------------------------------------------------------------------------- */
+double metricEngine::getGlobalValue(std::string const& metric) const {
+  return getValue(metric, global);
+}
+
+/* -------------------------------------------------------------------------- */
+std::string metricEngine::getLog(std::string const& metric) const {
+  std::stringstream log;
+
+  if (metric == "absolute_error") {
+    log << "-Max Abs Error: " << global.max_abs << std::endl;
+    log << " Total Abs Error: " << global.sum_abs << std::endl;
+    log << " Mean Abs Error: " << global.sum_abs / global.count << std::endl;
+  } else if (metric == "relative_error") {
+    log << "-Max Rel Error: " << global.max_rel << std::endl;
+    log << " Total Rel Error: " << global.sum_rel << std::endl;
+    log << " Mean Rel Error: " << global.sum_rel / global.count << std::endl;
+  } else if (metric == "mean_square_error") {
+    log << "- mean_square_error: " << getGlobalValue(metric) << std::endl;
+  } else if (metric == "psnr") {
+    log << " local_psnr: " << getLocalValue(metric) << std::endl;
+    log << "- psnr: " << getGlobalValue(metric) << std::endl;
+  } else if (metric == "min_max") {
+    log << " local_minmax: " << local.lowest << " " << local.highest << std::endl;
+    log << "- min, max: (" << global.lowest << ", " << global.highest << ")" << std::endl;
+  }
+  return log.str();
+}
+
+/* -------------------------------------------------------------------------- */
+template void metricEngine::compute<float>(float const*, float const*, size_t);
+template void metricEngine::compute<double>(double const*, double const*, size_t);
+template void metricEngine::compute<int32_t>(int32_t const*, int32_t const*, size_t);
+template void metricEngine::compute<int64_t>(int64_t const*, int64_t const*, size_t);
+template void metricEngine::fill<float>(float const*, float const*, size_t, bool);
+template void metricEngine::fill<double>(double const*, double const*, size_t, bool);
+template void metricEngine::fill<int32_t>(int32_t const*, int32_t const*, size_t, bool);
+template void metricEngine::fill<int64_t>(int64_t const*, int64_t const*, size_t, bool);
+/* -------------------------------------------------------------------------- */
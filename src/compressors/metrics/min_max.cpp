@@ -30,20 +30,32 @@
  */
 
 #include <cmath>
+#include <type_traits>
 #include <string>
 #include <sstream>
 #include "compressors/metrics/min_max.h"
 /* -------------------------------------------------------------------------- */
-void minmaxMetric::execute(void *original, void *approx, size_t n) {
+void minmaxMetric::execute(void* original, void* approx, size_t n, gio::Type type) {
+  gio::dispatch(type, [&](auto* tag) {
+    using T = std::remove_pointer_t<decltype(tag)>;
+    compute(static_cast<T const*>(original), static_cast<T const*>(approx), n);
+  });
+}
+
+/* -------------------------------------------------------------------------- */
+template <typename T>
+void minmaxMetric::compute(T const* original, T const* approx, size_t n) {
 
-  auto* raw_data = static_cast<float*>(original);
+  auto* raw_data = original;
 
   double local_max = -99999999999;
   double local_min = 99999999999;
 
+  #pragma omp parallel for simd reduction(max:local_max) reduction(min:local_min)
   for (std::size_t i = 0; i < n; ++i) {
-    if (raw_data[i] > local_max) local_max = raw_data[i];
-    if (raw_data[i] < local_min) local_min = raw_data[i];
+    double const value = raw_data[i];
+    local_max = local_max < value ? value : local_max;
+    local_min = value < local_min ? value : local_min;
   }
 
   double global_max = 0;
@@ -59,44 +71,11 @@ void minmaxMetric::execute(void *original, void *approx, size_t n) {
   // Just report max for now
   local_val = local_max;
   total_val = global_max;
-
-#if ENABLE_HISTOGRAM
-  auto* zip_data = static_cast<float*>(approx);
-
-  if (parameters.count("histogram")) {
-    // Compute histogram of values
-    if (global_max != 0) {
-      std::vector<float> histogram;
-      int numBins = 1024;
-      std::vector<size_t> localHistogram(numBins, 0);
-      double binSize = (global_max - global_min) / numBins;
-
-      for (std::size_t i = 0; i < n; ++i) {
-        // Retrieve the "approximated" value
-        // Lossless comp: Original data
-        // Lossy comp: Approx data
-        double const range = global_max - global_min;
-        double const value = range * ((zip_data[i] - global_min) / range);
-        int binPos = static_cast<int>(value / binSize);
-        if (binPos >= numBins)
-          binPos = binPos - 1;
-
-        localHistogram[binPos]++;
-      }
-
-      histogram.resize(numBins);
-
-      std::vector<size_t> globalHistogram(numBins, 0);
-      MPI_Allreduce(&localHistogram[0], &globalHistogram[0], numBins,
-        MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
-
-      for (int i = 0; i < numBins; ++i)
-        histogram[i] = (float) globalHistogram[i];
-
-      // Output histogram as a python script file
-      if (rank == 0)
-        additionalOutput = python_histogram(numBins, global_min, global_max, histogram);
-    }
-  }
-#endif
 }
+
+/* -------------------------------------------------------------------------- */
+template void minmaxMetric::compute<float>(float const*, float const*, size_t);
+template void minmaxMetric::compute<double>(double const*, double const*, size_t);
+template void minmaxMetric::compute<int32_t>(int32_t const*, int32_t const*, size_t);
+template void minmaxMetric::compute<int64_t>(int64_t const*, int64_t const*, size_t);
+/* -------------------------------------------------------------------------- */
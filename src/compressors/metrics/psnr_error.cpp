@@ -30,23 +30,35 @@
  */
 
 #include <cmath>
+#include <type_traits>
 #include <string>
 #include <sstream>
 #include "compressors/metrics/psnr_error.h"
 /* -------------------------------------------------------------------------- */
 
-inline void psnrError::execute(void *original, void *approx, size_t n) {
+void psnrError::execute(void* original, void* approx, size_t n, gio::Type type) {
+  gio::dispatch(type, [&](auto* tag) {
+    using T = std::remove_pointer_t<decltype(tag)>;
+    compute(static_cast<T const*>(original), static_cast<T const*>(approx), n);
+  });
+}
+
+/* -------------------------------------------------------------------------- */
+template <typename T>
+void psnrError::compute(T const* original, T const* approx, size_t n) {
 
-  auto* raw_data = static_cast<float*>(original);
-  auto* zip_data = static_cast<float*>(approx);
+  auto* raw_data = original;
+  auto* zip_data = approx;
 
   double local_max = -999999999;
   double local_mse = 0;
+
+  #pragma omp parallel for simd reduction(max:local_max) reduction(+:local_mse)
   for (std::size_t i = 0; i < n; ++i) {
-    if (raw_data[i] > local_max) {
-      local_max = raw_data[i]; // implicit cast
-    }
-    local_mse += std::pow(raw_data[i] - zip_data[i], 2.);
+    double const value = raw_data[i];
+    double const diff = value - double(zip_data[i]);
+    local_max = local_max < value ? value : local_max;
+    local_mse += diff * diff;
   }
 
   // Local quantity
@@ -70,4 +82,10 @@ inline void psnrError::execute(void *original, void *approx, size_t n) {
 
   MPI_Barrier(comm);
 }
+
+/* -------------------------------------------------------------------------- */
+template void psnrError::compute<float>(float const*, float const*, size_t);
+template void psnrError::compute<double>(double const*, double const*, size_t);
+template void psnrError::compute<int32_t>(int32_t const*, int32_t const*, size_t);
+template void psnrError::compute<int64_t>(int64_t const*, int64_t const*, size_t);
 /* -------------------------------------------------------------------------- */
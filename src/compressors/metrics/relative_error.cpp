@@ -30,6 +30,7 @@
  */
 
 #include <cmath>
+#include <type_traits>
 #include <string>
 #include <sstream>
 #include <iostream>
@@ -37,7 +38,7 @@
 #include <algorithm>
 #include "compressors/metrics/relative_error.h"
 /* -------------------------------------------------------------------------- */
-double relativeError::relError(float original, float approx, double tolerance) {
+double relativeError::relError(double original, double approx, double tolerance) {
   double absolute_error = std::abs(original - approx);
   if (std::abs(original) < tolerance) {
     return absolute_error;
@@ -46,18 +47,26 @@ double relativeError::relError(float original, float approx, double tolerance) {
 }
 
 /* -------------------------------------------------------------------------- */
-void relativeError::execute(void *original, void *approx, size_t n) {
-  std::vector<double> error(n);
+void relativeError::execute(void* original, void* approx, size_t n, gio::Type type) {
+  gio::dispatch(type, [&](auto* tag) {
+    using T = std::remove_pointer_t<decltype(tag)>;
+    compute(static_cast<T const*>(original), static_cast<T const*>(approx), n);
+  });
+}
 
+/* -------------------------------------------------------------------------- */
+template <typename T>
+void relativeError::compute(T const* original, T const* approx, size_t n) {
   double local_sum_error = 0;
+  double local_max_error = 0;
 
+  #pragma omp parallel for simd reduction(+:local_sum_error) reduction(max:local_max_error)
   for (std::size_t i = 0; i < n; ++i) {
-    error[i] =
-      relError(static_cast<float*>(original)[i], static_cast<float*>(approx)[i], 1);
-    local_sum_error += error[i];
+    double const error = relError(original[i], approx[i], 1);
+    local_sum_error += error;
+    local_max_error = local_max_error < error ? error : local_max_error;
   }
 
-  double local_max_error = *std::max_element(error.begin(), error.end());
   local_val = local_max_error;
 
   double total_max_error = 0;
@@ -82,4 +91,10 @@ void relativeError::execute(void *original, void *approx, size_t n) {
 
   MPI_Barrier(comm);
 }
+
+/* -------------------------------------------------------------------------- */
+template void relativeError::compute<float>(float const*, float const*, size_t);
+template void relativeError::compute<double>(double const*, double const*, size_t);
+template void relativeError::compute<int32_t>(int32_t const*, int32_t const*, size_t);
+template void relativeError::compute<int64_t>(int64_t const*, int64_t const*, size_t);
 /* -------------------------------------------------------------------------- */
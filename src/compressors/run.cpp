@@ -32,18 +32,30 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <memory>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstring>
 #include <ctime>
 #include <cstdlib>
 #include <mpi.h>
+#include <omp.h>
 #include "io/interface.h"
 #include "io/hacc.h"
+#include "io/container.h"
+#include "io/cache.h"
 #include "compressors/kernels/interface.h"
 #include "compressors/kernels/factory.h"
 #include "compressors/metrics/interface.h"
 #include "compressors/metrics/factory.h"
+#include "compressors/metrics/bound_checker.h"
+#include "compressors/metrics/metric_engine.h"
+#include "spectrum/power_spectrum.h"
 #include "utils/json.h"
 #include "utils/timer.h"
 #include "utils/memory.h"
+#include "utils/buffer.h"
 #include "utils/tools.h"
 
 /* -------------------------------------------------------------------------- */
@@ -64,6 +76,10 @@ int main(int argc, char* argv[]) {
     return EXIT_FAILURE;
   }
 
+#if HAVE_FFTW
+  fftw_mpi_init();
+#endif
+
   // Pass JSON file to json parser and
   nlohmann::json json;
   std::ifstream file(argv[1]);
@@ -74,6 +90,8 @@ int main(int argc, char* argv[]) {
   std::vector<std::string> metrics;
 
   bool dump = false;
+  bool archive = false;
+  std::string archive_path;
   std::string output_file;
   std::string output_path = ".";
 
@@ -86,6 +104,37 @@ int main(int argc, char* argv[]) {
   for (auto&& name : json["input"]["scalars"])
     scalars.push_back(name);
 
+  // scalars of a group are compressed jointly as a single field,
+  // either stacked one after the other or interleaved per record.
+  struct Field {
+    std::string name;
+    std::vector<std::string> members;
+    bool interleave = false;
+  };
+
+  std::vector<Field> fields;
+
+  if (json["compress"].count("groups")) {
+    for (auto&& group : json["compress"]["groups"]) {
+      Field field;
+      for (auto&& name : group["scalars"]) {
+        field.members.push_back(name);
+        field.name += (field.name.empty() ? "" : "+") + field.members.back();
+      }
+      field.interleave = group.count("layout") and group["layout"] == "interleave";
+      if (not field.members.empty())
+        fields.push_back(field);
+    }
+  }
+
+  for (auto&& scalar : scalars) {
+    bool grouped = false;
+    for (auto&& field : fields)
+      grouped |= std::count(field.members.begin(), field.members.end(), scalar) > 0;
+    if (not grouped)
+      fields.push_back({scalar, {scalar}, false});
+  }
+
   for (auto&& field : json["compress"]["kernels"])
     compressors.push_back(field["name"]);
 
@@ -98,9 +147,43 @@ int main(int argc, char* argv[]) {
     output_file = json["compress"]["output"]["dump"];
   }
 
+  // check the error bound of each kernel while decompressing
+  bool const verify = json["compress"].count("verify") and json["compress"]["verify"].get<bool>();
+
+  // kernels are timed over repeated calls on pre-faulted buffers,
+  // after some warmup calls, rather than once.
+  int warmup = 0;
+  int repeat = 0;
+  if (json["compress"].count("benchmark")) {
+    auto const& config = json["compress"]["benchmark"];
+    warmup = config.count("warmup") ? config["warmup"].get<int>() : 1;
+    repeat = config.count("repeat") ? config["repeat"].get<int>() : 10;
+  }
+  bool const benchmark = repeat > 0;
+
+  // metrics are computed window by window while decompressing, rather
+  // than on whole decompressed fields, when kernels and metrics allow it.
+  bool const streaming = json["compress"].count("stream") and json["compress"]["stream"].get<bool>();
+
+  // compressed payloads are kept in one container file per kernel
+  if (json["compress"]["output"].count("archive")) {
+    archive = true;
+    archive_path = json["compress"]["output"]["archive"];
+  }
+
   int const nb_compressors = compressors.size();
   int const nb_metrics = metrics.size();
 
+  // the matter power spectrum of decompressed positions is compared to
+  // that of the input, or to a reference file, once all of them are known.
+  int const spectrum_metric = std::find(metrics.begin(), metrics.end(), "power_spectrum") - metrics.begin();
+  bool spectral = spectrum_metric < nb_metrics;
+  std::vector<std::string> axes {"x", "y", "z"};
+  std::vector<float> positions[3];
+  PowerSpectrum spectrum;
+  PowerSpectrum reference;
+  int placed = 0;
+
   // For humans; all seems valid, let's start ...
   if (rank == 0) {
     std::cout << "Running compression ... " << std::endl;
@@ -123,17 +206,97 @@ int main(int argc, char* argv[]) {
   for (auto&& metric : metrics)
     output_csv << metric << ", ";
 
+  output_csv << "Ranks, Threads per rank, ";
   output_csv << "Compression Throughput(MB/s), DeCompression Throughput(MB/s)";
-  output_csv << ", Compression Ratio" << std::endl;
+  output_csv << ", Compression Ratio, Stages (name bytes zip_time unzip_time)" << std::endl;
   metrics_info << "Input file: " << input << std::endl;
 
+  // per-rank timing percentiles, in seconds
+  nlohmann::json report;
+  report["input"] = input;
+  report["ranks"] = nb_ranks;
+  report["warmup"] = warmup;
+  report["repeat"] = repeat;
+  report["results"] = nlohmann::json::array();
+
   clock_overall.start();
 
   //
+  // kernel parameters are stored as strings, lists are joined by '+'
+  auto to_param = [](nlohmann::json const& value) -> std::string {
+    if (value.is_string())
+      return value.get<std::string>();
+    if (value.is_array()) {
+      std::string joined;
+      for (auto&& item : value) {
+        if (not joined.empty())
+          joined += "+";
+        joined += item.is_string() ? item.get<std::string>() : item.dump();
+      }
+      return joined;
+    }
+    return value.dump();
+  };
+
   // managers
   DataLoaderInterface* io_manager = new HACCDataLoader();
   CompressorInterface* compress_manager = nullptr;
-  MetricInterface* metrics_manager = nullptr;
+
+  // pooled buffers, grown on demand and reused for all kernels and fields
+  Buffer zipped;
+  Buffer unzipped;
+  Buffer joined;
+  Buffer split;
+  Buffer restored;
+  size_t joint_dims[5] = {0, 0, 0, 0, 0};
+
+  // load all members of a joint field into 'joined', and fail if one
+  // of them is missing or differs from the first one in type or size.
+  auto gather = [&](Field const& field) -> bool {
+    size_t const count = field.members.size();
+    gio::Type type = gio::Type::Float;
+    size_t numel = 0;
+    size_t type_size = 0;
+
+    for (size_t k = 0; k < count; ++k) {
+      if (not io_manager->load(field.members[k]))
+        return false;
+
+      if (k == 0) {
+        type = io_manager->getType();
+        numel = io_manager->getNumElements();
+        type_size = io_manager->getTypeSize();
+        joined.reserve(count * numel * type_size);
+      } else if (io_manager->getType() != type or io_manager->getNumElements() != numel) {
+        io_manager->close();
+        return false;
+      }
+
+      tools::stack(
+        io_manager->data, k, count, numel, type_size, field.interleave, joined.data()
+      );
+      io_manager->close();
+    }
+
+    // the fastest varying extent comes first
+    joint_dims[0] = field.interleave ? count : numel;
+    joint_dims[1] = field.interleave ? numel : count;
+    return true;
+  };
+
+  // save decompressed data of a field, joint ones being split back into their members
+  auto save = [&](Field const& field, void* data, size_t numel, size_t type_size) {
+    size_t const count = field.members.size();
+    if (count > 1) {
+      Span const column = split.reserve(numel / count * type_size);
+      for (size_t k = 0; k < count; ++k) {
+        tools::unstack(data, k, count, numel / count, type_size, field.interleave, column.data);
+        io_manager->save(field.members[k], column.data);
+      }
+    } else {
+      io_manager->save(field.name, data);
+    }
+  };
 
   // Check if the data info exist for a dataset
   if (json["input"].count("data-info")) {
@@ -145,13 +308,61 @@ int main(int argc, char* argv[]) {
     }
   }
 
+  // results of previous runs are looked up in the cache, if any
+  std::unique_ptr<ResultCache> cache;
+  bool keep_payload = false;
+  bool loaded = false;
+
+  // timings are what a benchmark measures, and the spectrum spans several
+  // fields, so nothing is replayed then.
+  if (json["compress"].count("cache") and not benchmark and not spectral) {
+    auto const& config = json["compress"]["cache"];
+    cache = std::make_unique<ResultCache>(config["path"].get<std::string>(), comm);
+    keep_payload = config.count("payload") and config["payload"].get<bool>();
+    if (not cache->open(input))
+      cache.reset();
+  }
+
   // init and save parameters of input file to facilitate rewrite
   io_manager->init(input, comm);
   io_manager->setSave(dump);
 
-  if (dump)
+  if (dump or archive)
     io_manager->saveParams();
 
+  if (spectral) {
+    auto const& config = json["compress"]["metrics"][spectrum_metric];
+    if (config.count("positions"))
+      axes = config["positions"].get<std::vector<std::string>>();
+
+    // the three axes are read in a single pass, in place
+    auto* hacc = static_cast<HACCDataLoader*>(io_manager);
+    std::vector<HACCDataLoader::Binding> targets;
+    for (int d = 0; d < 3; ++d)
+      targets.push_back(HACCDataLoader::bind(axes[d], positions[d]));
+    spectral = hacc->load(targets);
+
+    if (spectral) {
+      // the box is that of the input unless given
+      int const cells = config.count("cells") ? config["cells"].get<int>() : 128;
+      double const box = config.count("box") ? config["box"].get<double>() : hacc->phys_scale[0];
+      spectrum = PowerSpectrum(cells, box, comm);
+
+      if (config.count("reference")) {
+        spectral = reference.load(config["reference"].get<std::string>());
+      } else {
+        reference = spectrum;
+        spectral = reference.compute(positions[0].data(), positions[1].data(),
+                                     positions[2].data(), positions[0].size());
+        if (spectral and rank == 0 and config.count("output"))
+          reference.dump(config["output"].get<std::string>() + "_input.dat");
+      }
+    }
+
+    if (not spectral and rank == 0)
+      std::cout << "Cannot compute power spectrum ... Skipping!" << std::endl;
+  }
+
   // Cycle through compressors and parameters
   for (int c = 0; c < nb_compressors; ++c) {
     // initialize compressor
@@ -166,18 +377,24 @@ int main(int argc, char* argv[]) {
 
     // initialize compressor
     compress_manager->init();
+    placed = 0;
+
+    std::unique_ptr<ContainerWriter> container;
+    if (archive) {
+      auto const& prefix = json["compress"]["kernels"][c]["prefix"];
+      std::string const suffix = prefix.is_string() ? prefix.get<std::string>() : compressors[c];
+      container = std::make_unique<ContainerWriter>(archive_path + "_" + suffix + ".hz", comm);
+    }
 
     // Apply parameter if same for all scalars, else delay for later
     bool sameCompressorParams = true;
     if (json["compress"]["kernels"][c].count("params"))
       sameCompressorParams = false;
     else {
-      auto const& current = json["kernels"][c];
+      auto const& current = json["compress"]["kernels"][c];
       for (auto it = current.begin(); it != current.end(); ++it) {
-        if (it.key() != "name" and it.key() != "prefix") {
-          std::string value = it.value();
-          compress_manager->parameters[it.key()] = value;
-        }
+        if (it.key() != "name" and it.key() != "prefix")
+          compress_manager->parameters[it.key()] = to_param(it.value());
       }
     }
 
@@ -190,20 +407,16 @@ int main(int argc, char* argv[]) {
       debug_log << "---------------------------------------" << std::endl;
       debug_log << "Compressor: " << compress_manager->getName() << std::endl;
     #endif
-    // Cycle through scalars
-    for (auto& scalar : scalars) {
+    // Cycle through fields
+    for (auto& field : fields) {
+      auto const& scalar = field.name;
+      bool const joint = field.members.size() > 1;
       Timer clock_zip;
       Timer clock_unzip;
       Memory memory_manager;
 
       memory_manager.start();
 
-      // Check if parameter is valid before proceding
-      if (not io_manager->load(scalar)) {
-        memory_manager.stop();
-        continue;
-      }
-
       // Read in compressor parameter for this field
       if (not sameCompressorParams) {
         // reset param for each field
@@ -214,61 +427,391 @@ int main(int argc, char* argv[]) {
         for (int i = 0; i < nb_params; i++) {
           for (auto&& current : param[i]["scalar"]) {
             std::string name = current;
-            if (name != scalar)
+            if (std::count(field.members.begin(), field.members.end(), name) == 0)
               continue;
 
             //auto& param = json["compress"]["kernels"][c]["params"][i];
             for (auto it = param[i].begin(); it != param[i].end(); ++it) {
-              if (it.key() != "scalar") {
-                double value = it.value();
-                compress_manager->parameters[it.key()] = std::to_string(value);
-              }
+              if (it.key() != "scalar")
+                compress_manager->parameters[it.key()] = to_param(it.value());
             }
           }
         }
       }
 
+      // decisions of the auto kernel are made per scalar
+      if (compressors[c] == "auto")
+        compress_manager->parameters["scalar"] = scalar;
+
+      // a previous result is replayed when both the input field and the
+      // whole configuration are unchanged, without loading the data.
+      std::string const descriptor = scalar + (field.interleave ? ":interleave" : ":stack");
+      std::string key;
+      ResultCache::Entry cached;
+      uint64_t checksum = 0;
+
+      auto describe = [&](uint64_t crc) {
+        nlohmann::json description;
+        description["kernel"] = compressors[c];
+        description["params"] = compress_manager->parameters;
+        description["field"] = descriptor;
+        description["crc"] = crc;
+        description["metrics"] = json["compress"]["metrics"];
+        description["verify"] = verify;
+        return cache->getKey(description.dump());
+      };
+
+      bool const known = cache and cache->getChecksum(descriptor, checksum);
+      if (known)
+        key = describe(checksum);
+
+      bool const hit = known and cache->find(key, cached, dump or archive, restored);
+
+      // Check if parameter is valid before proceding
+      if (not hit and not (joint ? gather(field) : io_manager->load(scalar))) {
+        memory_manager.stop();
+        continue;
+      }
+
+      loaded |= not hit;
+
+      void* const input_data = hit ? nullptr : joint ? joined.data() : io_manager->data;
+      size_t* const dims = hit ? cached.n : joint ? joint_dims : io_manager->getSizePerDim();
+      gio::Type const type = hit ? cached.type : io_manager->getType();
+      size_t const type_size = hit ? cached.type_size : io_manager->getTypeSize();
+      size_t const numel = CompressorInterface::getNumElements(dims);
+      size_t const raw_bytes = type_size * numel;
+
+      // metrics and typed kernels only handle the types of 'gio::dispatch'
+      if (not gio::dispatchable(type)) {
+        if (rank == 0) {
+          std::cout << "Unsupported type " << gio::to_string(type) << " for ";
+          std::cout << scalar << " ... Skipping!" << std::endl;
+        }
+        if (not joint)
+          io_manager->close();
+        memory_manager.stop();
+        continue;
+      }
+
+      if (cache and not known) {
+        checksum = cache->setChecksum(descriptor, input_data, raw_bytes);
+        key = describe(checksum);
+      }
+
       // log stuff
       #if !defined(NDEBUG)
-        debug_log << io_manager->getDataInfo();
-        debug_log << io_manager->getLog();
+        if (hit) {
+          debug_log << "cache hit: " << key << std::endl;
+        } else {
+          debug_log << io_manager->getDataInfo();
+          debug_log << io_manager->getLog();
+        }
         tools::append(logs, debug_log, ".log");
       #endif
 
+      // report of this field, including its header
+      size_t const field_info_mark = metrics_info.str().size();
+      size_t const field_row_mark = output_csv.str().size();
+
+      // a kernel failure on any rank skips the field on all of them, so that
+      // container indices and collective calls stay consistent.
+      auto failed = [&](int status, std::string const& step) {
+        int local = (status != EXIT_SUCCESS);
+        int global = 0;
+        MPI_Allreduce(&local, &global, 1, MPI_INT, MPI_MAX, comm);
+        if (not global)
+          return false;
+
+        if (rank == 0) {
+          std::cout << step << " of " << scalar << " with " << compressors[c];
+          std::cout << " failed ... Skipping!" << std::endl;
+        }
+
+        for (auto* stream : {&metrics_info, &output_csv}) {
+          size_t const mark = (stream == &metrics_info ? field_info_mark : field_row_mark);
+          std::string const kept = stream->str().substr(0, mark);
+          stream->str(kept);
+          stream->seekp(0, std::ios::end);
+        }
+
+        compress_manager->clearLog();
+        if (not joint)
+          io_manager->close();
+        memory_manager.stop();
+        MPI_Barrier(comm);
+        return true;
+      };
+
       metrics_info << compress_manager->getInfos() << std::endl;
       output_csv << compress_manager->getName() << "_" << scalar;
       output_csv << "__" << compress_manager->getInfos();
       output_csv << ", " << json["compress"]["kernels"][c]["prefix"] << ", ";
 
+      // report of this field, from here
+      size_t const info_mark = metrics_info.str().size();
+      size_t const row_mark = output_csv.str().size();
+
+      if (hit) {
+        // outputs are rebuilt from the cached payload, checked first
+        Span const raw_decomp = dump ? unzipped.reserve(raw_bytes) : Span {};
+        int const status = dump
+          ? compress_manager->decompress({restored.data(), cached.bytes}, raw_decomp, type, type_size, dims)
+          : EXIT_SUCCESS;
+
+        if (failed(status, "Replay"))
+          continue;
+
+        if (container) {
+          ContainerField const info {
+            field.name, field.members, field.interleave,
+            compressors[c], compress_manager->parameters, type, type_size
+          };
+          container->add(info, dims, {restored.data(), cached.bytes});
+        }
+
+        if (dump)
+          save(field, raw_decomp.data, numel, type_size);
+
+        metrics_info << cached.info;
+        output_csv << cached.row;
+
+        if (rank == 0) {
+          tools::dump(stats + ".txt", metrics_info.str());
+          tools::dump(stats + ".csv", output_csv.str());
+        }
+
+        compress_manager->clearLog();
+        memory_manager.stop();
+        MPI_Barrier(comm);
+        continue;
+      }
+
       MPI_Barrier(comm);
 
-      // compress
-      void* raw_comp = nullptr;
+      // parameters of each metric for this field
+      std::vector<std::unordered_map<std::string, std::string>> metric_params(nb_metrics);
+      for (int m = 0; m < nb_metrics; ++m) {
+        auto& current = json["compress"]["metrics"][m];
+        if (m == spectrum_metric)
+          continue;
+
+        for (auto it = current.begin(); it != current.end(); it++) {
+          std::string key = it.key();
+          if (key == "name")
+            continue;
+
+          // histogram options of fused metrics
+          bool const binning = key == "bins" or key == "scale" or key == "range" or key == "format";
+          if (binning and metricEngine::supports(metrics[m]))
+            continue;
+
+          // lists of scalars select fields, other values are plain parameters
+          if (not it.value().is_array()) {
+            metric_params[m][key] = to_param(it.value());
+            continue;
+          }
+
+          for (auto&& metric : json["compress"]["metrics"][m][key]) {
+            if (metric == scalar or std::count(
+                  field.members.begin(), field.members.end(), metric.get<std::string>())) {
+              metric_params[m][key] = scalar;
+              break;
+            }
+          }
+        }
+
+        // the layout of joint fields and the periodic box of the input
+        // are given to metrics that need them
+        if (not metricEngine::supports(metrics[m])) {
+          auto const* hacc = static_cast<HACCDataLoader*>(io_manager);
+          metric_params[m]["components"] = std::to_string(field.members.size());
+          metric_params[m]["interleave"] = field.interleave ? "1" : "0";
+          if (not metric_params[m].count("box") and hacc->phys_scale[0] > 0.)
+            metric_params[m]["box"] = to_param(hacc->phys_scale[0]);
+        }
+      }
+
+      // metrics without extra output are computed together, in a single
+      // pass over the arrays and a single reduction.
+      auto const fusable = [&](int m) {
+        return metricEngine::supports(metrics[m]) and
+               (metric_params[m].empty() or (metric_params[m].size() == 1 and metric_params[m].count("histogram")));
+      };
+
+      // distributions asked by these metrics are binned during the same pass
+      // if their range is given, or in an extra pass once it is known.
+      auto const distribution = [&](int m) {
+        return metrics[m] == "relative_error" ? metricEngine::RelativeError
+             : metrics[m] == "min_max"        ? metricEngine::Value
+             :                                  metricEngine::Error;
+      };
+
+      auto const binned = [&](int m) {
+        return fusable(m) and metric_params[m].count("histogram") > 0;
+      };
+
+      bool deferred_histograms = false;
+      auto const setHistograms = [&](metricEngine& engine) {
+        for (int m = 0; m < nb_metrics; ++m) {
+          if (not binned(m))
+            continue;
 
+          auto const& current = json["compress"]["metrics"][m];
+          auto const scale = current.count("scale") and current["scale"] == "log"
+                           ? Histogram::Log : Histogram::Linear;
+          size_t const nb_bins = current.count("bins") ? current["bins"].get<size_t>() : 1024;
+          double lower = 0.;
+          double upper = 0.;
+          if (current.count("range")) {
+            lower = current["range"][0];
+            upper = current["range"][1];
+          }
+          engine.addHistogram(distribution(m), nb_bins, scale, lower, upper);
+        }
+        deferred_histograms = engine.hasDeferredHistogram();
+      };
+
+      // values decoded at once by kernels made of independent blocks
+      size_t const block = compress_manager->getRangeBlock();
+      size_t const piece = block > 0 ? block * omp_get_max_threads() : numel;
+      bool windowed = streaming and block > 0 and not dump and not benchmark and not spectral;
+      for (int m = 0; m < nb_metrics; ++m)
+        windowed &= fusable(m) and (not binned(m) or json["compress"]["metrics"][m].count("range"));
+
+      size_t const max_bytes = compress_manager->maxCompressedSize(type, type_size, dims);
+
+      Span const raw_comp = zipped.reserve(max_bytes);
+      Span const raw_decomp = unzipped.reserve((windowed ? std::min(piece, numel) : numel) * type_size);
+
+      std::vector<double> zip_times;
+      std::vector<double> unzip_times;
+      int status = EXIT_SUCCESS;
+
+      // data-dependent setup stays out of the timings
+      compress_manager->prepare({input_data, raw_bytes}, type, type_size, dims);
+
+      if (benchmark) {
+        // page faults of the first touch are kept out of the timings
+        std::memset(raw_comp.data, 0, max_bytes);
+        std::memset(raw_decomp.data, 0, raw_bytes);
+
+        // every rank keeps the same barriers, failures are agreed on after the loop
+        for (int i = 0; i < warmup + repeat; ++i) {
+          Timer clock;
+          MPI_Barrier(comm);
+          clock.start();
+          int const zip_status = compress_manager->compress(
+            {input_data, raw_bytes}, raw_comp, type, type_size, dims
+          );
+          clock.stop();
+          double const zip_time = clock.getDuration();
+
+          MPI_Barrier(comm);
+          clock.start();
+          int const unzip_status = zip_status != EXIT_SUCCESS ? zip_status : compress_manager->decompress(
+            {raw_comp.data, compress_manager->getBytes()}, raw_decomp, type, type_size, dims
+          );
+          clock.stop();
+
+          if (zip_status != EXIT_SUCCESS or unzip_status != EXIT_SUCCESS)
+            status = EXIT_FAILURE;
+
+          if (i >= warmup) {
+            zip_times.push_back(zip_time);
+            unzip_times.push_back(clock.getDuration());
+          }
+        }
+        compress_manager->clearLog();
+
+        if (failed(status, "Benchmark"))
+          continue;
+      }
+
+      // compress
       clock_zip.start();
-      compress_manager->compress(
-        io_manager->data, raw_comp,
-        io_manager->getType(),
-        io_manager->getTypeSize(),
-        io_manager->getSizePerDim()
+      status = compress_manager->compress(
+        {input_data, raw_bytes}, raw_comp, type, type_size, dims
       );
       clock_zip.stop();
 
-      // decompress
-      void* raw_decomp = nullptr;
+      if (failed(status, "Compression"))
+        continue;
+
+      // decompress, and check the error bound piece by piece while the
+      // decoded values are still in cache if the kernel allows it.
+      boundChecker checker;
+      metricEngine engine;
+      setHistograms(engine);
+      Span const stream { raw_comp.data, compress_manager->getBytes() };
+      bool const fused = verify and checker.init(comm, compress_manager->parameters);
+      auto* const original = static_cast<char*>(input_data);
+      auto* const decoded = static_cast<char*>(raw_decomp.data);
+      bool checked = true;
+      double window_time = 0.;
 
       clock_unzip.start();
-      compress_manager->decompress(
-        raw_comp, raw_decomp,
-        io_manager->getType(),
-        io_manager->getTypeSize(),
-        io_manager->getSizePerDim()
-      );
+      if (windowed) {
+        // only one window of decoded values is kept, and only decoding is timed
+        engine.init(comm);
+        engine.begin();
+        for (size_t first = 0; first < numel and checked and status == EXIT_SUCCESS; first += piece) {
+          size_t const count = std::min(piece, numel - first);
+          size_t const offset = first * type_size;
+          Timer clock_window;
+          clock_window.start();
+          status = compress_manager->decompressRange(
+            stream, {decoded, count * type_size}, type, type_size, dims, first, count
+          );
+          clock_window.stop();
+          window_time += clock_window.getDuration();
+
+          if (status != EXIT_SUCCESS)
+            break;
+          if (fused)
+            checked = checker.check(original + offset, decoded, count, type, first);
+          engine.accumulate(original + offset, decoded, count, type);
+        }
+        engine.finalize();
+      } else if (fused and block > 0) {
+        for (size_t first = 0; first < numel and checked and status == EXIT_SUCCESS; first += piece) {
+          size_t const count = std::min(piece, numel - first);
+          size_t const offset = first * type_size;
+          status = compress_manager->decompressRange(
+            stream, {decoded + offset, count * type_size}, type, type_size, dims, first, count
+          );
+          if (status == EXIT_SUCCESS)
+            checked = checker.check(original + offset, decoded + offset, count, type, first);
+        }
+      } else {
+        status = compress_manager->decompress(stream, raw_decomp, type, type_size, dims);
+        if (fused and status == EXIT_SUCCESS)
+          checked = checker.check(original, decoded, numel, type, 0);
+      }
       clock_unzip.stop();
 
+      if (failed(status, "Decompression")) {
+        engine.close();
+        continue;
+      }
+
+      // only payloads that decompress are archived
+      if (container) {
+        ContainerField const info {
+          field.name, field.members, field.interleave,
+          compressors[c], compress_manager->parameters, type, type_size
+        };
+        container->add(info, dims, stream);
+      }
+
+      if (not checked) {
+        std::cerr << "Error bound of " << compressors[c] << " violated on " << scalar << std::endl;
+        MPI_Abort(comm, EXIT_FAILURE);
+      }
+
       unsigned long local_size[2];
       local_size[0] = compress_manager->getBytes();
-      local_size[1] = io_manager->getTypeSize() * io_manager->getNumElements();
+      local_size[1] = raw_bytes;
 
       unsigned long total_size[2];
       MPI_Allreduce(local_size  , total_size  , 1, MPI_UNSIGNED_LONG, MPI_SUM, comm);
@@ -297,56 +840,130 @@ int main(int argc, char* argv[]) {
       metrics_info << std::endl;
       metrics_info << "Field: " << scalar << std::endl;
 
+      if (fused) {
+        if (not checker.finalize()) {
+          if (rank == 0)
+            std::cerr << "Error bound of " << compressors[c] << " violated on " << scalar << std::endl;
+          MPI_Abort(comm, EXIT_FAILURE);
+        }
+        #if !defined(NDEBUG)
+          debug_log << checker.getLog();
+        #endif
+        metrics_info << checker.getLog();
+      } else if (verify and rank == 0) {
+        metrics_info << "-Bound Check: skipped, no abs, rel or pw_rel bound" << std::endl;
+      }
+
+      // decompressed positions are kept until the last one is known
+      double deviation = -1.;
+      if (spectral and type == gio::Type::Float) {
+        size_t const count = field.members.size();
+        for (size_t k = 0; k < count; ++k) {
+          for (int d = 0; d < 3; ++d) {
+            if (field.members[k] == axes[d]) {
+              positions[d].resize(numel / count);
+              tools::unstack(
+                raw_decomp.data, k, count, numel / count, type_size, field.interleave, positions[d].data()
+              );
+              placed |= 1 << d;
+            }
+          }
+        }
+
+        if (placed == 7 and spectrum.compute(positions[0].data(), positions[1].data(),
+                                             positions[2].data(), positions[0].size())) {
+          auto const& config = json["compress"]["metrics"][spectrum_metric];
+          double const k_max = config.count("k_max") ? config["k_max"].get<double>() : 0.;
+          deviation = spectrum.compare(reference, k_max);
+          placed = 0;
+
+          if (rank == 0 and config.count("output")) {
+            auto const& prefix = json["compress"]["kernels"][c]["prefix"];
+            std::string const suffix = prefix.is_string() ? prefix.get<std::string>() : compressors[c];
+            spectrum.dump(config["output"].get<std::string>() + "_" + suffix + ".dat");
+          }
+        }
+      }
+
+      for (int m = 0; m < nb_metrics and not windowed; ++m) {
+        if (fusable(m)) {
+          engine.init(comm);
+          engine.execute(input_data, raw_decomp.data, numel, type);
+          if (deferred_histograms)
+            engine.complete(input_data, raw_decomp.data, numel, type);
+          break;
+        }
+      }
+
       for (int m = 0; m < nb_metrics; ++m) {
-        metrics_manager = MetricsFactory::create(metrics[m]);
-        if (metrics_manager == nullptr) {
-          if (rank == 0) {
-            std::cout << "Unsupported metric: " << metrics[m] << " ... ";
-            std::cout << "Skipping!" << std::endl;
+        if (m == spectrum_metric) {
+          // reported by the field that completes the positions
+          if (deviation >= 0.) {
+            metrics_info << "-Power spectrum: max |P/P_ref - 1|: " << deviation;
+            metrics_info << " over " << spectrum.size() << " shells" << std::endl;
+            output_csv << deviation << ", ";
+          } else {
+            output_csv << "-, ";
           }
           continue;
         }
 
-        // Read in additional params for metrics
-        auto& current = json["compress"]["metrics"][m];
-        for (auto it = current.begin(); it != current.end(); it++) {
-          std::string key = it.key();
-          if (key == "name")
-            continue;
+        if (fusable(m)) {
+          #if !defined(NDEBUG)
+            debug_log << engine.getLog(metrics[m]);
+          #endif
+          metrics_info << engine.getLog(metrics[m]);
+          output_csv << engine.getGlobalValue(metrics[m]) << ", ";
 
-          for (auto&& metric : json["compress"]["metrics"][m][key]) {
-            if (metric == scalar) {
-              metrics_manager->parameters[key] = scalar;
-              break;
-            }
+          if (rank == 0 and binned(m)) {
+            auto const& current = json["compress"]["metrics"][m];
+            bool const binary = current.count("format") and current["format"] == "binary";
+            tools::createFolder("logs");
+            std::string path = "logs/";
+            path += tools::extractFileName(input) + "_" + compressors[c];
+            path += "_" + scalar + "_" + metrics[m] + "_";
+            path += compress_manager->getInfos() + "_hist";
+            engine.getHistogram(distribution(m))->dump(path, binary ? Histogram::Binary : Histogram::CSV);
+          }
+          continue;
+        }
+
+        std::unique_ptr<MetricInterface> metrics_manager(MetricsFactory::create(metrics[m]));
+        if (metrics_manager == nullptr) {
+          if (rank == 0) {
+            std::cout << "Unsupported metric: " << metrics[m] << " ... ";
+            std::cout << "Skipping!" << std::endl;
           }
+          continue;
         }
 
         // Launch
+        metrics_manager->parameters = metric_params[m];
         metrics_manager->init(comm);
-        metrics_manager->execute(
-          io_manager->data, raw_decomp,
-          io_manager->getNumElements()
-        );
+        metrics_manager->execute(input_data, raw_decomp.data, numel, type);
 
         #if !defined(NDEBUG)
           debug_log << metrics_manager->getLog();
         #endif
         metrics_info << metrics_manager->getLog();
-        output_csv << metrics_manager->getGlobalValue() << ", ";
+        if (std::isnan(metrics_manager->getGlobalValue()))
+          output_csv << "-, ";
+        else
+          output_csv << metrics_manager->getGlobalValue() << ", ";
 
         if (rank == 0) {
           if (not metrics_manager->additionalOutput.empty()) {
             tools::createFolder("logs");
-            std::string outputHistogramName = "logs/";
-            outputHistogramName += tools::extractFileName(input) + "_" + compressors[c];
-            outputHistogramName += "_" + scalar + "_" + metrics[m] + "_";
-            outputHistogramName += compress_manager->getInfos() + "_hist.py";
-            tools::dump(outputHistogramName, metrics_manager->additionalOutput);
+            std::string outputName = "logs/";
+            outputName += tools::extractFileName(input) + "_" + compressors[c];
+            outputName += "_" + scalar + "_" + metrics[m] + "_";
+            outputName += compress_manager->getInfos() + ".dat";
+            tools::dump(outputName, metrics_manager->additionalOutput);
           }
         }
         metrics_manager->close();
       }
+      engine.close();
       #if !defined(NDEBUG)
         debug_log << "-----------------------------" << std::endl;
         debug_log << std::endl;
@@ -356,10 +973,26 @@ int main(int argc, char* argv[]) {
 
       // Metrics Computation
       double compress_time = clock_zip.getDuration();
-      double decompress_time = clock_unzip.getDuration();
+      double decompress_time = windowed ? window_time : clock_unzip.getDuration();
+
+      // percentiles of each rank, gathered on the first one
+      std::vector<double> timings(benchmark and rank == 0 ? 6 * nb_ranks : 0);
+
+      if (benchmark) {
+        double const local_timings[6] = {
+          tools::percentile(zip_times, 5),
+          tools::percentile(zip_times, 50),
+          tools::percentile(zip_times, 95),
+          tools::percentile(unzip_times, 5),
+          tools::percentile(unzip_times, 50),
+          tools::percentile(unzip_times, 95)
+        };
+        compress_time = local_timings[1];
+        decompress_time = local_timings[4];
+        MPI_Gather(local_timings, 6, MPI_DOUBLE, timings.data(), 6, MPI_DOUBLE, 0, comm);
+      }
 
-      size_t bytes = io_manager->getNumElements() * io_manager->getTypeSize();
-      double megabytes = static_cast<double>(bytes) / (1024. * 1024.);
+      double megabytes = static_cast<double>(raw_bytes) / (1024. * 1024.);
       double compress_throughput = megabytes / compress_time;
       double decompress_throughput = megabytes / decompress_time;
 
@@ -373,21 +1006,39 @@ int main(int argc, char* argv[]) {
       MPI_Reduce(&decompress_throughput, max_throughput+1, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
       MPI_Reduce(&decompress_throughput, min_throughput+1, 1, MPI_DOUBLE, MPI_MIN, 0, comm);
 
+      // throughputs are per rank, so report the threads behind them
+      int const local_threads = compress_manager->getThreads();
+      int max_threads = 0;
+      MPI_Reduce(&local_threads, &max_threads, 1, MPI_INT, MPI_MAX, 0, comm);
+
+      // per-stage breakdown of multi-stage kernels
+      std::stringstream stages_info;
+      for (auto&& stage : compress_manager->getStages()) {
+        unsigned long local_stage_bytes = stage.bytes;
+        unsigned long total_stage_bytes = 0;
+        double local_stage_time[] = {stage.zip_time, stage.unzip_time};
+        double max_stage_time[] = {0, 0};
+
+        MPI_Reduce(&local_stage_bytes, &total_stage_bytes, 1, MPI_UNSIGNED_LONG, MPI_SUM, 0, comm);
+        MPI_Reduce(local_stage_time, max_stage_time, 2, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+        stages_info << stage.name << " " << total_stage_bytes << " ";
+        stages_info << max_stage_time[0] << " " << max_stage_time[1] << "; ";
+      }
+
       if (dump) {
         #if !defined(NDEBUG)
           debug_log << "writing: " << scalar << std::endl;
         #endif
 
-        io_manager->save(scalar, raw_decomp);
+        save(field, raw_decomp.data, numel, type_size);
         #if !defined(NDEBUG)
           debug_log << io_manager->getLog();
         #endif
       }
 
-      // deallocate
-      std::free(raw_decomp);
-
-      io_manager->close();
+      if (not joint)
+        io_manager->close();
       memory_manager.stop();
 
       #if !defined(NDEBUG)
@@ -418,19 +1069,91 @@ int main(int argc, char* argv[]) {
         metrics_info << " MB/s" << std::endl;
         metrics_info << "Min DeCompression Throughput: " << min_throughput[1];
         metrics_info << " MB/s" << std::endl;
+        metrics_info << "Threads per rank: " << max_threads;
+        metrics_info << " (" << nb_ranks << " ranks)" << std::endl;
         metrics_info << "Compression ratio: " << ratio << std::endl;
+        if (not stages_info.str().empty())
+          metrics_info << "Stages: " << stages_info.str() << std::endl;
+
+        if (benchmark) {
+          nlohmann::json result;
+          result["kernel"] = compressors[c];
+          result["prefix"] = json["compress"]["kernels"][c]["prefix"];
+          result["field"] = scalar;
+          result["params"] = compress_manager->parameters;
+          result["bytes"] = total_size[1];
+          result["threads"] = max_threads;
+          result["ratio"] = ratio;
+
+          // imbalance is the excess of the slowest rank over the mean
+          double const total_megabytes = total_size[1] / (1024. * 1024.);
+          for (int phase = 0; phase < 2; ++phase) {
+            std::vector<double> low, median, high;
+            for (int r = 0; r < nb_ranks; ++r) {
+              low.push_back(timings[6 * r + 3 * phase]);
+              median.push_back(timings[6 * r + 3 * phase + 1]);
+              high.push_back(timings[6 * r + 3 * phase + 2]);
+            }
+
+            double const slowest = *std::max_element(median.begin(), median.end());
+            double const mean = std::accumulate(median.begin(), median.end(), 0.) / nb_ranks;
+
+            nlohmann::json& timing = result[phase == 0 ? "compress" : "decompress"];
+            timing["p5"] = low;
+            timing["median"] = median;
+            timing["p95"] = high;
+            timing["imbalance"] = mean > 0. ? slowest / mean - 1. : 0.;
+            timing["throughput"] = slowest > 0. ? total_megabytes / slowest : 0.;
+          }
+
+          metrics_info << "Timings: median of " << repeat << " runs after ";
+          metrics_info << warmup << " warmup runs, see " << stats << ".json" << std::endl;
+          report["results"].push_back(result);
+          tools::dump(stats + ".json", report.dump(2));
+        }
 
+        output_csv << nb_ranks << ", " << max_threads << ", ";
         output_csv << min_throughput[0] << ", ";
         output_csv << min_throughput[1] << ", ";
-        output_csv << ratio << std::endl;
+        output_csv << ratio << ", ";
+        output_csv << stages_info.str() << std::endl;
 
         tools::dump(stats + ".txt", metrics_info.str());
         tools::dump(stats + ".csv", output_csv.str());
       }
 
+      // failed fields were skipped above, so only valid results are stored
+      if (cache) {
+        ResultCache::Entry entry;
+        entry.row = output_csv.str().substr(row_mark);
+        entry.info = metrics_info.str().substr(info_mark);
+        entry.type = type;
+        entry.type_size = type_size;
+        entry.payload = keep_payload;
+        std::copy(dims, dims + 5, entry.n);
+        cache->store(key, entry, {raw_comp.data, compress_manager->getBytes()});
+      }
+
       MPI_Barrier(comm);
     }
 
+    // the partition is only known once some data is loaded
+    if ((container or dump) and not loaded and not fields.empty()) {
+      loaded = io_manager->load(fields.front().members.front());
+      io_manager->close();
+    }
+
+    if (container) {
+      auto const* hacc = static_cast<HACCDataLoader*>(io_manager);
+      container->setPhysics(hacc->phys_orig, hacc->phys_scale, hacc->mpi_partition);
+      container->write();
+
+      #if !defined(NDEBUG)
+        debug_log << container->getLog();
+        tools::append(logs, debug_log, ".log");
+      #endif
+    }
+
     if (dump) {
       Timer clock_dump;
       clock_dump.start();
@@ -466,6 +1189,7 @@ int main(int argc, char* argv[]) {
       #endif
     }
     compress_manager->close();
+    delete compress_manager;
   }
 
   clock_overall.stop();
@@ -482,6 +1206,10 @@ int main(int argc, char* argv[]) {
     std::cout << std::endl << "That's all folks!" << std::endl;
   }
 
+#if HAVE_FFTW
+  fftw_mpi_cleanup();
+#endif
+
   MPI_Finalize();
   return EXIT_SUCCESS;
 }
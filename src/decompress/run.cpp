@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cstdlib>
+#include <mpi.h>
+#include "io/GenericIO.h"
+#include "io/container.h"
+#include "utils/buffer.h"
+#include "utils/timer.h"
+#include "utils/json.h"
+
+/* -------------------------------------------------------------------------- */
+int main(int argc, char* argv[]) {
+  // init MPI
+  int rank;
+  int nb_ranks;
+  int threading = 1;
+  MPI_Comm comm = MPI_COMM_WORLD;
+
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &threading);
+  MPI_Comm_size(comm, &nb_ranks);
+  MPI_Comm_rank(comm, &rank);
+
+  // check input params
+  if (argc < 2) {
+    if (rank == 0) {
+      std::cerr << "Usage: mpirun -n <int> ./decompress input.hz output" << std::endl;
+      std::cerr << "       mpirun -n <int> ./decompress params.json" << std::endl;
+    }
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+
+  // a config may restrict the rebuilt rows of each rank to a range
+  std::string input;
+  std::string output;
+  bool ranged = false;
+  size_t first = 0;
+  size_t count = 0;
+
+  if (argc > 2) {
+    input = argv[1];
+    output = argv[2];
+  } else {
+    nlohmann::json json;
+    std::ifstream file(argv[1]);
+    if (not file.good()) {
+      if (rank == 0)
+        std::cerr << "Error while opening parameter file: " << argv[1] << std::endl;
+      MPI_Finalize();
+      return EXIT_FAILURE;
+    }
+
+    file >> json;
+    auto const& config = json["decompress"];
+    input = config["input"].get<std::string>();
+    output = config["output"].get<std::string>();
+
+    if (config.count("range")) {
+      ranged = true;
+      first = config["range"][0].get<size_t>();
+      count = config["range"][1].get<size_t>();
+    }
+  }
+
+  Timer clock;
+  clock.start();
+
+  ContainerReader reader(input, comm);
+  if (not reader.open()) {
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+
+  if (rank == 0)
+    std::cout << reader.getLog();
+
+  // decompress every field, members are stored one after the other
+  auto const& fields = reader.getFields();
+  int const nb_fields = fields.size();
+  std::vector<Buffer> decompressed(nb_fields);
+  size_t local_particles = 0;
+
+  for (int i = 0; i < nb_fields; ++i) {
+    // ranges are read independently, so their status is agreed on here
+    size_t numel = count;
+    int valid = ranged
+      ? reader.readRange(i, first, count, decompressed[i])
+      : reader.read(i, decompressed[i], numel);
+
+    MPI_Allreduce(MPI_IN_PLACE, &valid, 1, MPI_INT, MPI_MIN, comm);
+    if (not valid) {
+      MPI_Finalize();
+      return EXIT_FAILURE;
+    }
+
+    if (i > 0 and numel != local_particles) {
+      std::cerr << "rank[" << rank << "]: inconsistent field size: " << fields[i].name;
+      std::cerr << std::endl;
+      MPI_Abort(comm, EXIT_FAILURE);
+    }
+
+    local_particles = numel;
+    if (rank == 0)
+      std::cout << reader.getLog();
+  }
+
+  reader.close();
+
+  // reuse the original partition if it matches the number of ranks
+  int dims[3] = {0, 0, 0};
+  int periods[3] = {0, 0, 0};
+  auto const& partition = reader.mpi_partition;
+  if (partition[0] * partition[1] * partition[2] == nb_ranks)
+    std::copy(partition, partition + 3, dims);
+  else
+    MPI_Dims_create(nb_ranks, 3, dims);
+
+  MPI_Comm cart;
+  MPI_Cart_create(comm, 3, dims, periods, 0, &cart);
+
+  gio::GenericIO writer(cart, output);
+  writer.setNumElems(local_particles);
+
+  for (int d = 0; d < 3; ++d) {
+    writer.setPhysOrigin(reader.phys_orig[d], d);
+    writer.setPhysScale(reader.phys_scale[d], d);
+  }
+
+  // members share the buffer of their field: no extra space for CRC
+  for (int i = 0; i < nb_fields; ++i) {
+    auto const& field = fields[i];
+    auto* raw = static_cast<char*>(decompressed[i].data());
+
+    for (size_t k = 0; k < field.members.size(); ++k) {
+      auto const& name = field.members[k];
+      void* data = raw + k * local_particles * field.type_size;
+      unsigned flag = 0;
+
+      if (name == "x") flag |= gio::GenericIO::VarIsPhysCoordX;
+      else if (name == "y") flag |= gio::GenericIO::VarIsPhysCoordY;
+      else if (name == "z") flag |= gio::GenericIO::VarIsPhysCoordZ;
+
+      switch (field.type) {
+        case gio::Type::Float:  writer.addVariable(name, (float*)    data, flag); break;
+        case gio::Type::Double: writer.addVariable(name, (double*)   data, flag); break;
+        case gio::Type::Int:    writer.addVariable(name, (int*)      data, flag); break;
+        case gio::Type::Int8:   writer.addVariable(name, (int8_t*)   data, flag); break;
+        case gio::Type::Int16:  writer.addVariable(name, (int16_t*)  data, flag); break;
+        case gio::Type::Int32:  writer.addVariable(name, (int32_t*)  data, flag); break;
+        case gio::Type::Int64:  writer.addVariable(name, (int64_t*)  data, flag); break;
+        case gio::Type::Uint8:  writer.addVariable(name, (uint8_t*)  data, flag); break;
+        case gio::Type::Uint16: writer.addVariable(name, (uint16_t*) data, flag); break;
+        case gio::Type::Uint32: writer.addVariable(name, (uint32_t*) data, flag); break;
+        case gio::Type::Uint64: writer.addVariable(name, (uint64_t*) data, flag); break;
+        default: std::cout << name << " = undefined data type!" << std::endl; break;
+      }
+    }
+  }
+
+  writer.write();
+  clock.stop();
+
+  if (rank == 0)
+    std::cout << "Decompressed " << input << " in " << clock.getDuration() << " s" << std::endl;
+
+  MPI_Finalize();
+  return EXIT_SUCCESS;
+}
+/* -------------------------------------------------------------------------- */
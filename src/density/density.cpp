@@ -115,6 +115,19 @@ Density::Density(const char* in_path, int in_rank, int in_nb_ranks, MPI_Comm in_
   output_plot = json["plots"]["density"];
   output_bucket = json["plots"]["buckets"];
 
+  // power spectrum, compared to that of the input unless given
+  if (json.count("spectrum")) {
+    auto const& config = json["spectrum"];
+    spectral = true;
+    spectrum_cells = config.count("cells") ? config["cells"].get<int>() : 128;
+    spectrum_box = config.count("box") ? config["box"].get<double>() : 0.;
+    spectrum_k_max = config.count("k_max") ? config["k_max"].get<double>() : 0.;
+    if (config.count("reference"))
+      spectrum_reference = config["reference"];
+    if (config.count("output"))
+      output_spectrum = config["output"];
+  }
+
   // set the HACC IO manager
   ioMgr = std::make_unique<HACCDataLoader>();
   input_hacc  = json["hacc"]["input"];
@@ -138,24 +151,22 @@ void Density::cacheData() {
   if (master_rank)
     std::cout << "Caching particle data ... " << std::flush;
 
+  // coordinates, velocities and id are read in a single pass,
+  // directly into their final storage.
   std::string const columns[] = {"x", "y", "z", "vx", "vy", "vz", "id"};
+  std::vector<HACCDataLoader::Binding> targets;
 
-  for (int i = 0; i < dim; ++i) {
-    if (ioMgr->load(columns[i])) {
-      if (master_rank) {
-        std::cout << ioMgr->getDataInfo();
-        std::cout << ioMgr->getLog();
-      }
-      if (i == 0)
-        local_particles = ioMgr->getNumElements();
-
-      auto const n = local_particles;
-      auto const data = static_cast<float*>(ioMgr->data);
-      coords[i].resize(n);
-      std::copy(data, data + n, coords[i].data());
-      ioMgr->close();
-    }
-    MPI_Barrier(comm);
+  for (int i = 0; i < dim; ++i)
+    targets.push_back(HACCDataLoader::bind(columns[i], coords[i]));
+  for (int i = 0; i < dim; ++i)
+    targets.push_back(HACCDataLoader::bind(columns[i + dim], velocs[i]));
+  targets.push_back(HACCDataLoader::bind(columns[dim * 2], index));
+
+  if (ioMgr->load(targets)) {
+    if (master_rank)
+      std::cout << ioMgr->getLog();
+
+    local_particles = ioMgr->getNumElements();
   }
 
   // update particle count and coordinates data extents
@@ -166,25 +177,6 @@ void Density::cacheData() {
     coords_max[i] = static_cast<float>(ioMgr->data_extents[i].second);
   }
 
-  for (int i = 0; i < dim; ++i) {
-    if (ioMgr->load(columns[i + dim])) {
-      auto const n = ioMgr->getNumElements();
-      auto const data = static_cast<float*>(ioMgr->data);
-      velocs[i].resize(n);
-      std::copy(data, data + n, velocs[i].data());
-      ioMgr->close();
-    }
-    MPI_Barrier(comm);
-  }
-
-  if (ioMgr->load(columns[dim * 2])) {
-    auto const n = ioMgr->getNumElements();
-    auto const data = static_cast<long*>(ioMgr->data);
-    index.resize(n);
-    std::copy(data, data + n, index.data());
-    ioMgr->close();
-  }
-
   MPI_Barrier(comm);
 
   if (master_rank) {
@@ -239,33 +231,17 @@ void Density::computeFrequencies() {
   MPI_Allreduce(&local_rho_min, &total_rho_min, 1, MPI_DOUBLE, MPI_MIN, comm);
 
   // compute histogram of values
-  long local_histo[nb_bins];
-  auto total_histo = histogram.data();
-
-  std::fill(local_histo, local_histo + nb_bins, 0);
-  std::fill(total_histo, total_histo + nb_bins, 0);
+  Histogram values(nb_bins, total_rho_min, total_rho_max);
 
   if (not use_adaptive_binning) {
-    double const range = total_rho_max - total_rho_min;
-    double const capacity = range / nb_bins;
-
-    for (auto k = 0; k < local_rho_count; ++k) {
-      double relative_value = (density_field[k] - total_rho_min) / range;
-      int bin_index = static_cast<int>((range * relative_value) / capacity);
-
-      if (bin_index >= nb_bins)
-        bin_index--;
-
-      local_histo[bin_index]++;
-    }
+    values.add(density_field.data(), local_rho_count);
   } else {
-    auto const capacity = static_cast<long>(local_rho_count / double(nb_bins));
-    for (int bin_index = 0; bin_index < nb_bins; ++bin_index) {
-      local_histo[bin_index] = capacity;
-    }
+    auto const capacity = static_cast<uint64_t>(local_rho_count / double(nb_bins));
+    std::fill(values.getCounts().begin(), values.getCounts().end(), capacity);
   }
 
-  MPI_Allreduce(local_histo, total_histo, nb_bins, MPI_LONG, MPI_SUM, comm);
+  values.reduce(comm);
+  std::copy(values.getCounts().begin(), values.getCounts().end(), histogram.begin());
 
   if (my_rank == 0) {
     dumpHistogram();
@@ -541,8 +517,14 @@ void Density::process(int step) {
   size_t total_bytes_blosc[] = {0, total_particles * sizeof(float)};
   size_t nb_elems[] = {0, 0, 0, 0, 0};
 
-  std::vector<float> dataset;
-  decompressed[step].reserve(local_particles);
+  // pipeline is created once and reused for every bucket
+  std::unique_ptr<CompressorInterface> kernel_chain(CompressorFactory::create("chain"));
+  kernel_chain->parameters["stages"] = "fpzip+blosc";
+  kernel_chain->init();
+
+  dataset.reserve(local_particles);
+  decompressed[step].resize(local_particles);
+  size_t offset = 0;
 
   for (int j = 0; j < nb_bins; ++j) {
 
@@ -553,45 +535,35 @@ void Density::process(int step) {
     nb_elems[0] = buckets[j].size();
 
     // step 1: create dataset according to computed bin.
-    dataset.reserve(nb_elems[0]);
+    dataset.clear();
     for (auto&& particle_index : buckets[j])
       dataset.emplace_back(data[particle_index]);
 
-    // step 2: inflate agregated dataset and release memory
-    void* raw_data = static_cast<void*>(dataset.data());
-    void* raw_inflate = nullptr;
-    void* raw_deflate = nullptr;
-    void* raw_inflate_blosc = nullptr;
-    void* raw_deflate_blosc = nullptr;
-
-    auto kernel_fpzip = CompressorFactory::create("fpzip");
-    kernel_fpzip->init();
-    kernel_fpzip->parameters["bits"] = std::to_string(bits[j]);
-    kernel_fpzip->compress(raw_data, raw_inflate, "float", sizeof(float), nb_elems);
-
-    // early memory release
-    raw_data = nullptr;
-    dataset.clear();
-    dataset.shrink_to_fit();
-
-    auto kernel_blosc = CompressorFactory::create("blosc");
-    kernel_blosc->init();
-
-    auto type_size = kernel_fpzip->getBytes() / nb_elems[0];
-    std::cout << "chunk_size: " << kernel_fpzip->getBytes() << ", type_size: " << type_size << std::endl;
-    kernel_blosc->compress(raw_inflate, raw_inflate_blosc, "float", type_size, nb_elems);
+    // step 2: inflate agregated dataset into pooled buffer
+    size_t const raw_bytes = nb_elems[0] * sizeof(float);
+    kernel_chain->parameters["fpzip.bits"] = std::to_string(bits[j]);
+    Span inflate = zipped.reserve(
+      kernel_chain->maxCompressedSize(gio::Type::Float, sizeof(float), nb_elems)
+    );
+    kernel_chain->compress(
+      {dataset.data(), raw_bytes}, inflate, gio::Type::Float, sizeof(float), nb_elems
+    );
+    inflate.size = kernel_chain->getBytes();
 
     // update compression metrics
-    local_bytes_fpzip[0] += kernel_fpzip->getBytes();
-    local_bytes_blosc[0] += kernel_blosc->getBytes();
-    kernel_blosc->close();
-
-    // step 3: deflate data and store it
-    kernel_fpzip->decompress(raw_inflate, raw_deflate, "float", sizeof(float), nb_elems);
-    for (int k = 0; k < nb_elems[0]; ++k)
-      decompressed[step].emplace_back(static_cast<float*>(raw_deflate)[k]);
+    auto const& stages = kernel_chain->getStages();
+    local_bytes_fpzip[0] += stages[0].bytes;
+    local_bytes_blosc[0] += stages[1].bytes;
+
+    // step 3: deflate data directly into its final location
+    Span deflate { decompressed[step].data() + offset, raw_bytes };
+    kernel_chain->decompress(inflate, deflate, gio::Type::Float, sizeof(float), nb_elems);
+    offset += nb_elems[0];
   }
 
+  kernel_chain->close();
+  decompressed[step].resize(offset);
+
   MPI_Barrier(comm);
   MPI_Reduce(local_bytes_fpzip, total_bytes_fpzip, 1, MPI_UNSIGNED_LONG, MPI_SUM, 0, comm);
   MPI_Reduce(local_bytes_blosc, total_bytes_blosc, 1, MPI_UNSIGNED_LONG, MPI_SUM, 0, comm);
@@ -615,8 +587,13 @@ void Density::process(int step) {
   size_t total_bytes[] = {0, total_particles * sizeof(float)};
   size_t nb_elems[] = {0, 0, 0, 0, 0};
 
-  std::vector<float> dataset;
-  decompressed[step].reserve(local_particles);
+  // kernel is created once and reused for every bucket
+  std::unique_ptr<CompressorInterface> kernel_lossy(CompressorFactory::create("fpzip"));
+  kernel_lossy->init();
+
+  dataset.reserve(local_particles);
+  decompressed[step].resize(local_particles);
+  size_t offset = 0;
 
   for (int j = 0; j < nb_bins; ++j) {
     if (buckets[j].empty())
@@ -626,33 +603,33 @@ void Density::process(int step) {
     nb_elems[0] = buckets[j].size();
 
     // step 1: create dataset according to computed bin.
-    dataset.reserve(nb_elems[0]);
+    dataset.clear();
     for (auto&& particle_index : buckets[j])
       dataset.emplace_back(data[particle_index]);
 
-    // step 2: inflate agregated dataset and release memory
-    void* raw_data = static_cast<void*>(dataset.data());
-    void* raw_inflate = nullptr;
-    void* raw_deflate = nullptr;
-
-    auto kernel_lossy = CompressorFactory::create("fpzip");
-    kernel_lossy->init();
+    // step 2: inflate agregated dataset into pooled buffer
+    size_t const raw_bytes = nb_elems[0] * sizeof(float);
     kernel_lossy->parameters["bits"] = std::to_string(bits[j]);
-    kernel_lossy->compress(raw_data, raw_inflate, "float", sizeof(float), nb_elems);
-    dataset.clear();
+    Span inflate = zipped.reserve(
+      kernel_lossy->maxCompressedSize(gio::Type::Float, sizeof(float), nb_elems)
+    );
+    kernel_lossy->compress(
+      {dataset.data(), raw_bytes}, inflate, gio::Type::Float, sizeof(float), nb_elems
+    );
+    inflate.size = kernel_lossy->getBytes();
 
     // update compression metrics
     local_bytes[0] += kernel_lossy->getBytes();
 
-    // step 3: deflate data and store it
-    kernel_lossy->decompress(raw_inflate, raw_deflate, "float", sizeof(float), nb_elems);
-    for (int k = 0; k < nb_elems[0]; ++k)
-      decompressed[step].emplace_back(static_cast<float*>(raw_deflate)[k]);
-
-    std::free(raw_inflate);
-    std::free(raw_deflate);
+    // step 3: deflate data directly into its final location
+    Span deflate { decompressed[step].data() + offset, raw_bytes };
+    kernel_lossy->decompress(inflate, deflate, gio::Type::Float, sizeof(float), nb_elems);
+    offset += nb_elems[0];
   }
 
+  kernel_lossy->close();
+  decompressed[step].resize(offset);
+
   MPI_Barrier(comm);
   MPI_Reduce(local_bytes, total_bytes, 1, MPI_UNSIGNED_LONG, MPI_SUM, 0, comm);
 
@@ -692,6 +669,29 @@ void Density::dump() {
   index.clear();
   index.shrink_to_fit();
 
+  // ids are locally clustered in bucket order: report their lossless rate
+  size_t local_id_bytes[] = {0, uid.size() * sizeof(long)};
+  size_t total_id_bytes[] = {0, 0};
+  size_t nb_ids[] = {uid.size(), 0, 0, 0, 0};
+
+  std::unique_ptr<CompressorInterface> kernel_ids(CompressorFactory::create("integer"));
+  kernel_ids->init();
+  Span inflate = zipped.reserve(
+    kernel_ids->maxCompressedSize(gio::Type::Int64, sizeof(long), nb_ids)
+  );
+  if (kernel_ids->compress(
+        {uid.data(), local_id_bytes[1]}, inflate, gio::Type::Int64, sizeof(long), nb_ids
+      ) == EXIT_SUCCESS)
+    local_id_bytes[0] = kernel_ids->getBytes();
+  kernel_ids->close();
+
+  MPI_Reduce(local_id_bytes, total_id_bytes, 2, MPI_UNSIGNED_LONG, MPI_SUM, 0, comm);
+  if (my_rank == 0) {
+    std::printf(" \u2022 id raw: %lu, zip: %lu\n", total_id_bytes[1], total_id_bytes[0]);
+    std::printf(" \u2022 id rate: %.3f\n", total_id_bytes[1] / double(total_id_bytes[0]));
+    std::fflush(stdout);
+  }
+
   std::vector<float> v[dim];
   for (int i = 0; i < dim; ++i) {
     v[i].reserve(local_particles);
@@ -750,12 +750,58 @@ void Density::dump() {
   MPI_Barrier(comm);
 }
 
+/* -------------------------------------------------------------------------- */
+void Density::computeReferenceSpectrum() {
+
+  // the box is that of the input unless given
+  if (spectrum_box <= 0.)
+    spectrum_box = ioMgr->phys_scale[0];
+
+  if (my_rank == 0)
+    std::cout << "Computing reference power spectrum ... " << std::flush;
+
+  if (not spectrum_reference.empty()) {
+    spectral = reference.load(spectrum_reference);
+  } else {
+    reference = PowerSpectrum(spectrum_cells, spectrum_box, comm);
+    spectral = reference.compute(
+      coords[0].data(), coords[1].data(), coords[2].data(), local_particles
+    );
+    if (spectral and my_rank == 0 and not output_spectrum.empty())
+      reference.dump(output_spectrum + "_input.dat");
+  }
+
+  if (my_rank == 0)
+    std::cout << (spectral ? "done" : "skipped") << std::endl;
+}
+
+/* -------------------------------------------------------------------------- */
+void Density::compareSpectrum() {
+
+  PowerSpectrum spectrum(spectrum_cells, spectrum_box, comm);
+  bool const computed = spectrum.compute(
+    decompressed[0].data(), decompressed[1].data(), decompressed[2].data(),
+    decompressed[0].size()
+  );
+
+  if (computed and my_rank == 0) {
+    std::printf(" \u2022 pk max deviation: %.5f\n", spectrum.compare(reference, spectrum_k_max));
+    std::fflush(stdout);
+    if (not output_spectrum.empty())
+      spectrum.dump(output_spectrum + "_zip.dat");
+  }
+}
+
 /* -------------------------------------------------------------------------- */
 void Density::run() {
 
   // step 1: load current rank dataset in memory
   cacheData();
 
+  // positions are released once compressed
+  if (spectral)
+    computeReferenceSpectrum();
+
   // step 2: compute bins and assign bits for each of them
   computeDensityBins();
 
@@ -772,6 +818,9 @@ void Density::run() {
   for (int component = 0; component < dim; ++component)
     process(component);
 
+  if (spectral)
+    compareSpectrum();
+
   // step 6: dump them
   dump();
 }
@@ -56,6 +56,10 @@ int main(int argc, char* argv[]){
   if (not tools::valid(argc, argv, my_rank, nb_ranks))
     return abort("", my_rank);
 
+#if HAVE_FFTW
+  fftw_mpi_init();
+#endif
+
   try {
     Density density(argv[1], my_rank, nb_ranks, comm);
 
@@ -66,6 +70,10 @@ int main(int argc, char* argv[]){
     return abort(exception.what(), my_rank);
   }
 
+#if HAVE_FFTW
+  fftw_mpi_cleanup();
+#endif
+
   // everything was ok
   MPI_Finalize();
   return EXIT_SUCCESS;
@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+#include <sys/stat.h>
+#include "io/cache.h"
+#include "io/CRC64.h"
+#include "utils/json.h"
+#include "utils/tools.h"
+/* -------------------------------------------------------------------------- */
+namespace {
+
+  std::string toHex(uint64_t value) {
+    char text[17];
+    std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(value));
+    return text;
+  }
+
+  // text known by rank 0 only is sent to every rank
+  void broadcast(std::string& text, MPI_Comm comm) {
+    unsigned long length = text.size();
+    MPI_Bcast(&length, 1, MPI_UNSIGNED_LONG, 0, comm);
+    text.resize(length);
+    if (length > 0)
+      MPI_Bcast(&text[0], static_cast<int>(length), MPI_CHAR, 0, comm);
+  }
+
+  // written aside then renamed, so that readers never see partial files
+  bool write(std::string const& path, void const* data, size_t bytes) {
+    std::string const temp = path + ".tmp";
+    std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+    file.write(static_cast<char const*>(data), bytes);
+    file.close();
+    return file.good() and std::rename(temp.c_str(), path.c_str()) == 0;
+  }
+
+  bool read(std::string const& path, std::string& content) {
+    std::ifstream file(path, std::ios::binary);
+    if (not file.good())
+      return false;
+    content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+ResultCache::ResultCache(std::string in_folder, MPI_Comm in_comm)
+  : folder(std::move(in_folder)),
+    comm(in_comm) {
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nb_ranks);
+}
+
+/* -------------------------------------------------------------------------- */
+bool ResultCache::open(std::string const& input) {
+
+  // the version is set at configure time, so the running binary itself
+  // tells apart builds of other or locally edited code.
+  std::string binary;
+  if (rank == 0 and read("/proc/self/exe", binary))
+    build = toHex(crc64_omp(binary.data(), binary.size()));
+  broadcast(build, comm);
+
+  // the input file is identified by its path, size and modification time
+  std::string identity;
+  if (rank == 0) {
+    struct stat info;
+    if (tools::createFolder(folder) and stat(input.c_str(), &info) == 0) {
+      identity = input + ":" + std::to_string(info.st_size) + ":" + std::to_string(info.st_mtime);
+      identity += ":" + std::to_string(nb_ranks);
+    } else {
+      std::cerr << "Cache disabled: unable to use " << folder << " for " << input << std::endl;
+    }
+  }
+
+  broadcast(identity, comm);
+  if (identity.empty())
+    return false;
+
+  fields_path = folder + "/fields_" + toHex(crc64(identity.data(), identity.size())) + ".json";
+
+  std::string text;
+  if (rank == 0)
+    read(fields_path, text);
+  broadcast(text, comm);
+
+  checksums.clear();
+  if (not text.empty()) {
+    auto const known = nlohmann::json::parse(text);
+    for (auto it = known["fields"].begin(); it != known["fields"].end(); ++it)
+      checksums[it.key()] = std::stoull(it.value().get<std::string>(), nullptr, 16);
+  }
+  return true;
+}
+
+/* -------------------------------------------------------------------------- */
+bool ResultCache::getChecksum(std::string const& field, uint64_t& crc) const {
+  auto const found = checksums.find(field);
+  if (found == checksums.end())
+    return false;
+
+  crc = found->second;
+  return true;
+}
+
+/* -------------------------------------------------------------------------- */
+uint64_t ResultCache::setChecksum(std::string const& field, void const* data, size_t bytes) {
+
+  // the checksum of a field depends on its partition
+  uint64_t local = crc64_omp(data, bytes);
+  std::vector<uint64_t> all(nb_ranks);
+  MPI_Allgather(&local, 1, MPI_UINT64_T, all.data(), 1, MPI_UINT64_T, comm);
+
+  uint64_t const crc = crc64(all.data(), all.size() * sizeof(uint64_t));
+  checksums[field] = crc;
+
+  if (rank == 0) {
+    nlohmann::json known;
+    for (auto&& current : checksums)
+      known["fields"][current.first] = toHex(current.second);
+    std::string const text = known.dump(2);
+    write(fields_path, text.data(), text.size());
+  }
+  return crc;
+}
+
+/* -------------------------------------------------------------------------- */
+std::string ResultCache::getKey(std::string const& description) {
+
+  std::string full = "version=" HELIOS_VERSION ";build=" + build;
+  full += ";ranks=" + std::to_string(nb_ranks);
+  full += ";" + description;
+
+  auto const key = toHex(crc64(full.data(), full.size()));
+  descriptions[key] = full;
+  return key;
+}
+
+/* -------------------------------------------------------------------------- */
+bool ResultCache::find(std::string const& key, Entry& entry, bool need_payload, Buffer& payload) {
+
+  std::string text;
+  if (rank == 0)
+    read(folder + "/" + key + ".json", text);
+  broadcast(text, comm);
+
+  if (text.empty())
+    return false;
+
+  // the whole description is compared to rule out key collisions
+  auto const stored = nlohmann::json::parse(text);
+  if (stored["description"] != descriptions[key])
+    return false;
+
+  entry.row = stored["row"].get<std::string>();
+  entry.info = stored["info"].get<std::string>();
+  entry.type = static_cast<gio::Type>(stored["type"].get<int>());
+  entry.type_size = stored["type_size"];
+  entry.payload = stored["payload"];
+
+  if (not need_payload)
+    return true;
+
+  // payload file: [extents][bytes]
+  bool valid = entry.payload;
+  if (valid) {
+    std::string content;
+    std::string const path = folder + "/" + key + "_" + std::to_string(rank) + ".bin";
+    valid = read(path, content) and content.size() >= sizeof(entry.n);
+
+    if (valid) {
+      std::memcpy(entry.n, content.data(), sizeof(entry.n));
+      entry.bytes = content.size() - sizeof(entry.n);
+      auto* raw = payload.reserve(std::max<size_t>(1, entry.bytes)).data;
+      std::memcpy(raw, content.data() + sizeof(entry.n), entry.bytes);
+    }
+  }
+
+  int local = valid ? 1 : 0;
+  int global = 0;
+  MPI_Allreduce(&local, &global, 1, MPI_INT, MPI_MIN, comm);
+  return global == 1;
+}
+
+/* -------------------------------------------------------------------------- */
+void ResultCache::store(std::string const& key, Entry const& entry, Span payload) {
+
+  // payloads first, so that a stored report implies stored payloads
+  int local = 1;
+  if (entry.payload) {
+    std::vector<uint8_t> content(sizeof(entry.n) + payload.size);
+    std::memcpy(content.data(), entry.n, sizeof(entry.n));
+    std::memcpy(content.data() + sizeof(entry.n), payload.data, payload.size);
+    std::string const path = folder + "/" + key + "_" + std::to_string(rank) + ".bin";
+    local = write(path, content.data(), content.size()) ? 1 : 0;
+  }
+
+  int global = 0;
+  MPI_Allreduce(&local, &global, 1, MPI_INT, MPI_MIN, comm);
+
+  if (rank == 0 and global == 1) {
+    nlohmann::json stored;
+    stored["description"] = descriptions[key];
+    stored["row"] = entry.row;
+    stored["info"] = entry.info;
+    stored["type"] = static_cast<int>(entry.type);
+    stored["type_size"] = entry.type_size;
+    stored["payload"] = entry.payload;
+
+    std::string const text = stored.dump(2);
+    write(folder + "/" + key + ".json", text.data(), text.size());
+  }
+}
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,620 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include "io/container.h"
+#include "io/CRC64.h"
+#include "compressors/kernels/factory.h"
+#include "utils/json.h"
+#include "utils/tools.h"
+#include "utils/timer.h"
+/* -------------------------------------------------------------------------- */
+namespace {
+
+  constexpr char magic[8] = {'H', 'E', 'L', 'I', 'O', 'S', 'Z', '\0'};
+  constexpr uint64_t version = 1;
+
+  struct Preamble {
+    char magic[8];
+    uint64_t version;
+    uint64_t metadata;          // size in bytes
+    uint64_t index;             // offset in bytes
+  };
+
+  // MPI counts are plain ints: collective accesses are split in pieces,
+  // every rank doing the same number of calls even with nothing to move.
+  constexpr size_t max_piece = size_t(1) << 30;
+
+  template <typename Access>
+  bool collective(MPI_Comm comm, size_t bytes, Access&& access) {
+    uint64_t local = (bytes + max_piece - 1) / max_piece;
+    uint64_t pieces = 0;
+    MPI_Allreduce(&local, &pieces, 1, MPI_UINT64_T, MPI_MAX, comm);
+
+    bool valid = true;
+    for (uint64_t k = 0; k < pieces; ++k) {
+      size_t const first = k * max_piece;
+      size_t const length = first < bytes ? std::min(max_piece, bytes - first) : 0;
+      valid &= (access(length > 0 ? first : 0, static_cast<int>(length)) == MPI_SUCCESS);
+    }
+    return valid;
+  }
+
+  // every rank agrees on the result
+  bool agree(bool valid, MPI_Comm comm) {
+    int local = valid ? 1 : 0;
+    int global = 0;
+    MPI_Allreduce(&local, &global, 1, MPI_INT, MPI_MIN, comm);
+    return global == 1;
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+ContainerWriter::ContainerWriter(std::string in_path, MPI_Comm in_comm)
+  : path(std::move(in_path)),
+    comm(in_comm) {}
+
+/* -------------------------------------------------------------------------- */
+void ContainerWriter::setPhysics(double const* origin, double const* scale, int const* partition) {
+  std::copy(origin, origin + 3, phys_orig);
+  std::copy(scale, scale + 3, phys_scale);
+  std::copy(partition, partition + 3, mpi_partition);
+}
+
+/* -------------------------------------------------------------------------- */
+void ContainerWriter::add(ContainerField const& field, size_t const* n, Span payload) {
+
+  ContainerEntry entry;
+  entry.offset = payloads.size();
+  entry.bytes = payload.size;
+  entry.crc = crc64_omp(payload.data, payload.size);
+  std::copy(n, n + 5, entry.n);
+
+  auto const* raw = static_cast<uint8_t const*>(payload.data);
+  payloads.insert(payloads.end(), raw, raw + payload.size);
+  entries.push_back(entry);
+  fields.push_back(field);
+}
+
+/* -------------------------------------------------------------------------- */
+bool ContainerWriter::write() {
+
+  Timer timer;
+  timer.start();
+
+  int rank = 0;
+  int nb_ranks = 1;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nb_ranks);
+
+  // metadata is identical on every rank
+  nlohmann::json metadata;
+  metadata["version"] = version;
+  metadata["ranks"] = nb_ranks;
+  metadata["origin"] = std::vector<double>(phys_orig, phys_orig + 3);
+  metadata["scale"] = std::vector<double>(phys_scale, phys_scale + 3);
+  metadata["partition"] = std::vector<int>(mpi_partition, mpi_partition + 3);
+  metadata["fields"] = nlohmann::json::array();
+
+  for (auto&& field : fields) {
+    nlohmann::json current;
+    current["name"] = field.name;
+    current["members"] = field.members;
+    current["layout"] = field.interleave ? "interleave" : "stack";
+    current["kernel"] = field.kernel;
+    current["type"] = static_cast<int>(field.type);
+    current["type_size"] = field.type_size;
+    current["params"] = nlohmann::json::object();
+    for (auto&& param : field.params)
+      current["params"][param.first] = param.second;
+    metadata["fields"].push_back(current);
+  }
+
+  std::string const text = metadata.dump();
+  uint64_t const nb_fields = fields.size();
+  uint64_t const index_offset = sizeof(Preamble) + text.size();
+  uint64_t const data_offset = index_offset + nb_ranks * nb_fields * sizeof(ContainerEntry);
+
+  // payloads of each rank start after the ones of lower ranks
+  uint64_t local_bytes = payloads.size();
+  uint64_t base = 0;
+  MPI_Exscan(&local_bytes, &base, 1, MPI_UINT64_T, MPI_SUM, comm);
+  if (rank == 0)
+    base = 0;
+
+  for (auto&& entry : entries)
+    entry.offset += data_offset + base;
+
+  MPI_File file;
+  int status = MPI_File_open(
+    comm, path.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file
+  );
+
+  if (not agree(status == MPI_SUCCESS, comm)) {
+    if (rank == 0)
+      std::cerr << "Unable to create container: " << path << std::endl;
+    if (status == MPI_SUCCESS)
+      MPI_File_close(&file);
+    return false;
+  }
+
+  MPI_File_set_size(file, 0);
+  bool valid = true;
+
+  if (rank == 0) {
+    Preamble preamble {};
+    std::memcpy(preamble.magic, magic, sizeof(magic));
+    preamble.version = version;
+    preamble.metadata = text.size();
+    preamble.index = index_offset;
+
+    MPI_Status state;
+    valid &= MPI_File_write_at(
+      file, 0, &preamble, sizeof(Preamble), MPI_BYTE, &state
+    ) == MPI_SUCCESS;
+    valid &= MPI_File_write_at(
+      file, sizeof(Preamble), text.data(), static_cast<int>(text.size()), MPI_BYTE, &state
+    ) == MPI_SUCCESS;
+  }
+
+  auto const* index = reinterpret_cast<uint8_t const*>(entries.data());
+  MPI_Offset const index_start = index_offset + rank * nb_fields * sizeof(ContainerEntry);
+  valid &= collective(comm, entries.size() * sizeof(ContainerEntry), [&](size_t first, int length) {
+    MPI_Status state;
+    return MPI_File_write_at_all(
+      file, index_start + first, index + first, length, MPI_BYTE, &state
+    );
+  });
+
+  MPI_Offset const data_start = data_offset + base;
+  valid &= collective(comm, payloads.size(), [&](size_t first, int length) {
+    MPI_Status state;
+    return MPI_File_write_at_all(
+      file, data_start + first, payloads.data() + first, length, MPI_BYTE, &state
+    );
+  });
+
+  MPI_File_close(&file);
+  timer.stop();
+
+  uint64_t total_bytes = 0;
+  MPI_Reduce(&local_bytes, &total_bytes, 1, MPI_UINT64_T, MPI_SUM, 0, comm);
+
+  log.str("");
+  log << "ContainerWriter::write " << path << ": " << nb_fields << " fields, ";
+  log << total_bytes << " bytes of payloads in " << timer.getDuration() << " s" << std::endl;
+
+  if (not agree(valid, comm)) {
+    if (rank == 0)
+      std::cerr << "Unable to write container: " << path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/* -------------------------------------------------------------------------- */
+ContainerReader::ContainerReader(std::string in_path, MPI_Comm in_comm)
+  : path(std::move(in_path)),
+    comm(in_comm) {}
+
+/* -------------------------------------------------------------------------- */
+ContainerReader::~ContainerReader() { close(); }
+
+/* -------------------------------------------------------------------------- */
+void ContainerReader::close() {
+  if (file != MPI_FILE_NULL)
+    MPI_File_close(&file);
+  file = MPI_FILE_NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+bool ContainerReader::open() {
+
+  int rank = 0;
+  int nb_ranks = 1;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nb_ranks);
+
+  int status = MPI_File_open(comm, path.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &file);
+  if (not agree(status == MPI_SUCCESS, comm)) {
+    if (rank == 0)
+      std::cerr << "Unable to open container: " << path << std::endl;
+    if (status == MPI_SUCCESS)
+      close();
+    file = MPI_FILE_NULL;
+    return false;
+  }
+
+  // metadata is read once and broadcast
+  Preamble preamble {};
+  std::string text;
+
+  if (rank == 0) {
+    MPI_Status state;
+    MPI_File_read_at(file, 0, &preamble, sizeof(Preamble), MPI_BYTE, &state);
+    bool const valid = std::memcmp(preamble.magic, magic, sizeof(magic)) == 0
+                   and preamble.version == version;
+    if (valid) {
+      text.resize(preamble.metadata);
+      MPI_File_read_at(
+        file, sizeof(Preamble), &text[0], static_cast<int>(text.size()), MPI_BYTE, &state
+      );
+    } else {
+      preamble.metadata = 0;
+      std::cerr << "Invalid container: " << path << std::endl;
+    }
+  }
+
+  MPI_Bcast(&preamble, sizeof(Preamble), MPI_BYTE, 0, comm);
+  if (preamble.metadata == 0) {
+    close();
+    return false;
+  }
+
+  text.resize(preamble.metadata);
+  MPI_Bcast(&text[0], static_cast<int>(text.size()), MPI_CHAR, 0, comm);
+
+  auto const metadata = nlohmann::json::parse(text);
+  int const nb_writers = metadata["ranks"];
+
+  for (int d = 0; d < 3; ++d) {
+    phys_orig[d] = metadata["origin"][d];
+    phys_scale[d] = metadata["scale"][d];
+    mpi_partition[d] = metadata["partition"][d];
+  }
+
+  fields.clear();
+  for (auto&& current : metadata["fields"]) {
+    ContainerField field;
+    field.name = current["name"].get<std::string>();
+    for (auto&& member : current["members"])
+      field.members.push_back(member);
+    field.interleave = current["layout"] == "interleave";
+    field.kernel = current["kernel"].get<std::string>();
+    field.type = static_cast<gio::Type>(current["type"].get<int>());
+    field.type_size = current["type_size"];
+    for (auto it = current["params"].begin(); it != current["params"].end(); ++it)
+      field.params[it.key()] = it.value().get<std::string>();
+    fields.push_back(field);
+  }
+
+  if (nb_ranks > nb_writers) {
+    if (rank == 0)
+      std::cerr << "Use <= MPI ranks than container ranks: " << nb_writers << std::endl;
+    close();
+    return false;
+  }
+
+  // blocks of consecutive writer ranks are assigned to each reader rank
+  int const first = static_cast<int>(static_cast<long>(rank) * nb_writers / nb_ranks);
+  int const last = static_cast<int>(static_cast<long>(rank + 1) * nb_writers / nb_ranks);
+  size_t const nb_fields = fields.size();
+
+  nb_blocks = last - first;
+  MPI_Allreduce(&nb_blocks, &max_blocks, 1, MPI_INT, MPI_MAX, comm);
+
+  entries.resize(nb_blocks * nb_fields);
+  auto* index = reinterpret_cast<uint8_t*>(entries.data());
+  MPI_Offset const start = preamble.index + first * nb_fields * sizeof(ContainerEntry);
+
+  bool const valid = collective(comm, entries.size() * sizeof(ContainerEntry), [&](size_t from, int length) {
+    MPI_Status state;
+    return MPI_File_read_at_all(file, start + from, index + from, length, MPI_BYTE, &state);
+  });
+
+  log.str("");
+  log << "ContainerReader::open " << path << ": " << nb_fields << " fields, ";
+  log << "writer ranks [" << first << ", " << last << ")" << std::endl;
+
+  if (not agree(valid, comm)) {
+    if (rank == 0)
+      std::cerr << "Unable to read container index: " << path << std::endl;
+    close();
+    return false;
+  }
+  return true;
+}
+
+/* -------------------------------------------------------------------------- */
+bool ContainerReader::read(size_t index, Buffer& output, size_t& numel) {
+
+  Timer timer;
+  timer.start();
+
+  assert(file != MPI_FILE_NULL);
+  assert(index < fields.size());
+
+  auto const& field = fields[index];
+  size_t const nb_fields = fields.size();
+  size_t const count = std::max<size_t>(1, field.members.size());
+  size_t const type_size = field.type_size;
+
+  // members are split back and stored one after the other
+  size_t total = 0;
+  for (int b = 0; b < nb_blocks; ++b)
+    total += CompressorInterface::getNumElements(entries[b * nb_fields + index].n);
+
+  numel = total / count;
+  output.reserve(std::max<size_t>(1, total * type_size));
+
+  std::unique_ptr<CompressorInterface> kernel(CompressorFactory::create(field.kernel));
+  bool valid = (kernel != nullptr);
+
+  if (valid) {
+    kernel->parameters = field.params;
+    kernel->init();
+  } else {
+    std::cerr << "Unsupported compressor: " << field.kernel << std::endl;
+  }
+
+  auto* target = static_cast<uint8_t*>(output.data());
+  size_t offset = 0;   // in elements per member
+
+  for (int b = 0; b < max_blocks; ++b) {
+    ContainerEntry entry;
+    if (b < nb_blocks)
+      entry = entries[b * nb_fields + index];
+
+    auto* raw = static_cast<uint8_t*>(payload.reserve(std::max<uint64_t>(1, entry.bytes)).data);
+    valid &= collective(comm, entry.bytes, [&](size_t first, int length) {
+      MPI_Status state;
+      return MPI_File_read_at_all(file, entry.offset + first, raw + first, length, MPI_BYTE, &state);
+    });
+
+    if (b >= nb_blocks or not valid)
+      continue;
+
+    if (crc64_omp(raw, entry.bytes) != entry.crc) {
+      std::cerr << "Checksum mismatch on field " << field.name << std::endl;
+      valid = false;
+      continue;
+    }
+
+    size_t const block_numel = CompressorInterface::getNumElements(entry.n);
+    size_t const block_bytes = block_numel * type_size;
+    size_t const member_numel = block_numel / count;
+    auto* decoded = (count == 1)
+      ? target + offset * type_size
+      : static_cast<uint8_t*>(scratch.reserve(std::max<size_t>(1, block_bytes)).data);
+
+    valid &= kernel->decompress(
+      {raw, entry.bytes}, {decoded, block_bytes}, field.type, type_size, entry.n
+    ) == EXIT_SUCCESS;
+
+    if (count > 1) {
+      for (size_t k = 0; k < count; ++k) {
+        tools::unstack(
+          decoded, k, count, member_numel, type_size, field.interleave,
+          target + (k * numel + offset) * type_size
+        );
+      }
+    }
+    offset += member_numel;
+  }
+
+  if (kernel != nullptr)
+    kernel->close();
+
+  timer.stop();
+  log.str("");
+  log << "ContainerReader::read " << field.name << ": " << numel << " elements";
+  log << " in " << timer.getDuration() << " s" << std::endl;
+
+  return agree(valid, comm);
+}
+
+/* -------------------------------------------------------------------------- */
+bool ContainerReader::fetch(uint64_t offset, void* data, size_t bytes) {
+
+  auto* raw = static_cast<uint8_t*>(data);
+  for (size_t first = 0; first < bytes; first += max_piece) {
+    int const length = static_cast<int>(std::min(max_piece, bytes - first));
+    MPI_Status state;
+    if (MPI_File_read_at(file, offset + first, raw + first, length, MPI_BYTE, &state) != MPI_SUCCESS)
+      return false;
+  }
+  return true;
+}
+
+/* -------------------------------------------------------------------------- */
+bool ContainerReader::readRange(size_t index, size_t first, size_t count, Buffer& output) {
+
+  Timer timer;
+  timer.start();
+
+  assert(file != MPI_FILE_NULL);
+  assert(index < fields.size());
+
+  auto const& field = fields[index];
+  size_t const nb_fields = fields.size();
+  size_t const nb_members = std::max<size_t>(1, field.members.size());
+  size_t const type_size = field.type_size;
+  bool const chunked = (field.kernel == "chunked");
+
+  size_t total = 0;
+  for (int b = 0; b < nb_blocks; ++b)
+    total += CompressorInterface::getNumElements(entries[b * nb_fields + index].n) / nb_members;
+
+  if (first + count > total) {
+    std::cerr << "Invalid range on field " << field.name << ": [" << first;
+    std::cerr << ", " << first + count << ") out of " << total << " rows" << std::endl;
+    return false;
+  }
+
+  // members are split back and stored one after the other
+  output.reserve(std::max<size_t>(1, count * nb_members * type_size));
+
+  std::unique_ptr<CompressorInterface> kernel(CompressorFactory::create(field.kernel));
+  if (kernel == nullptr) {
+    std::cerr << "Unsupported compressor: " << field.kernel << std::endl;
+    return false;
+  }
+
+  kernel->parameters = field.params;
+  kernel->init();
+
+  auto* target = static_cast<uint8_t*>(output.data());
+  size_t fetched = 0;
+  size_t offset = 0;   // rows of the previous blocks
+  bool valid = true;
+
+  for (int b = 0; b < nb_blocks and valid; ++b) {
+    auto const& entry = entries[b * nb_fields + index];
+    size_t const rows = CompressorInterface::getNumElements(entry.n) / nb_members;
+    size_t const lower = std::max(first, offset);
+    size_t const upper = std::min(first + count, offset + rows);
+    offset += rows;
+
+    if (lower >= upper)
+      continue;
+
+    // element ranges of the block holding these rows
+    size_t const start = lower - (offset - rows);
+    size_t const length = upper - lower;
+    bool const stacked = (nb_members > 1 and not field.interleave);
+    size_t const nb_ranges = stacked ? nb_members : 1;
+    size_t const spread = stacked ? 1 : nb_members;
+
+    // the chunk index is fetched once per block, and whole payloads only
+    // for kernels without one
+    Span stream {};
+    std::vector<uint8_t> head;
+    if (chunked) {
+      uint8_t preamble[ChunkedCompressor::preamble];
+      valid = fetch(entry.offset, preamble, sizeof(preamble));
+
+      size_t const head_size = ChunkedCompressor::getHeadSize({preamble, sizeof(preamble)});
+      head.resize(head_size);
+      valid = valid and head_size > 0 and head_size <= entry.bytes
+          and fetch(entry.offset, head.data(), head_size);
+      fetched += head_size;
+      if (not valid) {
+        std::cerr << "Invalid chunk index on field " << field.name << std::endl;
+        break;
+      }
+    } else {
+      stream = payload.reserve(std::max<uint64_t>(1, entry.bytes));
+      stream.size = entry.bytes;
+      valid = fetch(entry.offset, stream.data, entry.bytes)
+          and crc64_omp(stream.data, entry.bytes) == entry.crc;
+      fetched += entry.bytes;
+      if (not valid) {
+        std::cerr << "Checksum mismatch on field " << field.name << std::endl;
+        break;
+      }
+    }
+
+    // kernels decoding everything anyway decode the block once for all
+    // members, which are then copied out of it
+    if (stacked and not chunked and kernel->getRangeBlock() == 0) {
+      size_t const block_bytes = rows * nb_members * type_size;
+      auto* whole = static_cast<uint8_t*>(scratch.reserve(block_bytes).data);
+      size_t dims[5];
+      std::copy(entry.n, entry.n + 5, dims);
+
+      valid = kernel->decompress(stream, {whole, block_bytes}, field.type, type_size, dims) == EXIT_SUCCESS;
+      for (size_t k = 0; k < nb_members and valid; ++k) {
+        std::memcpy(
+          target + (k * count + lower - first) * type_size,
+          whole + (k * rows + start) * type_size, length * type_size
+        );
+      }
+      continue;
+    }
+
+    auto* decoded = (nb_members > 1 and field.interleave)
+      ? static_cast<uint8_t*>(scratch.reserve(length * nb_members * type_size).data)
+      : nullptr;
+
+    for (size_t k = 0; k < nb_ranges and valid; ++k) {
+      size_t const from = stacked ? k * rows + start : start * spread;
+      size_t const size = length * spread;
+      uint8_t* into = decoded != nullptr
+        ? decoded : target + (k * count + lower - first) * type_size;
+      size_t dims[5];
+      std::copy(entry.n, entry.n + 5, dims);
+
+      if (chunked) {
+        // only the chunks covering the range are fetched
+        ChunkedCompressor::Slice slice;
+        valid = ChunkedCompressor::slice({head.data(), head.size()}, from, size, slice)
+            and slice.end <= entry.bytes;
+
+        if (not valid) {
+          std::cerr << "Invalid chunk index on field " << field.name << std::endl;
+          break;
+        }
+
+        size_t const bytes = slice.head.size() + slice.end - slice.begin;
+        stream = payload.reserve(bytes);
+        stream.size = bytes;
+        auto* raw = static_cast<uint8_t*>(stream.data);
+        std::memcpy(raw, slice.head.data(), slice.head.size());
+        valid = fetch(entry.offset + slice.begin, raw + slice.head.size(), slice.end - slice.begin);
+        fetched += slice.end - slice.begin;
+
+        dims[0] = slice.numel;
+        dims[1] = dims[2] = dims[3] = dims[4] = 0;
+        valid = valid and kernel->decompressRange(
+          stream, {into, size * type_size}, field.type, type_size, dims, slice.first, size
+        ) == EXIT_SUCCESS;
+      } else {
+        valid = kernel->decompressRange(
+          stream, {into, size * type_size}, field.type, type_size, dims, from, size
+        ) == EXIT_SUCCESS;
+      }
+    }
+
+    if (decoded != nullptr and valid) {
+      for (size_t k = 0; k < nb_members; ++k) {
+        tools::unstack(
+          decoded, k, nb_members, length, type_size, true,
+          target + (k * count + lower - first) * type_size
+        );
+      }
+    }
+  }
+
+  kernel->close();
+
+  timer.stop();
+  log.str("");
+  log << "ContainerReader::readRange " << field.name << ": [" << first << ", ";
+  log << first + count << ") of " << total << " rows, " << fetched << " bytes read";
+  log << " in " << timer.getDuration() << " s" << std::endl;
+
+  return valid;
+}
+/* -------------------------------------------------------------------------- */
@@ -42,6 +42,9 @@ void HACCDataLoader::init(std::string in_file, MPI_Comm _comm) {
 
   MPI_Comm_size(comm, &nb_ranks);
   MPI_Comm_rank(comm, &rank);
+
+  // header of a previous file is stale
+  closeReader();
 }
 
 /* -------------------------------------------------------------------------- */
@@ -50,35 +53,67 @@ bool HACCDataLoader::close() {
 }
 
 /* -------------------------------------------------------------------------- */
-bool HACCDataLoader::saveParams(){
-
-  gio::GenericIO gioReader(comm, filename);
-  std::vector<gio::GenericIO::VariableInfo> VI;
+void HACCDataLoader::closeReader() {
+
+  // communicators of the reader are gone once MPI is finalized
+  int finalized = 0;
+  MPI_Finalized(&finalized);
+  if (finalized)
+    reader.release();
+
+  reader.reset();
+  variables.clear();
+  rank_elems.clear();
+  rank_coords.clear();
+}
 
-  // open file
-  gioReader.openAndReadHeader(gio::GenericIO::MismatchRedistribute);
-  int numDataRanks = gioReader.readNRanks();
+/* -------------------------------------------------------------------------- */
+bool HACCDataLoader::open() {
+
+  if (not reader) {
+    reader = std::make_unique<gio::GenericIO>(comm, filename);
+    reader->openAndReadHeader(gio::GenericIO::MismatchRedistribute);
+
+    // get dimensions of the input file, the scalars information
+    // and the particles count and location of every data rank.
+    nb_data_ranks = reader->readNRanks();
+    reader->readDims(split_dims);
+    reader->readPhysOrigin(phys_orig);
+    reader->readPhysScale(phys_scale);
+    reader->getVariableInfo(variables);
+
+    rank_elems.resize(nb_data_ranks);
+    rank_coords.resize(nb_data_ranks);
+    for (int i = 0; i < nb_data_ranks; ++i) {
+      rank_elems[i] = reader->readNumElems(i);
+      reader->readCoords(rank_coords[i].data(), i);
+    }
+  }
 
-  if (nb_ranks > numDataRanks) {
-    std::cout << "Num data ranks: " << numDataRanks;
+  if (nb_ranks > nb_data_ranks) {
+    std::cout << "Num data ranks: " << nb_data_ranks;
     std::cout << "Use <= MPI ranks than data ranks" << std::endl;
     return false;
   }
 
-  // get dimensions of the input file
-  // and read in the scalars information
-  gioReader.readPhysOrigin(phys_orig);
-  gioReader.readPhysScale(phys_scale);
-  gioReader.getVariableInfo(VI);
+  return true;
+}
+
+/* -------------------------------------------------------------------------- */
+bool HACCDataLoader::saveParams(){
 
-  int numVars = static_cast<int>(VI.size());
+  if (not open())
+    return false;
+
+  int numVars = static_cast<int>(variables.size());
 
   for (int i = 0; i < numVars; i++) {
+    auto const& VI = variables[i];
     gio::Data readInData;
     readInData.init(
-      i, VI[i].Name, static_cast<int>(VI[i].Size),
-      VI[i].IsFloat, VI[i].IsSigned,
-      VI[i].IsPhysCoordX, VI[i].IsPhysCoordY, VI[i].IsPhysCoordZ
+      i, VI.Name, static_cast<int>(VI.Size),
+      VI.IsFloat, VI.IsSigned,
+      VI.IsPhysCoordX, VI.IsPhysCoordY, VI.IsPhysCoordZ
     );
 
     readInData.determineDataType();
@@ -89,192 +124,206 @@ bool HACCDataLoader::saveParams(){
 }
 
 /* -------------------------------------------------------------------------- */
-bool HACCDataLoader::load(std::string paramName) {
+void HACCDataLoader::assignRanks(int range[2]) const {
+  // split data ranks among MPI ranks
+  int const numDataRanksPerMPIRank = nb_data_ranks / nb_ranks;
+  range[0] = rank * numDataRanksPerMPIRank;
+  range[1] = (rank + 1) * numDataRanksPerMPIRank;
+  if (rank == nb_ranks - 1)
+    range[1] = nb_data_ranks;
+}
 
-  Timer clock;
-  clock.start();
+/* -------------------------------------------------------------------------- */
+void HACCDataLoader::trackExtents(int data_rank, int min[3], int max[3]) {
 
-  log.str("");
-  param = paramName;
+  int const* coords = rank_coords[data_rank].data();
+  log << "Coord indices: " << coords[0] << ", " << coords[1] << ", " << coords[2] << " | ";
 
-  // Init GenericIO reader + open file
-  gio::GenericIO gioReader(comm, filename);
-  std::vector<gio::GenericIO::VariableInfo> VI;
+  double cur[3], nxt[3];
+  for (int j = 0; j < 3; ++j) {
+    cur[j] = float(coords[j]) / split_dims[j] * phys_scale[j] + phys_orig[j];
+    nxt[j] = float(coords[j] + 1) / split_dims[j] * phys_scale[j] + phys_orig[j];
+  }
 
-  // Open file
-  gioReader.openAndReadHeader(gio::GenericIO::MismatchRedistribute);
-  int numDataRanks = gioReader.readNRanks();
+  log << "coordinates: (";
+  log << cur[0] <<", "<< cur[1] <<", "<< cur[2] <<") -> ";
+  log << nxt[0] <<", "<< nxt[1] <<", "<< nxt[2] <<")" << std::endl;
 
-  if (nb_ranks > numDataRanks) {
-    std::cout << "Num data ranks: " << numDataRanks;
-    std::cout << "Use <= MPI ranks than data ranks" << std::endl;
-    return false;
+  if (do_dump) {
+    for (int j = 0; j < 3; ++j) {
+      min[j] = std::min(static_cast<int>(cur[j]), min[j]);
+      max[j] = std::max(static_cast<int>(nxt[j]), max[j]);
+    }
   }
+}
 
-  // Count number of elements
-  total_nb_elems = 0;
-  for (int i = 0; i < numDataRanks; ++i)
-    total_nb_elems += gioReader.readNumElems(i);
+/* -------------------------------------------------------------------------- */
+void HACCDataLoader::saveExtents(int const min[3], int const max[3]) {
 
-  // Read in the scalars information
-  gioReader.getVariableInfo(VI);
-  int numVars = static_cast<int>(VI.size());
-  bool paramToLoad = false;
+  if (not do_dump)
+    return;
 
-  gio::Data readInData;
-  for (int i = 0; i < numVars; i++) {
-    if (VI[i].Name == paramName) {
-      readInData.init(
-        i, VI[i].Name, static_cast<int>(VI[i].Size),
-        VI[i].IsFloat, VI[i].IsSigned,
-        VI[i].IsPhysCoordX, VI[i].IsPhysCoordY, VI[i].IsPhysCoordZ
-      );
-
-      readInData.determineDataType();
-      data_type = readInData.data_type;
-      elem_size = readInData.size;
-      paramToLoad = true;
-      break;
-    }
-  }
+  int x_range = max[0] - min[0];
+  int y_range = max[1] - min[1];
+  int z_range = max[2] - min[2];
 
-  if (not paramToLoad) {
-    std::cout << "Cannot find that parameter, exiting now!";
-    return false;
-  }
+  data_extents[0] = std::make_pair(min[0], max[0]);
+  data_extents[1] = std::make_pair(min[1], max[1]);
+  data_extents[2] = std::make_pair(min[2], max[2]);
 
-  //
-  // Split ranks among data
-  int numDataRanksPerMPIRank = numDataRanks / nb_ranks;
-  int loadRange[2];
-  loadRange[0] = rank * numDataRanksPerMPIRank;
-  loadRange[1] = (rank + 1) * numDataRanksPerMPIRank;
-  if (rank == nb_ranks - 1)
-    loadRange[1] = numDataRanks;
+  mpi_partition[0] = static_cast<int>(phys_scale[0] / x_range);
+  mpi_partition[1] = static_cast<int>(phys_scale[1] / y_range);
+  mpi_partition[2] = static_cast<int>(phys_scale[2] / z_range);
 
-  int splitDims[3];
-  gioReader.readDims(splitDims);
-  log << "splitDims: "
-      << splitDims[0] << ","
-      << splitDims[1] << ","
-      << splitDims[2] << std::endl;
+  log << "\t[x_min, x_max]: [" << min[0] << ", " << max[0] << "]" << std::endl;
+  log << "\t[y_min, y_max]: [" << min[1] << ", " << max[1] << "]" << std::endl;
+  log << "\t[z_min, z_max]: [" << min[2] << ", " << max[2] << "]" << std::endl;
 
-  //
-  // Determine memory size and allocate memory
-  size_t maxNumElementsPerRank = 0;
-  local_nb_elems = 0;
-  for (int i = loadRange[0]; i < loadRange[1]; i++) {
-    local_nb_elems += gioReader.readNumElems(i);
-    maxNumElementsPerRank = std::max(maxNumElementsPerRank, local_nb_elems);
-  }
+  log << "mpiCartPartitions: ";
+  log << mpi_partition[0] << ", "
+      << mpi_partition[1] << ", "
+      << mpi_partition[2] << std::endl;
+}
+
+/* -------------------------------------------------------------------------- */
+gio::GenericIO::VariableInfo const* HACCDataLoader::find(std::string const& name) const {
+  for (auto const& VI : variables)
+    if (VI.Name == name)
+      return &VI;
+  return nullptr;
+}
+
+/* -------------------------------------------------------------------------- */
+size_t HACCDataLoader::padding(size_t elem_size) {
+  // GenericIO needs room for the 8-byte checksum right after a block
+  return (8 + elem_size - 1) / elem_size;
+}
+
+/* -------------------------------------------------------------------------- */
+void HACCDataLoader::countElements(int const range[2]) {
 
-  Memory::allocate(data, data_type, local_nb_elems, 0);
+  total_nb_elems = 0;
+  for (int i = 0; i < nb_data_ranks; ++i)
+    total_nb_elems += rank_elems[i];
+
+  local_nb_elems = 0;
+  for (int i = range[0]; i < range[1]; i++)
+    local_nb_elems += rank_elems[i];
 
-  readInData.setNumElements(maxNumElementsPerRank);
-  readInData.allocate(1);
   size_per_dim[0] = local_nb_elems;	// For compression
 
+  log << "splitDims: "
+      << split_dims[0] << ","
+      << split_dims[1] << ","
+      << split_dims[2] << std::endl;
   log << "totalNumberOfElements: " << total_nb_elems << std::endl;
   log << "numElements: " << local_nb_elems << std::endl;
+}
+
+/* -------------------------------------------------------------------------- */
+void HACCDataLoader::readBlocks(int const range[2],
+                                std::vector<gio::GenericIO::VariableInfo const*> const& infos,
+                                std::vector<char*> const& targets) {
 
-  //
-  // Actually load the data
   int min[] = {INT_MAX, INT_MAX, INT_MAX};
   int max[] = {INT_MIN, INT_MIN, INT_MIN};
 
+  // every column of a data rank block is read in a single pass,
+  // straight at its offset in the destination storage.
   size_t offset = 0;
-  // for each rank
-  for (int i = loadRange[0]; i < loadRange[1]; i++) {
-
-    size_t Np = gioReader.readNumElems(i);
+  for (int i = range[0]; i < range[1]; i++) {
+    size_t const Np = rank_elems[i];
+    trackExtents(i, min, max);
+
+    reader->clearVariables();
+    for (size_t c = 0; c < infos.size(); ++c) {
+      char* target = targets[c] + offset * infos[c]->Size;
+      reader->addVariable(*infos[c], target, gio::GenericIO::VarHasExtraSpace);
+    }
 
-    int coords[3];
-    gioReader.readCoords(coords, i);
-    log << "Coord indices: " << coords[0] << ", " << coords[1] << ", " << coords[2] << " | ";
+    reader->readDataSection(0, Np, i, false); // reading the whole block
+    offset += Np;
+  }
 
-    double cur[3], nxt[3];
-    for (int j = 0; j < 3; ++j) {
-      cur[j] = float(coords[j]) / splitDims[j] * phys_scale[j] + phys_orig[j];
-      nxt[j] = float(coords[j] + 1) / splitDims[j] * phys_scale[j] + phys_orig[j];
-    }
+  reader->clearVariables();
+  saveExtents(min, max);
+}
 
-    log << "coordinates: (";
-    log << cur[0] <<", "<< cur[1] <<", "<< cur[2] <<") -> ";
-    log << nxt[0] <<", "<< nxt[1] <<", "<< nxt[2] <<")" << std::endl;
+/* -------------------------------------------------------------------------- */
+bool HACCDataLoader::load(std::string paramName) {
 
-    if (do_dump) {
-      for (int j = 0; j < 3; ++j) {
-        min[j] = std::min(static_cast<int>(cur[j]), min[j]);
-        max[j] = std::max(static_cast<int>(nxt[j]), max[j]);
-      }
-    }
+  Timer clock;
+  clock.start();
 
-    auto name = readInData.name.c_str();
-    void* raw = readInData.data;
-
-    switch (readInData.data_type) {
-      case gio::Type::Float:  gioReader.addVariable(name, (float*)    raw, true); break;
-      case gio::Type::Double: gioReader.addVariable(name, (double*)   raw, true); break;
-      case gio::Type::Int:    gioReader.addVariable(name, (int*)      raw, true); break;
-      case gio::Type::Int8:   gioReader.addVariable(name, (int8_t*)   raw, true); break;
-      case gio::Type::Int16:  gioReader.addVariable(name, (int16_t*)  raw, true); break;
-      case gio::Type::Int32:  gioReader.addVariable(name, (int32_t*)  raw, true); break;
-      case gio::Type::Int64:  gioReader.addVariable(name, (int64_t*)  raw, true); break;
-      case gio::Type::Uint8:  gioReader.addVariable(name, (uint8_t*)  raw, true); break;
-      case gio::Type::Uint16: gioReader.addVariable(name, (uint16_t*) raw, true); break;
-      case gio::Type::Uint32: gioReader.addVariable(name, (uint32_t*) raw, true); break;
-      case gio::Type::Uint64: gioReader.addVariable(name, (uint64_t*) raw, true); break;
-      default: break;
-    }
+  log.str("");
+  param = paramName;
 
-    gioReader.readDataSection(0, Np, i, false); // reading the whole file
-
-    auto const bytes = Np * readInData.size;
-
-    switch (readInData.data_type) {
-      case gio::Type::Float:  std::memcpy(&((float*)   data)[offset], raw, bytes); break;
-      case gio::Type::Double: std::memcpy(&((double*)  data)[offset], raw, bytes); break;
-      case gio::Type::Int:    std::memcpy(&((int*)     data)[offset], raw, bytes); break;
-      case gio::Type::Int8:   std::memcpy(&((int8_t*)  data)[offset], raw, bytes); break;
-      case gio::Type::Int16:  std::memcpy(&((int16_t*) data)[offset], raw, bytes); break;
-      case gio::Type::Int32:  std::memcpy(&((int32_t*) data)[offset], raw, bytes); break;
-      case gio::Type::Int64:  std::memcpy(&((int64_t*) data)[offset], raw, bytes); break;
-      case gio::Type::Uint8:  std::memcpy(&((uint8_t*) data)[offset], raw, bytes); break;
-      case gio::Type::Uint16: std::memcpy(&((uint16_t*)data)[offset], raw, bytes); break;
-      case gio::Type::Uint32: std::memcpy(&((uint32_t*)data)[offset], raw, bytes); break;
-      case gio::Type::Uint64: std::memcpy(&((uint64_t*)data)[offset], raw, bytes); break;
-      default: break;
-    }
+  // Reuse the opened file and its parsed header
+  if (not open())
+    return false;
 
-    offset = offset + Np;
+  auto const* VI = find(paramName);
+  if (VI == nullptr) {
+    std::cout << "Cannot find that parameter, exiting now!";
+    return false;
   }
 
+  gio::Data readInData;
+  readInData.init(
+    0, VI->Name, static_cast<int>(VI->Size),
+    VI->IsFloat, VI->IsSigned,
+    VI->IsPhysCoordX, VI->IsPhysCoordY, VI->IsPhysCoordZ
+  );
+  readInData.determineDataType();
+  data_type = readInData.data_type;
+  elem_size = readInData.size;
+
+  int loadRange[2];
+  assignRanks(loadRange);
+  countElements(loadRange);
+
+  // blocks are read in place, no staging buffer
+  Memory::allocate(data, data_type, local_nb_elems, padding(elem_size));
+  readBlocks(loadRange, { VI }, { static_cast<char*>(data) });
+
   clock.stop();
+  return true;
+}
 
-  if (do_dump) {
-    int x_range = max[0] - min[0];
-    int y_range = max[1] - min[1];
-    int z_range = max[2] - min[2];
-
-    data_extents[0] = std::make_pair(min[0], max[0]);
-    data_extents[1] = std::make_pair(min[1], max[1]);
-    data_extents[2] = std::make_pair(min[2], max[2]);
-
-    mpi_partition[0] = static_cast<int>(phys_scale[0] / x_range);
-    mpi_partition[1] = static_cast<int>(phys_scale[1] / y_range);
-    mpi_partition[2] = static_cast<int>(phys_scale[2] / z_range);
-
-    log << "\t[x_min, x_max]: [" << min[0] << ", " << max[0] << "]" << std::endl;
-    log << "\t[y_min, y_max]: [" << min[1] << ", " << max[1] << "]" << std::endl;
-    log << "\t[z_min, z_max]: [" << min[2] << ", " << max[2] << "]" << std::endl;
-
-    log << "mpiCartPartitions: ";
-    log << mpi_partition[0] << ", "
-        << mpi_partition[1] << ", "
-        << mpi_partition[2] << std::endl;
+/* -------------------------------------------------------------------------- */
+bool HACCDataLoader::load(std::vector<Binding> const& columns) {
+
+  log.str("");
+
+  if (columns.empty() or not open())
+    return false;
+
+  // resolve every requested column first
+  std::vector<gio::GenericIO::VariableInfo const*> infos;
+
+  for (auto&& column : columns) {
+    auto const* VI = find(column.name);
+    if (VI == nullptr or VI->Size != column.elem_size or VI->IsFloat != column.is_float) {
+      std::cout << "Cannot load parameter '" << column.name << "', exiting now!" << std::endl;
+      return false;
+    }
+    infos.push_back(VI);
   }
 
-  readInData.release();
+  int loadRange[2];
+  assignRanks(loadRange);
+  countElements(loadRange);
+
+  // size destinations with room for the checksum, then trim them
+  std::vector<char*> targets;
+  for (auto&& column : columns)
+    targets.push_back(column.resize(local_nb_elems + padding(column.elem_size)));
+
+  readBlocks(loadRange, infos, targets);
+
+  for (auto&& column : columns)
+    column.resize(local_nb_elems);
+
   return true;
 }
 
@@ -101,21 +101,19 @@ size_t Noising::cache(long offset) {
   ioMgr->saveParams();
   ioMgr->setSave(true);
 
-  for (int i=0; i < num_scalars; ++i) {
-    if (ioMgr->load(scalars[i])) {
-      auto const n = ioMgr->getNumElements();
-      auto const data = static_cast<float*>(ioMgr->data);
-      dataset[i].resize(n + offset);
-      std::copy(data, data + n, dataset[i].data() + offset);
-    }
-    MPI_Barrier(comm);
-  }
-
-  if (ioMgr->load("id")) {
-    auto const n = ioMgr->getNumElements();
-    auto const data = static_cast<long*>(ioMgr->data);
-    particles_index.resize(n + offset);
-    std::copy(data, data + n, particles_index.data() + offset);
+  // scalars and id are read in a single pass,
+  // directly after the already cached particles.
+  std::vector<HACCDataLoader::Binding> targets;
+
+  for (int i=0; i < num_scalars; ++i)
+    targets.push_back(HACCDataLoader::bind(scalars[i], dataset[i], offset));
+  targets.push_back(HACCDataLoader::bind("id", particles_index, offset));
+
+  // a single unknown or mistyped column leaves all of them unloaded
+  if (not ioMgr->load(targets)) {
+    if (my_rank == 0)
+      std::cerr << "Error: cannot load scalars and 'id' from " << ioMgr->filename << std::endl;
+    MPI_Abort(comm, EXIT_FAILURE);
   }
 
   if (my_rank == 0) {
@@ -247,23 +245,10 @@ bool Noising::computeHistogram(int i, std::vector<float> const& noise) {
   float total_max = 0.;
   std::tie(total_min, total_max) = getRange(noise);
 
-  long local_histo[num_bins];
-  long total_histo[num_bins];
-  std::fill(local_histo, local_histo + num_bins, 0);
-  std::fill(total_histo, total_histo + num_bins, 0);
-
-  double const range = total_max - total_min;
-  double const capacity = range / num_bins;
-
-  for (auto k=0; k < nb_particles; ++k) {
-    int index = static_cast<int>((noise[k] - total_min) / capacity);
-    if (index >= num_bins)
-      index--;
-
-    local_histo[index]++;
-  }
-
-  MPI_Allreduce(local_histo, total_histo, num_bins, MPI_LONG, MPI_SUM, comm);
+  Histogram histogram(num_bins, total_min, total_max);
+  histogram.add(noise.data(), nb_particles);
+  histogram.reduce(comm);
+  auto const& total_histo = histogram.getCounts();
 
   // fill result array eventually
   histo[i].clear();
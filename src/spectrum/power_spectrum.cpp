@@ -0,0 +1,346 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "spectrum/power_spectrum.h"
+/* -------------------------------------------------------------------------- */
+PowerSpectrum::PowerSpectrum(int in_nb_cells, double in_box_size, MPI_Comm in_comm)
+  : nb_cells(in_nb_cells),
+    box_size(in_box_size),
+    comm(in_comm) {
+  assert(nb_cells > 1);
+  assert(box_size > 0.);
+  MPI_Comm_rank(comm, &my_rank);
+  MPI_Comm_size(comm, &nb_ranks);
+}
+
+/* -------------------------------------------------------------------------- */
+void PowerSpectrum::deposit(float const* x, float const* y, float const* z, size_t n,
+                            double* slab, long first, long extent) {
+
+  long const cells = nb_cells;
+  long const pad = 2 * (cells / 2 + 1);
+  long const plane = cells * pad;
+  double const scale = cells / box_size;
+
+  auto const wrap = [&](double u) {
+    long const i = static_cast<long>(std::floor(u)) % cells;
+    return i < 0 ? i + cells : i;
+  };
+
+  // step 1: find the owner of each x-plane
+  long const bounds[] = {first, extent};
+  std::vector<long> slabs(2 * nb_ranks);
+  std::vector<int> owner(cells, 0);
+  MPI_Allgather(bounds, 2, MPI_LONG, slabs.data(), 2, MPI_LONG, comm);
+
+  for (int r = 0; r < nb_ranks; ++r)
+    for (long i = slabs[2 * r]; i < slabs[2 * r] + slabs[2 * r + 1]; ++i)
+      owner[i] = r;
+
+  // step 2: send particles to the owner of their first plane
+  std::vector<int> target(n);
+  std::vector<int> send_counts(nb_ranks, 0);
+  std::vector<int> recv_counts(nb_ranks, 0);
+  std::vector<int> send_offsets(nb_ranks, 0);
+  std::vector<int> recv_offsets(nb_ranks, 0);
+
+  for (size_t k = 0; k < n; ++k) {
+    target[k] = owner[wrap(x[k] * scale)];
+    send_counts[target[k]] += 3;
+  }
+
+  MPI_Alltoall(send_counts.data(), 1, MPI_INT, recv_counts.data(), 1, MPI_INT, comm);
+
+  for (int r = 1; r < nb_ranks; ++r) {
+    send_offsets[r] = send_offsets[r - 1] + send_counts[r - 1];
+    recv_offsets[r] = recv_offsets[r - 1] + recv_counts[r - 1];
+  }
+
+  std::vector<float> received(recv_offsets.back() + recv_counts.back());
+  {
+    std::vector<float> sent(3 * n);
+    std::vector<int> cursor(send_offsets);
+    for (size_t k = 0; k < n; ++k) {
+      int& i = cursor[target[k]];
+      sent[i++] = x[k];
+      sent[i++] = y[k];
+      sent[i++] = z[k];
+    }
+
+    MPI_Alltoallv(sent.data(), send_counts.data(), send_offsets.data(), MPI_FLOAT,
+                  received.data(), recv_counts.data(), recv_offsets.data(), MPI_FLOAT, comm);
+  }
+
+  // step 3: spread each particle on the 8 nearest nodes, the plane
+  // after the slab being kept apart.
+  std::vector<double> ghost(plane, 0.);
+
+  for (size_t k = 0; k < received.size(); k += 3) {
+    long node[3];
+    double weight[3][2];
+    for (int d = 0; d < 3; ++d) {
+      double const u = received[k + d] * scale;
+      double const offset = u - std::floor(u);
+      node[d] = wrap(u);
+      weight[d][0] = 1. - offset;
+      weight[d][1] = offset;
+    }
+
+    long const i = node[0] - first;
+    assert(i >= 0 and i < extent);
+    double* const planes[] = { slab + i * plane, i + 1 < extent ? slab + (i + 1) * plane : ghost.data() };
+    long const rows[] = { node[1], (node[1] + 1) % cells };
+    long const cols[] = { node[2], (node[2] + 1) % cells };
+
+    for (int a = 0; a < 2; ++a)
+      for (int b = 0; b < 2; ++b)
+        for (int c = 0; c < 2; ++c)
+          planes[a][rows[b] * pad + cols[c]] += weight[0][a] * weight[1][b] * weight[2][c];
+  }
+
+  // step 4: add the plane after each slab to the next one, periodically
+  int dest = MPI_PROC_NULL;
+  int source = MPI_PROC_NULL;
+  if (extent > 0) {
+    dest = owner[(first + extent) % cells];
+    source = owner[(first - 1 + cells) % cells];
+  }
+
+  std::vector<double> halo(plane, 0.);
+  MPI_Sendrecv(ghost.data(), plane, MPI_DOUBLE, dest, 0,
+               halo.data(), plane, MPI_DOUBLE, source, 0, comm, MPI_STATUS_IGNORE);
+
+  if (extent > 0) {
+    for (long k = 0; k < plane; ++k)
+      slab[k] += halo[k];
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+bool PowerSpectrum::compute(float const* x, float const* y, float const* z, size_t n) {
+#if HAVE_FFTW
+
+  if (nb_cells < 2 or not (box_size > 0.)) {
+    if (my_rank == 0)
+      std::cerr << "Warning: cannot compute power spectrum without grid or box size" << std::endl;
+    return false;
+  }
+
+  ptrdiff_t const cells = nb_cells;
+  ptrdiff_t const half = cells / 2 + 1;
+  ptrdiff_t const pad = 2 * half;
+  ptrdiff_t local_n0 = 0;
+  ptrdiff_t local_0_start = 0;
+
+  // the real grid is padded in place of its transform
+  ptrdiff_t const alloc = std::max<ptrdiff_t>(
+    fftw_mpi_local_size_3d(cells, cells, half, comm, &local_n0, &local_0_start), 1
+  );
+
+  fftw_complex* transform = fftw_alloc_complex(alloc);
+  auto* const slab = reinterpret_cast<double*>(transform);
+  fftw_plan plan = fftw_mpi_plan_dft_r2c_3d(cells, cells, cells, slab, transform, comm, FFTW_ESTIMATE);
+
+  std::fill(slab, slab + 2 * alloc, 0.);
+  deposit(x, y, z, n, slab, local_0_start, local_n0);
+
+  // density contrast
+  unsigned long local_count = n;
+  unsigned long total_count = 0;
+  MPI_Allreduce(&local_count, &total_count, 1, MPI_UNSIGNED_LONG, MPI_SUM, comm);
+
+  double const mean = total_count / std::pow(double(cells), 3);
+  assert(mean > 0.);
+
+  for (ptrdiff_t i = 0; i < local_n0 * cells; ++i)
+    for (ptrdiff_t l = 0; l < cells; ++l)
+      slab[i * pad + l] = slab[i * pad + l] / mean - 1.;
+
+  fftw_execute(plan);
+
+  // shells of width 2π/box centered on its multiples, up to nyquist
+  int const nb_shells = cells / 2;
+  double const fundamental = 2. * M_PI / box_size;
+  double const volume = std::pow(box_size, 3) / std::pow(double(cells), 6);
+  std::vector<double> sums(3 * nb_shells, 0.);
+  double* const shell_sums = sums.data();
+
+  auto const frequency = [&](ptrdiff_t i) { return i <= cells / 2 ? i : i - cells; };
+  auto const window = [&](ptrdiff_t i) {
+    double const u = M_PI * i / cells;
+    return i == 0 ? 1. : std::pow(std::sin(u) / u, 2);
+  };
+
+  #pragma omp parallel for collapse(2) reduction(+: shell_sums[:3 * nb_shells])
+  for (ptrdiff_t i = 0; i < local_n0; ++i) {
+    for (ptrdiff_t j = 0; j < cells; ++j) {
+      ptrdiff_t const nx = frequency(local_0_start + i);
+      ptrdiff_t const ny = frequency(j);
+      double const wxy = window(nx) * window(ny);
+
+      for (ptrdiff_t l = 0; l < half; ++l) {
+        double const norm = std::sqrt(double(nx * nx + ny * ny + l * l));
+        int const shell = static_cast<int>(norm + 0.5) - 1;
+        if (shell < 0 or shell >= nb_shells)
+          continue;
+
+        // the other half of the modes is implied by hermitian symmetry
+        double const count = (l == 0 or 2 * l == cells) ? 1. : 2.;
+        double const w = wxy * window(l);
+        auto const& mode = transform[(i * cells + j) * half + l];
+        double const amplitude = (mode[0] * mode[0] + mode[1] * mode[1]) / (w * w);
+
+        shell_sums[3 * shell]     += count;
+        shell_sums[3 * shell + 1] += count * norm * fundamental;
+        shell_sums[3 * shell + 2] += count * amplitude * volume;
+      }
+    }
+  }
+
+  MPI_Allreduce(MPI_IN_PLACE, shell_sums, 3 * nb_shells, MPI_DOUBLE, MPI_SUM, comm);
+
+  fftw_destroy_plan(plan);
+  fftw_free(transform);
+
+  wavenumber.clear();
+  power.clear();
+  modes.clear();
+
+  for (int s = 0; s < nb_shells; ++s) {
+    if (sums[3 * s] > 0.) {
+      modes.push_back(sums[3 * s]);
+      wavenumber.push_back(sums[3 * s + 1] / sums[3 * s]);
+      power.push_back(sums[3 * s + 2] / sums[3 * s]);
+    }
+  }
+
+  return true;
+#else
+  if (my_rank == 0)
+    std::cerr << "Warning: cannot compute power spectrum without FFTW" << std::endl;
+  return false;
+#endif
+}
+
+/* -------------------------------------------------------------------------- */
+double PowerSpectrum::interpolate(double k) const {
+
+  if (wavenumber.empty())
+    return 0.;
+
+  auto const upper = std::upper_bound(wavenumber.begin(), wavenumber.end(), k);
+  if (upper == wavenumber.begin())
+    return power.front();
+  if (upper == wavenumber.end())
+    return power.back();
+
+  size_t const s = upper - wavenumber.begin();
+  double const t = (k - wavenumber[s - 1]) / (wavenumber[s] - wavenumber[s - 1]);
+  return (1. - t) * power[s - 1] + t * power[s];
+}
+
+/* -------------------------------------------------------------------------- */
+// largest relative deviation from the reference over the wavenumbers it covers.
+double PowerSpectrum::compare(PowerSpectrum const& reference, double k_max) const {
+
+  if (reference.size() == 0)
+    return 0.;
+
+  double const k_min = reference.wavenumber.front();
+  double const k_last = reference.wavenumber.back();
+  double deviation = 0.;
+
+  for (size_t s = 0; s < wavenumber.size(); ++s) {
+    double const k = wavenumber[s];
+    if (k < k_min or k > k_last or (k_max > 0. and k > k_max))
+      continue;
+
+    double const expected = reference.interpolate(k);
+    if (expected > 0.)
+      deviation = std::max(deviation, std::abs(power[s] / expected - 1.));
+  }
+
+  return deviation;
+}
+
+/* -------------------------------------------------------------------------- */
+bool PowerSpectrum::load(std::string const& path) {
+
+  std::ifstream file(path);
+  if (not file.good())
+    return false;
+
+  wavenumber.clear();
+  power.clear();
+  modes.clear();
+
+  std::string line;
+  while (std::getline(file, line)) {
+    auto const first = line.find_first_not_of(" \t");
+    if (first == std::string::npos or line[first] == '#' or line[first] == '%')
+      continue;
+
+    std::istringstream stream(line);
+    double k = 0.;
+    double p = 0.;
+    double error = 0.;
+    double count = 0.;
+    if (stream >> k >> p) {
+      stream >> error >> count;
+      wavenumber.push_back(k);
+      power.push_back(p);
+      modes.push_back(count);
+    }
+  }
+
+  return not wavenumber.empty();
+}
+
+/* -------------------------------------------------------------------------- */
+bool PowerSpectrum::dump(std::string const& path) const {
+
+  std::ofstream file(path, std::ios::trunc);
+  file << "# k[h/Mpc] P(k)[(Mpc/h)^3] error modes" << std::endl;
+  file.precision(9);
+
+  // modes come in hermitian pairs, hence half of them are independent
+  for (size_t s = 0; s < wavenumber.size(); ++s) {
+    double const error = modes[s] > 0. ? power[s] * std::sqrt(2. / modes[s]) : 0.;
+    file << wavenumber[s] << " " << power[s] << " " << error << " " << modes[s] << std::endl;
+  }
+  return file.good();
+}
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <mpi.h>
+#include "utils/json.h"
+#include "utils/tools.h"
+#include "io/hacc.h"
+#include "spectrum/power_spectrum.h"
+/* -------------------------------------------------------------------------- */
+int main(int argc, char* argv[]) {
+
+  int my_rank = 0;
+  int nb_ranks = 0;
+  int threading = 1;
+  MPI_Comm comm = MPI_COMM_WORLD;
+
+  // init MPI
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &threading);
+  MPI_Comm_size(comm, &nb_ranks);
+  MPI_Comm_rank(comm, &my_rank);
+
+  // basic input checks
+  if (not tools::valid(argc, argv, my_rank, nb_ranks)) {
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+
+#if HAVE_FFTW
+  fftw_mpi_init();
+#endif
+
+  nlohmann::json json;
+  std::ifstream file(argv[1]);
+  file >> json;
+
+  auto const& config = json["spectrum"];
+  std::string const input = config["input"];
+  std::string const output = config["output"];
+  std::vector<std::string> positions {"x", "y", "z"};
+  if (config.count("positions"))
+    positions = config["positions"].get<std::vector<std::string>>();
+
+  int const nb_cells = config.count("cells") ? config["cells"].get<int>() : 128;
+  double const k_max = config.count("k_max") ? config["k_max"].get<double>() : 0.;
+
+  // load particle positions
+  HACCDataLoader loader;
+  loader.init(input, comm);
+
+  // the three axes are read in a single pass, in place
+  std::vector<float> coords[3];
+  std::vector<HACCDataLoader::Binding> targets;
+  for (int d = 0; d < 3; ++d)
+    targets.push_back(HACCDataLoader::bind(positions[d], coords[d]));
+
+  if (not loader.load(targets)) {
+    if (my_rank == 0)
+      std::cerr << "Error: cannot load positions as floats" << std::endl;
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+
+  // the box is that of the input unless given
+  double const box = config.count("box") ? config["box"].get<double>() : loader.phys_scale[0];
+
+  if (my_rank == 0)
+    std::cout << "Computing power spectrum ... " << std::flush;
+
+  PowerSpectrum spectrum(nb_cells, box, comm);
+  bool const computed = spectrum.compute(
+    coords[0].data(), coords[1].data(), coords[2].data(), coords[0].size()
+  );
+
+  if (computed and my_rank == 0) {
+    std::cout << "done" << std::endl;
+    spectrum.dump(output);
+
+    if (config.count("reference")) {
+      PowerSpectrum reference;
+      if (reference.load(config["reference"].get<std::string>())) {
+        std::cout << "Max deviation from reference: ";
+        std::cout << spectrum.compare(reference, k_max) << std::endl;
+      } else {
+        std::cerr << "Error: cannot read reference spectrum" << std::endl;
+      }
+    }
+  }
+
+#if HAVE_FFTW
+  fftw_mpi_cleanup();
+#endif
+
+  MPI_Finalize();
+  return computed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+/* -------------------------------------------------------------------------- */
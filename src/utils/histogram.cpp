@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2019, Los Alamos National Laboratory
+ * All rights reserved.
+ *
+ * Author: Hoby Rakotoarivelo
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include "utils/histogram.h"
+/* -------------------------------------------------------------------------- */
+Histogram::Histogram(size_t in_nb_bins, double in_lower, double in_upper, Scale in_scale)
+  : lower(in_lower),
+    upper(in_upper),
+    scale(in_scale),
+    last(std::max<size_t>(in_nb_bins, 1) - 1),
+    counts(std::max<size_t>(in_nb_bins, 1), 0) {
+
+  // log bins need a positive range
+  if (scale == Log and lower <= 0.)
+    lower = std::numeric_limits<double>::min();
+  if (upper <= lower)
+    upper = lower + 1.;
+
+  start = (scale == Log) ? std::log(lower) : lower;
+  double const end = (scale == Log) ? std::log(upper) : upper;
+  factor = counts.size() / (end - start);
+}
+
+/* -------------------------------------------------------------------------- */
+void Histogram::merge(uint64_t const* partial) {
+  for (size_t k = 0; k < counts.size(); ++k)
+    counts[k] += partial[k];
+}
+
+/* -------------------------------------------------------------------------- */
+void Histogram::reduce(MPI_Comm comm) {
+  MPI_Allreduce(MPI_IN_PLACE, counts.data(), counts.size(), MPI_UINT64_T, MPI_SUM, comm);
+}
+
+/* -------------------------------------------------------------------------- */
+double Histogram::getEdge(size_t k) const {
+  double const position = start + k / factor;
+  return (scale == Log) ? std::exp(position) : position;
+}
+
+/* -------------------------------------------------------------------------- */
+uint64_t Histogram::getTotal() const {
+  return std::accumulate(counts.begin(), counts.end(), uint64_t(0));
+}
+
+/* -------------------------------------------------------------------------- */
+bool Histogram::dump(std::string const& path, Format format) const {
+
+  if (format == Binary) {
+    std::ofstream file(path + ".bin", std::ios::binary|std::ios::trunc);
+    uint64_t const header[] = { counts.size(), scale };
+    double const bounds[] = { lower, upper };
+    file.write(reinterpret_cast<char const*>(header), sizeof(header));
+    file.write(reinterpret_cast<char const*>(bounds), sizeof(bounds));
+    file.write(reinterpret_cast<char const*>(counts.data()), counts.size() * sizeof(uint64_t));
+    return file.good();
+  }
+
+  std::ofstream file(path + ".csv", std::ios::trunc);
+  file << "lower, upper, count" << std::endl;
+  file.precision(9);
+  for (size_t k = 0; k < counts.size(); ++k)
+    file << getEdge(k) << ", " << getEdge(k + 1) << ", " << counts[k] << std::endl;
+  return file.good();
+}
+/* -------------------------------------------------------------------------- */
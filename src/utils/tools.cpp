@@ -29,8 +29,10 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdbool>
+#include <cstring>
 #include <string>
 #include <fstream>
 #include <iostream>
@@ -106,6 +108,72 @@ std::string extractFileName(std::string const &input) {
   return input.substr(pos + 1);
 }
 
+/* -------------------------------------------------------------------------- */
+std::vector<std::string> split(std::string const& input, char delimiter) {
+  std::vector<std::string> tokens;
+  std::stringstream stream(input);
+  std::string token;
+
+  while (std::getline(stream, token, delimiter)) {
+    if (not token.empty())
+      tokens.push_back(token);
+  }
+  return tokens;
+}
+
+/* -------------------------------------------------------------------------- */
+// copy a column into a multi-column buffer, either after the previous
+// columns or interleaved with them so that records are contiguous.
+void stack(void const* column, size_t index, size_t nb_columns, size_t numel,
+           size_t type_size, bool interleave, void* output) {
+
+  auto const* source = static_cast<char const*>(column);
+  auto* target = static_cast<char*>(output);
+
+  if (not interleave) {
+    std::memcpy(target + index * numel * type_size, source, numel * type_size);
+    return;
+  }
+
+  size_t const stride = nb_columns * type_size;
+  target += index * type_size;
+  for (size_t i = 0; i < numel; ++i)
+    std::memcpy(target + i * stride, source + i * type_size, type_size);
+}
+
+/* -------------------------------------------------------------------------- */
+void unstack(void const* input, size_t index, size_t nb_columns, size_t numel,
+             size_t type_size, bool interleave, void* column) {
+
+  auto const* source = static_cast<char const*>(input);
+  auto* target = static_cast<char*>(column);
+
+  if (not interleave) {
+    std::memcpy(target, source + index * numel * type_size, numel * type_size);
+    return;
+  }
+
+  size_t const stride = nb_columns * type_size;
+  source += index * type_size;
+  for (size_t i = 0; i < numel; ++i)
+    std::memcpy(target + i * type_size, source + i * stride, type_size);
+}
+
+/* -------------------------------------------------------------------------- */
+// p-th percentile with linear interpolation between closest ranks.
+double percentile(std::vector<double> values, double p) {
+
+  if (values.empty())
+    return 0.;
+
+  std::sort(values.begin(), values.end());
+  double const position = std::min(std::max(p, 0.), 100.) / 100. * (values.size() - 1);
+  auto const lower = static_cast<size_t>(position);
+  auto const upper = std::min(lower + 1, values.size() - 1);
+  double const weight = position - lower;
+  return values[lower] * (1. - weight) + values[upper] * weight;
+}
+
 /* -------------------------------------------------------------------------- */
 bool valid(int argc, char **argv, int rank, int nb_ranks) {
 